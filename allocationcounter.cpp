@@ -0,0 +1,230 @@
+#include "allocationcounter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef MUSICVIS_COUNT_ALLOCATIONS
+
+const int MAX_THREADS = 64;                // later threads share the last slot
+const size_t THREAD_NAME_SIZE = 16;
+
+namespace {
+
+// One per thread, written only by its owner. Everything here must work
+// from inside operator new, so: fixed storage, no locks, no allocation.
+struct ThreadSlot {
+    std::atomic<quint64> allocations{0};
+    std::atomic<quint64> bytes{0};
+    std::atomic<quint64> external{0};
+    std::atomic<quint64> externalBytes{0};
+    char name[THREAD_NAME_SIZE] = {};
+};
+
+ThreadSlot s_slots[MAX_THREADS];
+std::atomic<int> s_slotCount{0};
+
+thread_local int t_slot = -1;
+thread_local int t_externalDepth = 0;
+
+ThreadSlot& slot()
+{
+    if (t_slot < 0) {
+        t_slot = std::min(s_slotCount.fetch_add(1, std::memory_order_relaxed), MAX_THREADS - 1);
+    }
+    return s_slots[t_slot];
+}
+
+void count(size_t bytes)
+{
+    ThreadSlot& s = slot();
+    if (t_externalDepth > 0) {
+        s.external.store(s.external.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        s.externalBytes.store(s.externalBytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+    } else {
+        s.allocations.store(s.allocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        s.bytes.store(s.bytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+    }
+}
+
+void* allocate(size_t size)
+{
+    count(size);
+    return std::malloc(size ? size : 1);
+}
+
+void* allocateAligned(size_t size, size_t alignment)
+{
+    count(size);
+#ifdef _WIN32
+    return _aligned_malloc(size ? size : 1, alignment);
+#else
+    void* p = nullptr;
+    return posix_memalign(&p, std::max(alignment, sizeof(void*)), size ? size : 1) == 0 ? p : nullptr;
+#endif
+}
+
+void freeAligned(void* p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+}
+
+void* operator new(size_t size)
+{
+    if (void* p = allocate(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    if (void* p = allocate(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    if (void* p = allocateAligned(size, static_cast<size_t>(alignment))) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    if (void* p = allocateAligned(size, static_cast<size_t>(alignment))) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { freeAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { freeAligned(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { freeAligned(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { freeAligned(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(p); }
+
+namespace AllocationCounter {
+
+bool enabled()
+{
+    return true;
+}
+
+Counts thisThread()
+{
+    const ThreadSlot& s = slot();
+    Counts counts;
+    counts.allocations = s.allocations.load(std::memory_order_relaxed);
+    counts.bytes = s.bytes.load(std::memory_order_relaxed);
+    counts.external = s.external.load(std::memory_order_relaxed);
+    counts.externalBytes = s.externalBytes.load(std::memory_order_relaxed);
+    return counts;
+}
+
+void setThreadName(const char* name)
+{
+    ThreadSlot& s = slot();
+    std::strncpy(s.name, name, THREAD_NAME_SIZE - 1);
+    s.name[THREAD_NAME_SIZE - 1] = '\0';
+}
+
+void formatThreads(char* out, size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+    out[0] = '\0';
+    size_t used = 0;
+    const int slots = std::min(s_slotCount.load(std::memory_order_relaxed), MAX_THREADS);
+    for (int i = 0; i < slots && used + 1 < size; ++i) {
+        const ThreadSlot& s = s_slots[i];
+        char fallback[THREAD_NAME_SIZE];
+        std::snprintf(fallback, sizeof(fallback), i == MAX_THREADS - 1 ? "others" : "thread %d", i);
+        const int written = std::snprintf(out + used, size - used, "%s%s %llu/%.1f KB (+%llu ext)",
+                                          i > 0 ? ", " : "", s.name[0] ? s.name : fallback,
+                                          static_cast<unsigned long long>(s.allocations.load(std::memory_order_relaxed)),
+                                          s.bytes.load(std::memory_order_relaxed) / 1024.0,
+                                          static_cast<unsigned long long>(s.external.load(std::memory_order_relaxed)));
+        if (written < 0) {
+            break;
+        }
+        used = std::min(size - 1, used + static_cast<size_t>(written));
+    }
+}
+
+ExternalScope::ExternalScope()
+{
+    t_externalDepth++;
+}
+
+ExternalScope::~ExternalScope()
+{
+    t_externalDepth--;
+}
+
+}
+
+#else
+
+namespace AllocationCounter {
+
+bool enabled()
+{
+    return false;
+}
+
+Counts thisThread()
+{
+    return Counts();
+}
+
+void setThreadName(const char*)
+{
+}
+
+void formatThreads(char* out, size_t size)
+{
+    if (size > 0) {
+        out[0] = '\0';
+    }
+}
+
+ExternalScope::ExternalScope() = default;
+ExternalScope::~ExternalScope() = default;
+
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+#include <cstddef>
+
+// Heap allocation counting per thread, for keeping the steady-state frame
+// loop allocation-free. Counting replaces the global operator new/delete and
+// is only compiled in with -DMUSICVIS_COUNT_ALLOCATIONS=ON; otherwise every
+// function here returns zeros and costs nothing.
+//
+// Allocations made inside an ExternalScope are tallied separately: that's
+// third-party code on our path (projectM, Qt, the GL driver) which the
+// guarantee can't cover, but whose cost is still worth seeing.
+namespace AllocationCounter {
+
+struct Counts {
+    quint64 allocations = 0;
+    quint64 bytes = 0;
+    quint64 external = 0;       // allocations inside an ExternalScope
+    quint64 externalBytes = 0;
+};
+
+bool enabled();
+
+// Running totals of the calling thread; diff two snapshots for a frame.
+Counts thisThread();
+
+// Name for the calling thread in formatThreads() (at most 15 characters).
+void setThreadName(const char* name);
+
+// "gui 12/3.1 KB (+40 ext), thread 2 0/0 B, ..." for every thread that has
+// allocated so far. Doesn't allocate.
+void formatThreads(char* out, size_t size);
+
+class ExternalScope
+{
+public:
+    ExternalScope();
+    ~ExternalScope();
+    ExternalScope(const ExternalScope&) = delete;
+    ExternalScope& operator=(const ExternalScope&) = delete;
+};
+
+}
+
+#endif // ALLOCATIONCOUNTER_H
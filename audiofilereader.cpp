@@ -0,0 +1,218 @@
+#include "audiofilereader.h"
+#include "decodecache.h"
+
+#include <QDebug>
+#include <cmath>
+#include <cstring>
+
+// Headerless .raw/.pcm files are assumed to be CD layout
+const int RAW_PCM_CHANNELS = 2;
+const int RAW_PCM_SAMPLE_RATE = 44100;
+
+AudioFileReader::~AudioFileReader()
+{
+    close();
+}
+
+bool AudioFileReader::open(const QString& path, size_t chunkFrames)
+{
+    close();
+    m_chunkFrames = chunkFrames;
+
+    if (openMapped(path)) {
+        return true;
+    }
+
+    memset(&m_sfInfo, 0, sizeof(m_sfInfo));
+    m_sndFile = sf_open(path.toStdString().c_str(), SFM_READ, &m_sfInfo);
+
+    if (!m_sndFile) {
+        qCritical() << "Error opening audio file:" << path
+                    << "- Error:" << sf_strerror(NULL);
+        return false;
+    }
+
+    qInfo() << "Opened audio file:" << path;
+    qInfo() << "  Frames:" << m_sfInfo.frames << "Samplerate:" << m_sfInfo.samplerate
+            << "Channels:" << m_sfInfo.channels << "Format:" << m_sfInfo.format;
+
+    // Read integer PCM as integers and convert ourselves; the ingest kernels
+    // are faster than libsndfile's per-sample conversion.
+    switch (m_sfInfo.format & SF_FORMAT_SUBMASK) {
+        case SF_FORMAT_PCM_S8:
+        case SF_FORMAT_PCM_U8:
+        case SF_FORMAT_PCM_16:
+            m_ingestFormat = AudioIngest::SampleFormat::Int16;
+            break;
+        case SF_FORMAT_PCM_24:
+        case SF_FORMAT_PCM_32:
+            m_ingestFormat = AudioIngest::SampleFormat::Int32;
+            break;
+        default:
+            m_ingestFormat = AudioIngest::SampleFormat::Float32;
+            break;
+    }
+
+    if (!configureIngest(m_sfInfo.channels, m_sfInfo.samplerate)) {
+         close();
+         return false;
+    }
+    m_audioReadBuffer.resize(m_ingest.maxInputFrames() * m_ingest.bytesPerFrame(m_ingestFormat));
+
+    // First play of a compressed file: decode it once in the background so the next one is mapped
+    if (m_decodeCacheEnabled && DecodeCache::isCacheable(path)) {
+        DecodeCache::decodeInBackground(path);
+    }
+
+    return true;
+}
+
+// Uncompressed PCM (or a sidecar decoded on an earlier play) is read straight
+// out of a memory mapping instead of going through sf_readf_*().
+bool AudioFileReader::openMapped(const QString& sourcePath)
+{
+    QString path = sourcePath;
+    if (m_decodeCacheEnabled && DecodeCache::isCacheable(sourcePath)) {
+        path = DecodeCache::lookup(sourcePath);
+    }
+    if (path.isEmpty() || !MappedAudioFile::isCandidate(path)) {
+        return false;
+    }
+
+    const bool opened = MappedAudioFile::isRaw(path)
+        ? m_mappedAudio.openRaw(path, RAW_PCM_CHANNELS, RAW_PCM_SAMPLE_RATE, AudioIngest::SampleFormat::Int16)
+        : m_mappedAudio.open(path);
+    if (!opened) {
+        return false;
+    }
+
+    qInfo() << "Memory-mapped" << m_mappedAudio.containerName() << "audio file:" << path;
+    qInfo() << "  Frames:" << m_mappedAudio.frames() << "Samplerate:" << m_mappedAudio.sampleRate()
+            << "Channels:" << m_mappedAudio.channels();
+
+    m_ingestFormat = m_mappedAudio.format();
+    if (!configureIngest(m_mappedAudio.channels(), m_mappedAudio.sampleRate())) {
+        m_mappedAudio.close();
+        return false;
+    }
+    m_mappedAudio.setMaxReadFrames(m_ingest.maxInputFrames());
+    return true;
+}
+
+bool AudioFileReader::configureIngest(int channels, int sampleRate)
+{
+    // Enough input frames to produce a full chunk at projectM's rate
+    const size_t maxInputFrames = static_cast<size_t>(
+        std::ceil(static_cast<double>(m_chunkFrames) * sampleRate / AudioIngest::kTargetSampleRate)) + 1;
+    if (!m_ingest.configure(channels, sampleRate, maxInputFrames)) {
+        qCritical() << "Error: Unsupported audio layout. Channels:" << channels
+                    << "Samplerate:" << sampleRate;
+        return false;
+    }
+    if (channels > 2 || sampleRate != AudioIngest::kTargetSampleRate) {
+        qInfo() << "  Converting" << channels << "ch @" << sampleRate
+                << "Hz to stereo @" << AudioIngest::kTargetSampleRate << "Hz";
+    }
+    return true;
+}
+
+void AudioFileReader::close()
+{
+    if (m_sndFile) {
+        sf_close(m_sndFile);
+        m_sndFile = nullptr;
+        qInfo() << "Closed audio file.";
+    }
+    if (m_mappedAudio.isOpen()) {
+        m_mappedAudio.close();
+        qInfo() << "Closed mapped audio file.";
+    }
+}
+
+void AudioFileReader::rewind()
+{
+    if (m_mappedAudio.isOpen()) {
+        m_mappedAudio.seek(0);
+    } else if (m_sndFile) {
+        sf_seek(m_sndFile, 0, SEEK_SET);
+    }
+    m_ingest.reset();
+}
+
+void AudioFileReader::seek(int64_t frame)
+{
+    const int64_t total = length();
+    if (total <= 0) {
+        return;
+    }
+    const int64_t target = ((frame % total) + total) % total;
+    if (m_mappedAudio.isOpen()) {
+        m_mappedAudio.seek(target);
+    } else if (m_sndFile) {
+        sf_seek(m_sndFile, target, SEEK_SET);
+    }
+    m_ingest.reset();
+}
+
+int64_t AudioFileReader::position() const
+{
+    if (m_mappedAudio.isOpen()) {
+        return m_mappedAudio.position();
+    }
+    if (m_sndFile) {
+        return sf_seek(m_sndFile, 0, SEEK_CUR);
+    }
+    return 0;
+}
+
+int64_t AudioFileReader::length() const
+{
+    if (m_mappedAudio.isOpen()) {
+        return m_mappedAudio.frames();
+    }
+    if (m_sndFile) {
+        return m_sfInfo.frames;
+    }
+    return 0;
+}
+
+const float* AudioFileReader::readChunk(size_t* framesOut)
+{
+    *framesOut = 0;
+    if (!isOpen()) {
+        return nullptr;
+    }
+
+    const size_t framesWanted = m_ingest.inputFramesFor(m_chunkFrames);
+    const void* data = nullptr;
+    size_t framesRead = 0;
+
+    if (m_mappedAudio.isOpen()) {
+        // Samples come straight out of the mapping, no intermediate copy
+        data = m_mappedAudio.read(framesWanted, &framesRead);
+    } else {
+        sf_count_t got = 0;
+        switch (m_ingestFormat) {
+            case AudioIngest::SampleFormat::Int16:
+                got = sf_readf_short(m_sndFile, reinterpret_cast<short*>(m_audioReadBuffer.data()), framesWanted);
+                break;
+            case AudioIngest::SampleFormat::Int32:
+                got = sf_readf_int(m_sndFile, reinterpret_cast<int*>(m_audioReadBuffer.data()), framesWanted);
+                break;
+            default:
+                got = sf_readf_float(m_sndFile, reinterpret_cast<float*>(m_audioReadBuffer.data()), framesWanted);
+                break;
+        }
+        data = m_audioReadBuffer.data();
+        framesRead = got > 0 ? static_cast<size_t>(got) : 0;
+    }
+
+    if (framesRead == 0) {
+        qInfo() << "End of audio file reached or read error.";
+        // loop
+        rewind();
+        return nullptr;
+    }
+
+    return m_ingest.process(data, m_ingestFormat, framesRead, framesOut);
+}
@@ -0,0 +1,67 @@
+#ifndef AUDIOFILEREADER_H
+#define AUDIOFILEREADER_H
+
+#include <QString>
+#include <cstdint>
+#include <vector>
+#include <sndfile.h>
+
+#include "audioingest.h"
+#include "mappedaudiofile.h"
+
+// Reads an audio file chunk by chunk as stereo float at projectM's rate.
+// Uncompressed PCM (or a decoded sidecar) is served from a memory mapping,
+// everything else through libsndfile; both go through AudioIngest.
+// Used by the on-screen window as well as the offscreen renderers.
+class AudioFileReader
+{
+public:
+    AudioFileReader() = default;
+    ~AudioFileReader();
+
+    AudioFileReader(const AudioFileReader&) = delete;
+    AudioFileReader& operator=(const AudioFileReader&) = delete;
+
+    // chunkFrames is the number of output frames each readChunk() aims for.
+    bool open(const QString& path, size_t chunkFrames);
+    void close();
+    bool isOpen() const { return m_sndFile != nullptr || m_mappedAudio.isOpen(); }
+
+    // Decode compressed inputs once into a float sidecar that later opens memory-map
+    void setDecodeCacheEnabled(bool enabled) { m_decodeCacheEnabled = enabled; }
+
+    // Returns the next chunk of interleaved stereo float (owned by the reader)
+    // and its frame count. At end of file it rewinds and returns 0 frames.
+    const float* readChunk(size_t* framesOut);
+    void rewind();
+    // Moves the read position to input frame `frame`, wrapped into the file
+    // like playback loops.
+    void seek(int64_t frame);
+
+    // Current read position and total length, in input frames
+    int64_t position() const;
+    int64_t length() const;
+    bool isMapped() const { return m_mappedAudio.isOpen(); }
+    int channels() const { return m_ingest.channels(); }
+    int sampleRate() const { return m_ingest.inputSampleRate(); }
+
+private:
+    bool openMapped(const QString& path);
+    bool configureIngest(int channels, int sampleRate);
+
+    size_t m_chunkFrames = 0;
+    bool m_decodeCacheEnabled = false;
+
+    // libsndfile path
+    SNDFILE* m_sndFile = nullptr;
+    SF_INFO m_sfInfo;
+    std::vector<unsigned char> m_audioReadBuffer; // raw interleaved frames in m_ingestFormat
+
+    // zero-copy path for uncompressed PCM
+    MappedAudioFile m_mappedAudio;
+
+    AudioIngest m_ingest;                         // downmix / convert / resample to projectM's format
+    AudioIngest::SampleFormat m_ingestFormat = AudioIngest::SampleFormat::Float32;
+};
+
+#endif // AUDIOFILEREADER_H
@@ -0,0 +1,341 @@
+#include "audioingest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AUDIOINGEST_SSE2 1
+#endif
+
+namespace {
+constexpr float kInt16Scale = 1.0f / 32768.0f;
+constexpr float kInt24Scale = 1.0f / 8388608.0f;
+constexpr float kInt32Scale = 1.0f / 2147483648.0f;
+constexpr float kMinus3dB = 0.70710678f;
+}
+
+bool AudioIngest::configure(int channels, int inputSampleRate, size_t maxInputFrames)
+{
+    if (channels < 1 || inputSampleRate <= 0 || maxInputFrames == 0) {
+        return false;
+    }
+
+    m_channels = channels;
+    m_inputRate = inputSampleRate;
+    m_maxInputFrames = maxInputFrames;
+    m_step = static_cast<double>(m_inputRate) / kTargetSampleRate;
+    m_maxOutputFrames = static_cast<size_t>(std::ceil(maxInputFrames / m_step)) + 2;
+
+    m_downmixMatrix.assign(static_cast<size_t>(channels) * 2, 0.0f);
+    buildDownmixMatrix(channels, m_downmixMatrix.data());
+
+    m_convertBuffer.assign(static_cast<size_t>(channels) * maxInputFrames, 0.0f);
+    m_stereoBuffer.assign(2 * maxInputFrames, 0.0f);
+    m_outputBuffer.assign(2 * m_maxOutputFrames, 0.0f);
+
+    reset();
+    return true;
+}
+
+void AudioIngest::reset()
+{
+    m_phase = 0.0;
+    m_history[0] = m_history[1] = 0.0f;
+    m_haveHistory = false;
+}
+
+size_t AudioIngest::inputFramesFor(size_t outputFrames) const
+{
+    size_t frames = static_cast<size_t>(std::ceil(outputFrames * m_step));
+    return std::min(std::max<size_t>(frames, 1), m_maxInputFrames);
+}
+
+size_t AudioIngest::bytesPerFrame(SampleFormat format) const
+{
+    switch (format) {
+        case SampleFormat::Int16: return 2 * static_cast<size_t>(m_channels);
+        case SampleFormat::Int24: return 3 * static_cast<size_t>(m_channels);
+        case SampleFormat::Int32:
+        case SampleFormat::Float32: return 4 * static_cast<size_t>(m_channels);
+    }
+    return 0;
+}
+
+const float* AudioIngest::process(const void* data, SampleFormat format, size_t frames, size_t* outFrames)
+{
+    *outFrames = 0;
+    if (!data || m_channels < 1 || frames == 0) {
+        return m_outputBuffer.data();
+    }
+    frames = std::min(frames, m_maxInputFrames);
+    const size_t samples = frames * static_cast<size_t>(m_channels);
+
+    // 1. Format conversion into float
+    const float* interleaved = nullptr;
+    switch (format) {
+        case SampleFormat::Int16:
+            int16ToFloat(static_cast<const int16_t*>(data), m_convertBuffer.data(), samples);
+            interleaved = m_convertBuffer.data();
+            break;
+        case SampleFormat::Int24:
+            int24ToFloat(static_cast<const uint8_t*>(data), m_convertBuffer.data(), samples);
+            interleaved = m_convertBuffer.data();
+            break;
+        case SampleFormat::Int32:
+            int32ToFloat(static_cast<const int32_t*>(data), m_convertBuffer.data(), samples);
+            interleaved = m_convertBuffer.data();
+            break;
+        case SampleFormat::Float32:
+            interleaved = static_cast<const float*>(data);
+            break;
+    }
+
+    // 2. Channel layout -> stereo
+    const float* stereo = nullptr;
+    if (m_channels == 2) {
+        stereo = interleaved;
+    } else if (m_channels == 1) {
+        monoToStereo(interleaved, m_stereoBuffer.data(), frames);
+        stereo = m_stereoBuffer.data();
+    } else {
+        downmixToStereo(interleaved, m_channels, m_downmixMatrix.data(), m_stereoBuffer.data(), frames);
+        stereo = m_stereoBuffer.data();
+    }
+
+    // 3. Sample rate -> projectM rate
+    if (m_inputRate == kTargetSampleRate) {
+        *outFrames = frames;
+        return stereo;
+    }
+    *outFrames = resample(stereo, frames, m_outputBuffer.data());
+    return m_outputBuffer.data();
+}
+
+// Linear interpolation with state carried across chunks. Index -1 refers to
+// the last frame of the previous chunk (m_history). Good enough for analysis
+// input; this never reaches the speakers.
+size_t AudioIngest::resample(const float* in, size_t frames, float* out)
+{
+    if (!m_haveHistory) {
+        m_history[0] = in[0];
+        m_history[1] = in[1];
+        m_phase = 0.0;
+        m_haveHistory = true;
+    }
+
+    const double last = static_cast<double>(frames) - 1.0;
+    double phase = m_phase;
+    size_t produced = 0;
+
+    while (phase < last && produced < m_maxOutputFrames) {
+        const double base = std::floor(phase);
+        const float frac = static_cast<float>(phase - base);
+        const long i = static_cast<long>(base);
+        const float* a = (i < 0) ? m_history : in + 2 * i;
+        const float* b = in + 2 * (i + 1);
+        out[2 * produced] = a[0] + (b[0] - a[0]) * frac;
+        out[2 * produced + 1] = a[1] + (b[1] - a[1]) * frac;
+        ++produced;
+        phase += m_step;
+    }
+
+    m_phase = phase - static_cast<double>(frames);
+    m_history[0] = in[2 * (frames - 1)];
+    m_history[1] = in[2 * (frames - 1) + 1];
+    return produced;
+}
+
+// --- Kernels ---
+
+void AudioIngest::int16ToFloat(const int16_t* in, float* out, size_t count)
+{
+    size_t i = 0;
+#ifdef AUDIOINGEST_SSE2
+    const __m128 scale = _mm_set1_ps(kInt16Scale);
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        // sign-extend 16 -> 32 by unpacking into the high half and shifting back
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = in[i] * kInt16Scale;
+    }
+}
+
+void AudioIngest::int24ToFloat(const uint8_t* in, float* out, size_t count)
+{
+    // Place the 3 bytes in the top of an int32 so the arithmetic shift sign-extends.
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t* p = in + 3 * i;
+        const int32_t v = static_cast<int32_t>((static_cast<uint32_t>(p[0]) << 8) |
+                                               (static_cast<uint32_t>(p[1]) << 16) |
+                                               (static_cast<uint32_t>(p[2]) << 24)) >> 8;
+        out[i] = v * kInt24Scale;
+    }
+}
+
+void AudioIngest::int32ToFloat(const int32_t* in, float* out, size_t count)
+{
+    size_t i = 0;
+#ifdef AUDIOINGEST_SSE2
+    const __m128 scale = _mm_set1_ps(kInt32Scale);
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = static_cast<float>(in[i]) * kInt32Scale;
+    }
+}
+
+void AudioIngest::floatToInt16(const float* in, int16_t* out, size_t count)
+{
+    size_t i = 0;
+#ifdef AUDIOINGEST_SSE2
+    const __m128 scale = _mm_set1_ps(32767.0f);
+    for (; i + 8 <= count; i += 8) {
+        __m128i lo = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i), scale));
+        __m128i hi = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale));
+        // packs saturates, which doubles as clipping
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(lo, hi));
+    }
+#endif
+    for (; i < count; ++i) {
+        const float v = std::min(1.0f, std::max(-1.0f, in[i]));
+        out[i] = static_cast<int16_t>(std::lrint(v * 32767.0f));
+    }
+}
+
+void AudioIngest::monoToStereo(const float* in, float* out, size_t frames)
+{
+    size_t i = 0;
+#ifdef AUDIOINGEST_SSE2
+    for (; i + 4 <= frames; i += 4) {
+        __m128 v = _mm_loadu_ps(in + i);
+        _mm_storeu_ps(out + 2 * i, _mm_unpacklo_ps(v, v));
+        _mm_storeu_ps(out + 2 * i + 4, _mm_unpackhi_ps(v, v));
+    }
+#endif
+    for (; i < frames; ++i) {
+        out[2 * i] = in[i];
+        out[2 * i + 1] = in[i];
+    }
+}
+
+void AudioIngest::downmixToStereo(const float* in, int channels, const float* matrix,
+                                  float* out, size_t frames)
+{
+#ifdef AUDIOINGEST_SSE2
+    if (channels == 6) {
+        // 5.1 hot path: accumulate (L,R) pairs for two frames at a time.
+        // Each gain vector is (toL, toR, toL, toR) for the pair it multiplies.
+        const __m128 gF  = _mm_setr_ps(matrix[0], matrix[3], matrix[0], matrix[3]);
+        const __m128 gFx = _mm_setr_ps(matrix[2], matrix[1], matrix[2], matrix[1]);
+        const __m128 gC  = _mm_setr_ps(matrix[4], matrix[5], matrix[4], matrix[5]);
+        const __m128 gLF = _mm_setr_ps(matrix[6], matrix[7], matrix[6], matrix[7]);
+        const __m128 gS  = _mm_setr_ps(matrix[8], matrix[11], matrix[8], matrix[11]);
+        const __m128 gSx = _mm_setr_ps(matrix[10], matrix[9], matrix[10], matrix[9]);
+        size_t f = 0;
+        for (; f + 2 <= frames; f += 2) {
+            const float* a = in + 6 * f;
+            const float* b = a + 6;
+            __m128 front = _mm_setr_ps(a[0], a[1], b[0], b[1]);
+            __m128 center = _mm_setr_ps(a[2], a[2], b[2], b[2]);
+            __m128 lfe = _mm_setr_ps(a[3], a[3], b[3], b[3]);
+            __m128 surround = _mm_setr_ps(a[4], a[5], b[4], b[5]);
+            __m128 acc = _mm_mul_ps(front, gF);
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_shuffle_ps(front, front, _MM_SHUFFLE(2, 3, 0, 1)), gFx));
+            acc = _mm_add_ps(acc, _mm_mul_ps(center, gC));
+            acc = _mm_add_ps(acc, _mm_mul_ps(lfe, gLF));
+            acc = _mm_add_ps(acc, _mm_mul_ps(surround, gS));
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_shuffle_ps(surround, surround, _MM_SHUFFLE(2, 3, 0, 1)), gSx));
+            _mm_storeu_ps(out + 2 * f, acc);
+        }
+        in += 6 * f;
+        out += 2 * f;
+        frames -= f;
+    }
+#endif
+    for (size_t f = 0; f < frames; ++f) {
+        const float* frame = in + static_cast<size_t>(channels) * f;
+        float l = 0.0f;
+        float r = 0.0f;
+        for (int c = 0; c < channels; ++c) {
+            l += frame[c] * matrix[2 * c];
+            r += frame[c] * matrix[2 * c + 1];
+        }
+        out[2 * f] = l;
+        out[2 * f + 1] = r;
+    }
+}
+
+void AudioIngest::buildDownmixMatrix(int channels, float* matrix)
+{
+    std::fill(matrix, matrix + 2 * channels, 0.0f);
+    auto set = [matrix](int ch, float l, float r) {
+        matrix[2 * ch] = l;
+        matrix[2 * ch + 1] = r;
+    };
+
+    // WAVE_FORMAT_EXTENSIBLE default orders: FL FR FC LFE BL BR SL SR
+    switch (channels) {
+        case 1:
+            set(0, 1.0f, 1.0f);
+            break;
+        case 2:
+            set(0, 1.0f, 0.0f);
+            set(1, 0.0f, 1.0f);
+            break;
+        case 3: // L R C
+            set(0, 1.0f, 0.0f);
+            set(1, 0.0f, 1.0f);
+            set(2, kMinus3dB, kMinus3dB);
+            break;
+        case 4: // L R Ls Rs
+            set(0, 1.0f, 0.0f);
+            set(1, 0.0f, 1.0f);
+            set(2, kMinus3dB, 0.0f);
+            set(3, 0.0f, kMinus3dB);
+            break;
+        case 5: // L R C Ls Rs
+        case 6: // L R C LFE Ls Rs (LFE dropped, as ITU-R BS.775)
+        case 8: // L R C LFE Lb Rb Ls Rs
+        {
+            const int surround = (channels == 5) ? 3 : 4;
+            set(0, 1.0f, 0.0f);
+            set(1, 0.0f, 1.0f);
+            set(2, kMinus3dB, kMinus3dB);
+            set(surround, kMinus3dB, 0.0f);
+            set(surround + 1, 0.0f, kMinus3dB);
+            if (channels == 8) {
+                set(6, kMinus3dB, 0.0f);
+                set(7, 0.0f, kMinus3dB);
+            }
+            break;
+        }
+        default:
+            for (int c = 0; c < channels; ++c) {
+                set(c, (c % 2 == 0) ? 1.0f : 0.0f, (c % 2 == 0) ? 0.0f : 1.0f);
+            }
+            break;
+    }
+
+    // Normalize so a full-scale signal on every channel stays within [-1, 1]
+    float sumL = 0.0f;
+    float sumR = 0.0f;
+    for (int c = 0; c < channels; ++c) {
+        sumL += matrix[2 * c];
+        sumR += matrix[2 * c + 1];
+    }
+    for (int c = 0; c < channels; ++c) {
+        if (sumL > 1.0f) matrix[2 * c] /= sumL;
+        if (sumR > 1.0f) matrix[2 * c + 1] /= sumR;
+    }
+}
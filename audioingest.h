@@ -0,0 +1,80 @@
+#ifndef AUDIOINGEST_H
+#define AUDIOINGEST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Audio ingest stage: turns whatever the decoder hands us (any channel count,
+// int16/int24/int32/float, any sample rate) into interleaved stereo float at
+// the rate projectM expects. All buffers are allocated in configure(), so
+// process() never touches the heap.
+class AudioIngest
+{
+public:
+    enum class SampleFormat {
+        Int16,      // native-endian int16_t
+        Int24,      // packed little-endian 3-byte samples
+        Int32,      // native-endian int32_t (libsndfile's sf_readf_int)
+        Float32     // native-endian float
+    };
+
+    // projectM's PCM analysis assumes 44.1 kHz input
+    static constexpr int kTargetSampleRate = 44100;
+
+    AudioIngest() = default;
+
+    // Pre-allocates every buffer for chunks of up to maxInputFrames.
+    bool configure(int channels, int inputSampleRate, size_t maxInputFrames);
+    // Drops resampler history, e.g. after a seek.
+    void reset();
+
+    // How many input frames to read to produce roughly outputFrames of output.
+    size_t inputFramesFor(size_t outputFrames) const;
+    // Size in bytes of one interleaved input frame in the given format.
+    size_t bytesPerFrame(SampleFormat format) const;
+
+    // Converts, downmixes and resamples one chunk. Returns interleaved stereo
+    // float owned by this object (valid until the next call) and its frame count.
+    const float* process(const void* data, SampleFormat format, size_t frames, size_t* outFrames);
+
+    int channels() const { return m_channels; }
+    int inputSampleRate() const { return m_inputRate; }
+    size_t maxInputFrames() const { return m_maxInputFrames; }
+    size_t maxOutputFrames() const { return m_maxOutputFrames; }
+
+    // --- Kernels (SSE2 where available, scalar otherwise) ---
+    static void int16ToFloat(const int16_t* in, float* out, size_t count);
+    static void int24ToFloat(const uint8_t* in, float* out, size_t count);
+    static void int32ToFloat(const int32_t* in, float* out, size_t count);
+    static void floatToInt16(const float* in, int16_t* out, size_t count);
+    static void monoToStereo(const float* in, float* out, size_t frames);
+    // Mixes N interleaved channels down to interleaved stereo using a
+    // channels x 2 coefficient matrix (row-major, L gain then R gain).
+    static void downmixToStereo(const float* in, int channels, const float* matrix,
+                                float* out, size_t frames);
+    // Builds a normalized downmix matrix for common WAV channel layouts
+    // (mono, stereo, 3.0, quad, 5.0, 5.1, 7.1); other counts alternate L/R.
+    static void buildDownmixMatrix(int channels, float* matrix);
+
+private:
+    size_t resample(const float* in, size_t frames, float* out);
+
+    int m_channels = 0;
+    int m_inputRate = 0;
+    size_t m_maxInputFrames = 0;
+    size_t m_maxOutputFrames = 0;
+
+    std::vector<float> m_downmixMatrix;
+    std::vector<float> m_convertBuffer;   // channels * maxInputFrames
+    std::vector<float> m_stereoBuffer;    // 2 * maxInputFrames
+    std::vector<float> m_outputBuffer;    // 2 * maxOutputFrames
+
+    // Linear resampler state
+    double m_step = 1.0;                  // input frames per output frame
+    double m_phase = 0.0;                 // position relative to m_history
+    float m_history[2] = {0.0f, 0.0f};    // last input frame of previous chunk
+    bool m_haveHistory = false;
+};
+
+#endif // AUDIOINGEST_H
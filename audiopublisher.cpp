@@ -0,0 +1,226 @@
+#include "audiopublisher.h"
+#include "audioingest.h"
+#include "logging.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+
+namespace {
+
+// Roughly sub-bass, bass, low mid, mid, upper mid, presence, brilliance, air
+const float BAND_EDGES_HZ[MUSICVIS_SHM_BANDS + 1] = {20, 60, 150, 400, 1000, 2400, 6000, 12000, 20000};
+
+size_t headerSize()
+{
+    return (sizeof(musicvis_shm_header) + 63) & ~size_t(63);
+}
+
+qint64 monotonicNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+}
+
+AudioPublisher::AudioPublisher()
+    : m_history(FFT_SIZE, 0.0f),
+      m_window(FFT_SIZE),
+      m_twiddleRe(FFT_SIZE / 2),
+      m_twiddleIm(FFT_SIZE / 2),
+      m_bitReverse(FFT_SIZE),
+      m_re(FFT_SIZE),
+      m_im(FFT_SIZE),
+      m_bandFirstBin(MUSICVIS_SHM_BANDS + 1)
+{
+    const double pi = std::acos(-1.0);
+    for (int i = 0; i < FFT_SIZE; ++i) {
+        m_window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * pi * i / (FFT_SIZE - 1)));
+    }
+    for (int i = 0; i < FFT_SIZE / 2; ++i) {
+        m_twiddleRe[i] = static_cast<float>(std::cos(-2.0 * pi * i / FFT_SIZE));
+        m_twiddleIm[i] = static_cast<float>(std::sin(-2.0 * pi * i / FFT_SIZE));
+    }
+    int bits = 0;
+    while ((1 << bits) < FFT_SIZE) {
+        bits++;
+    }
+    for (int i = 0; i < FFT_SIZE; ++i) {
+        int reversed = 0;
+        for (int b = 0; b < bits; ++b) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        m_bitReverse[i] = reversed;
+    }
+    const float binHz = static_cast<float>(AudioIngest::kTargetSampleRate) / FFT_SIZE;
+    for (size_t i = 0; i <= MUSICVIS_SHM_BANDS; ++i) {
+        m_bandFirstBin[i] = std::min(static_cast<int>(MUSICVIS_SHM_SPECTRUM_BINS),
+                                     static_cast<int>(std::lround(BAND_EDGES_HZ[i] / binHz)));
+    }
+}
+
+AudioPublisher::~AudioPublisher()
+{
+    close();
+}
+
+bool AudioPublisher::open(const char* name)
+{
+    close();
+    // Start from a fresh object so readers of an old run see it go away
+    // instead of a half-rewritten layout
+    shm_unlink(name);
+    const int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        MVLOG(Warning, Audio, "Audio publisher: shm_open(%s) failed (errno %d)", name, errno);
+        return false;
+    }
+    const size_t size = headerSize() + sizeof(musicvis_shm_slot) * MUSICVIS_SHM_SLOTS;
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        MVLOG(Warning, Audio, "Audio publisher: cannot size %s (errno %d)", name, errno);
+        ::close(fd);
+        shm_unlink(name);
+        return false;
+    }
+    void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        MVLOG(Warning, Audio, "Audio publisher: mmap of %s failed (errno %d)", name, errno);
+        shm_unlink(name);
+        return false;
+    }
+
+    // ftruncate zero-fills, so every slot starts at sequence 0 (stable, empty)
+    m_header = static_cast<musicvis_shm_header*>(map);
+    m_size = size;
+    m_name = QString::fromLatin1(name);
+    m_header->version = MUSICVIS_SHM_VERSION;
+    m_header->header_size = static_cast<uint32_t>(headerSize());
+    m_header->slot_size = sizeof(musicvis_shm_slot);
+    m_header->slot_count = MUSICVIS_SHM_SLOTS;
+    m_header->max_frames = MUSICVIS_SHM_MAX_FRAMES;
+    m_header->spectrum_bins = MUSICVIS_SHM_SPECTRUM_BINS;
+    m_header->band_count = MUSICVIS_SHM_BANDS;
+    m_header->sample_rate = AudioIngest::kTargetSampleRate;
+    m_header->writer_pid = static_cast<uint32_t>(getpid());
+    std::copy(std::begin(BAND_EDGES_HZ), std::end(BAND_EDGES_HZ), m_header->band_edges_hz);
+    // Magic last: a reader that sees it sees a complete header
+    __atomic_store_n(&m_header->magic, MUSICVIS_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    qInfo() << "Publishing audio analysis to shared memory" << m_name << "(" << size / 1024 << "KiB,"
+            << MUSICVIS_SHM_SLOTS << "slots)";
+    return true;
+}
+
+void AudioPublisher::close()
+{
+    if (!m_header) {
+        return;
+    }
+    munmap(m_header, m_size);
+    shm_unlink(m_name.toLatin1().constData());
+    m_header = nullptr;
+    m_size = 0;
+    if (m_published > 0) {
+        qInfo() << "Audio publisher:" << m_published << "frames published, avg"
+                << averagePublishUs() << "us each";
+    }
+}
+
+void AudioPublisher::publish(const float* stereo, size_t frames, qint64 frame)
+{
+    if (!m_header) {
+        return;
+    }
+    const qint64 start = monotonicNs();
+
+    // Keep the newest audio if a chunk is ever larger than a slot
+    if (frames > MUSICVIS_SHM_MAX_FRAMES) {
+        if (stereo) {
+            stereo += (frames - MUSICVIS_SHM_MAX_FRAMES) * 2;
+        }
+        frames = MUSICVIS_SHM_MAX_FRAMES;
+    }
+    float peak = 0.0f;
+    for (size_t i = 0; i < frames; ++i) {
+        const float left = stereo ? stereo[i * 2] : 0.0f;
+        const float right = stereo ? stereo[i * 2 + 1] : 0.0f;
+        peak = std::max(peak, std::max(std::abs(left), std::abs(right)));
+        m_history[m_historyPos] = 0.5f * (left + right);
+        m_historyPos = (m_historyPos + 1) % FFT_SIZE;
+    }
+
+    const uint64_t index = m_header->write_count;     // we are the only writer
+    auto* slot = reinterpret_cast<musicvis_shm_slot*>(reinterpret_cast<char*>(m_header) + m_header->header_size +
+                                                      (index & (MUSICVIS_SHM_SLOTS - 1)) * sizeof(musicvis_shm_slot));
+    const uint64_t sequence = slot->sequence;
+    __atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    slot->frame = static_cast<uint64_t>(frame);
+    slot->pcm_frames = static_cast<uint32_t>(frames);
+    slot->peak = peak;
+    if (stereo) {
+        std::memcpy(slot->pcm, stereo, frames * 2 * sizeof(float));
+    } else {
+        std::memset(slot->pcm, 0, frames * 2 * sizeof(float));
+    }
+    analyse(slot);
+    slot->timestamp_ns = monotonicNs();
+
+    __atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&m_header->write_count, index + 1, __ATOMIC_RELEASE);
+
+    m_published++;
+    m_publishNsTotal += monotonicNs() - start;
+}
+
+// Windowed FFT of the last FFT_SIZE mono samples straight into the slot.
+void AudioPublisher::analyse(musicvis_shm_slot* slot)
+{
+    for (int i = 0; i < FFT_SIZE; ++i) {
+        const float sample = m_history[(m_historyPos + i) % FFT_SIZE];
+        m_re[m_bitReverse[i]] = sample * m_window[i];
+        m_im[m_bitReverse[i]] = 0.0f;
+    }
+    // Iterative radix-2 on split real/imaginary arrays (about 5x faster here
+    // than std::complex, whose operator* takes the careful __mulsc3 path)
+    float* re = m_re.data();
+    float* im = m_im.data();
+    for (int length = 2; length <= FFT_SIZE; length <<= 1) {
+        const int half = length / 2;
+        const int stride = FFT_SIZE / length;
+        for (int base = 0; base < FFT_SIZE; base += length) {
+            for (int k = 0; k < half; ++k) {
+                const int top = base + k;
+                const int bottom = top + half;
+                const float wr = m_twiddleRe[k * stride];
+                const float wi = m_twiddleIm[k * stride];
+                const float oddRe = re[bottom] * wr - im[bottom] * wi;
+                const float oddIm = re[bottom] * wi + im[bottom] * wr;
+                re[bottom] = re[top] - oddRe;
+                im[bottom] = im[top] - oddIm;
+                re[top] += oddRe;
+                im[top] += oddIm;
+            }
+        }
+    }
+
+    // Hann window has a coherent gain of 0.5: a full-scale sine reads ~1.0
+    const float scale = 4.0f / FFT_SIZE;
+    for (size_t bin = 0; bin < MUSICVIS_SHM_SPECTRUM_BINS; ++bin) {
+        slot->spectrum[bin] = std::sqrt(re[bin] * re[bin] + im[bin] * im[bin]) * scale;
+    }
+    for (size_t band = 0; band < MUSICVIS_SHM_BANDS; ++band) {
+        float energy = 0.0f;
+        for (int bin = m_bandFirstBin[band]; bin < m_bandFirstBin[band + 1]; ++bin) {
+            energy += slot->spectrum[bin] * slot->spectrum[bin];
+        }
+        slot->bands[band] = energy;
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef AUDIOPUBLISHER_H
+#define AUDIOPUBLISHER_H
+
+#include <QString>
+#include <QtGlobal>
+#include <vector>
+
+#include "audioshm.h"
+
+// Writer side of the shared-memory ring in audioshm.h: publishes each
+// frame's PCM, a spectrum and band energies so lighting/LED processes on the
+// same machine don't have to decode and analyse the audio again. publish()
+// runs in the render loop, so it never allocates, locks or waits for
+// readers; the analysis is one 1024-point FFT over the most recent audio.
+class AudioPublisher
+{
+public:
+    static constexpr int FFT_SIZE = static_cast<int>(MUSICVIS_SHM_SPECTRUM_BINS) * 2;
+
+    AudioPublisher();
+    ~AudioPublisher();
+
+    AudioPublisher(const AudioPublisher&) = delete;
+    AudioPublisher& operator=(const AudioPublisher&) = delete;
+
+    // Creates (replacing any stale one) and maps the shared-memory object.
+    bool open(const char* name = MUSICVIS_SHM_NAME);
+    void close();
+    bool isOpen() const { return m_header != nullptr; }
+
+    // Interleaved stereo at AudioIngest::kTargetSampleRate; nullptr publishes
+    // `frames` of silence.
+    void publish(const float* stereo, size_t frames, qint64 frame);
+
+    qint64 published() const { return m_published; }
+    double averagePublishUs() const { return m_published > 0 ? m_publishNsTotal / 1000.0 / m_published : 0.0; }
+
+private:
+    void analyse(musicvis_shm_slot* slot);
+
+    QString m_name;
+    musicvis_shm_header* m_header = nullptr;
+    size_t m_size = 0;
+
+    // Last FFT_SIZE mono samples, oldest first once the ring wraps
+    std::vector<float> m_history;
+    size_t m_historyPos = 0;
+
+    std::vector<float> m_window;                 // Hann
+    std::vector<float> m_twiddleRe;
+    std::vector<float> m_twiddleIm;
+    std::vector<int> m_bitReverse;
+    std::vector<float> m_re;
+    std::vector<float> m_im;
+    std::vector<int> m_bandFirstBin;             // MUSICVIS_SHM_BANDS + 1 bin edges
+
+    qint64 m_published = 0;
+    qint64 m_publishNsTotal = 0;
+};
+
+#endif // AUDIOPUBLISHER_H
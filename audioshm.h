@@ -0,0 +1,143 @@
+/*
+ * Shared-memory layout of the audio analysis MusicVisQT publishes with
+ * --publish-audio, and inline helpers for readers. Plain C, no dependencies
+ * beyond POSIX; include it from C or C++ (link with -lrt on old glibc).
+ *
+ * The visualizer is the only writer. Every rendered frame it fills the next
+ * of MUSICVIS_SHM_SLOTS slots with the PCM it handed projectM, a magnitude
+ * spectrum and band energies, then bumps write_count. Each slot is guarded
+ * by a sequence counter (odd while being written), so readers never block
+ * the writer and can read the data in place:
+ *
+ *     size_t size;
+ *     const musicvis_shm_header* shm = musicvis_shm_open(MUSICVIS_SHM_NAME, &size);
+ *     for (;;) {
+ *         const uint64_t count = musicvis_shm_write_count(shm);
+ *         if (count == 0 || count == last) { sleep a bit; continue; }
+ *         const musicvis_shm_slot* slot = musicvis_shm_slot_at(shm, count - 1);
+ *         uint64_t seq;
+ *         if (!musicvis_shm_read_begin(slot, &seq)) { writer gone? fall back; continue; }
+ *         ... use slot->bands, slot->spectrum, slot->pcm ...
+ *         if (musicvis_shm_read_end(slot, seq)) last = count;   // else overwritten, retry
+ *     }
+ *     musicvis_shm_close(shm, size);
+ *
+ * A reader has MUSICVIS_SHM_SLOTS - 1 frames (about 100 ms at 60 fps) to
+ * finish with a slot before it is reused. Check version and the size
+ * fields; the layout only changes together with MUSICVIS_SHM_VERSION.
+ */
+#ifndef AUDIOSHM_H
+#define AUDIOSHM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MUSICVIS_SHM_NAME "/musicvis-audio"
+#define MUSICVIS_SHM_MAGIC 0x4853564Du          /* "MVSH" */
+#define MUSICVIS_SHM_VERSION 1u
+#define MUSICVIS_SHM_SLOTS 8u                   /* power of two */
+#define MUSICVIS_SHM_MAX_FRAMES 2048u           /* stereo PCM frames per slot */
+#define MUSICVIS_SHM_SPECTRUM_BINS 512u
+#define MUSICVIS_SHM_BANDS 8u
+#define MUSICVIS_SHM_READ_SPINS (1u << 20)      /* a few ms; a slot write takes microseconds */
+
+typedef struct musicvis_shm_slot {
+    uint64_t sequence;                              /* even: stable, odd: being written */
+    uint64_t frame;                                 /* render frame the audio was fed on */
+    int64_t timestamp_ns;                           /* CLOCK_MONOTONIC when published */
+    uint32_t pcm_frames;                            /* valid frames in pcm */
+    float peak;                                     /* max |sample| of this frame's PCM */
+    float pcm[MUSICVIS_SHM_MAX_FRAMES * 2];         /* interleaved L/R in [-1, 1] */
+    float spectrum[MUSICVIS_SHM_SPECTRUM_BINS];     /* magnitude; bin i is at i * sample_rate / (2 * bins) Hz */
+    float bands[MUSICVIS_SHM_BANDS];                /* energy between band_edges_hz[i] and [i + 1] */
+} musicvis_shm_slot;
+
+typedef struct musicvis_shm_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;                           /* slots start here */
+    uint32_t slot_size;
+    uint32_t slot_count;
+    uint32_t max_frames;
+    uint32_t spectrum_bins;
+    uint32_t band_count;
+    uint32_t sample_rate;                           /* of pcm; the spectrum covers 0 .. sample_rate / 2 */
+    uint32_t writer_pid;
+    float band_edges_hz[MUSICVIS_SHM_BANDS + 1];
+    uint64_t write_count;                           /* slots published so far; latest is write_count - 1 */
+} musicvis_shm_header;
+
+static inline const musicvis_shm_header* musicvis_shm_open(const char* name, size_t* size)
+{
+    const int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(musicvis_shm_header)) {
+        close(fd);
+        return NULL;
+    }
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    const musicvis_shm_header* header = (const musicvis_shm_header*)map;
+    if (header->magic != MUSICVIS_SHM_MAGIC || header->version != MUSICVIS_SHM_VERSION ||
+        header->slot_size != sizeof(musicvis_shm_slot) ||
+        (size_t)st.st_size < header->header_size + (size_t)header->slot_size * header->slot_count) {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+    *size = (size_t)st.st_size;
+    return header;
+}
+
+static inline void musicvis_shm_close(const musicvis_shm_header* header, size_t size)
+{
+    munmap((void*)header, size);
+}
+
+static inline uint64_t musicvis_shm_write_count(const musicvis_shm_header* header)
+{
+    return __atomic_load_n(&header->write_count, __ATOMIC_ACQUIRE);
+}
+
+static inline const musicvis_shm_slot* musicvis_shm_slot_at(const musicvis_shm_header* header, uint64_t index)
+{
+    const char* base = (const char*)header + header->header_size;
+    return (const musicvis_shm_slot*)(base + (size_t)(index & (header->slot_count - 1)) * header->slot_size);
+}
+
+/*
+ * Stores the sequence to hand to musicvis_shm_read_end() and returns
+ * nonzero. Spins while the slot is being written, but gives up (returns 0)
+ * after MUSICVIS_SHM_READ_SPINS tries: a writer that died mid-write leaves
+ * the slot odd for good, and the caller should not hang on it.
+ */
+static inline int musicvis_shm_read_begin(const musicvis_shm_slot* slot, uint64_t* sequence)
+{
+    uint32_t spins;
+    for (spins = 0; spins < MUSICVIS_SHM_READ_SPINS; ++spins) {
+        const uint64_t value = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if (!(value & 1u)) {
+            *sequence = value;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Nonzero if nothing was written to the slot since musicvis_shm_read_begin(). */
+static inline int musicvis_shm_read_end(const musicvis_shm_slot* slot, uint64_t sequence)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == sequence;
+}
+
+#endif /* AUDIOSHM_H */
@@ -0,0 +1,357 @@
+#include "batchrenderer.h"
+#include "audiofilereader.h"
+#include "audioingest.h"
+#include "offscreenrenderer.h"
+
+#include <Audio/PCM.hpp>
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QProcess>
+#include <QThread>
+#include <QTimer>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <random>
+
+const int THREADS_PER_WORKER = 2;       // llvmpipe threads per worker when the pool is sized automatically
+const int PROGRESS_INTERVAL_MS = 1000;
+const int PROGRESS_EVERY_FRAMES = 30;   // worker -> master progress lines
+
+namespace {
+
+struct JobState {
+    qint64 done = 0;
+    qint64 total = 0;       // known once the worker opened the audio
+    QElapsedTimer timer;
+};
+
+QString formatDuration(qint64 ms)
+{
+    const qint64 seconds = ms / 1000;
+    return seconds >= 60 ? QString("%1m%2s").arg(seconds / 60).arg(seconds % 60, 2, 10, QChar('0'))
+                         : QString("%1.%2s").arg(seconds).arg((ms % 1000) / 100);
+}
+
+std::vector<std::string> presetsFor(const BatchRenderer::Job& job, const QString& presetDir)
+{
+    std::vector<std::string> presets;
+    for (const QString& preset : job.presets) {
+        presets.push_back(preset.toStdString());
+    }
+    if (!presets.empty()) {
+        return presets;
+    }
+    try {
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(presetDir.toStdString())) {
+            if (entry.is_regular_file() && entry.path().extension() == ".milk") {
+                presets.push_back(entry.path().string());
+            }
+        }
+    } catch (const std::exception& e) {
+        qWarning() << "Error listing presets in" << presetDir << "-" << e.what();
+    }
+    // Sorted first so a seed picks the same sequence on every machine
+    std::sort(presets.begin(), presets.end());
+    std::mt19937 rng(job.seed);
+    std::shuffle(presets.begin(), presets.end(), rng);
+    return presets;
+}
+
+}
+
+BatchRenderer::Job BatchRenderer::Job::fromJson(const QJsonObject& object)
+{
+    Job job;
+    job.audio = object.value("audio").toString();
+    job.output = object.value("output").toString();
+    for (const QJsonValue& value : object.value("presets").toArray()) {
+        job.presets << value.toString();
+    }
+    job.presetDir = object.value("presetDir").toString();
+    job.seed = static_cast<quint32>(object.value("seed").toInteger(0));
+    job.presetDuration = object.value("presetDuration").toDouble(job.presetDuration);
+    job.width = object.value("width").toInt(job.width);
+    job.height = object.value("height").toInt(job.height);
+    job.fps = object.value("fps").toInt(job.fps);
+    return job;
+}
+
+QJsonObject BatchRenderer::Job::toJson() const
+{
+    QJsonObject object;
+    object["audio"] = audio;
+    object["output"] = output;
+    object["presets"] = QJsonArray::fromStringList(presets);
+    object["presetDir"] = presetDir;
+    object["seed"] = static_cast<qint64>(seed);
+    object["presetDuration"] = presetDuration;
+    object["width"] = width;
+    object["height"] = height;
+    object["fps"] = fps;
+    return object;
+}
+
+bool BatchRenderer::load(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qCritical() << "Cannot open job list" << path << "-" << file.errorString();
+        return false;
+    }
+    // Relative paths in the job list are relative to the job list
+    const QDir base = QFileInfo(path).absoluteDir();
+    auto resolve = [&](const QString& p) { return p.isEmpty() ? p : QDir::cleanPath(base.absoluteFilePath(p)); };
+
+    m_jobs.clear();
+    int lineNumber = 0;
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine().trimmed();
+        ++lineNumber;
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+        QJsonParseError error;
+        const QJsonDocument doc = QJsonDocument::fromJson(line, &error);
+        if (!doc.isObject()) {
+            qCritical() << "Job list line" << lineNumber << "is not valid JSON:" << error.errorString();
+            return false;
+        }
+        Job job = Job::fromJson(doc.object());
+        if (job.audio.isEmpty() || job.output.isEmpty() || job.width <= 0 || job.height <= 0 || job.fps <= 0) {
+            qCritical() << "Job list line" << lineNumber << "needs audio, output and a positive size and fps";
+            return false;
+        }
+        job.audio = resolve(job.audio);
+        job.output = resolve(job.output);
+        job.presetDir = resolve(job.presetDir);
+        for (QString& preset : job.presets) {
+            preset = resolve(preset);
+        }
+        m_jobs.push_back(job);
+    }
+    return true;
+}
+
+int BatchRenderer::run(const Options& options)
+{
+    if (!load(options.jobFile)) {
+        return 2;
+    }
+    if (m_jobs.isEmpty()) {
+        qCritical() << "Job list is empty:" << options.jobFile;
+        return 2;
+    }
+
+    const int cores = std::max(1, QThread::idealThreadCount());
+    int workers = options.workers > 0 ? options.workers : std::max(1, cores / THREADS_PER_WORKER);
+    workers = std::min(workers, static_cast<int>(m_jobs.size()));
+    const int threadsPerWorker = std::max(1, cores / workers);
+
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    if (!environment.contains("QT_QPA_PLATFORM")) {
+        environment.insert("QT_QPA_PLATFORM", "offscreen");
+    }
+    if (!environment.contains("LP_NUM_THREADS")) {
+        environment.insert("LP_NUM_THREADS", QString::number(threadsPerWorker));
+    }
+    qInfo() << "Batch:" << m_jobs.size() << "jobs on" << workers << "workers," << threadsPerWorker
+            << "rasterizer threads each (" << cores << "cores )";
+
+    QVector<JobState> states(m_jobs.size());
+    int nextJob = 0;
+    int running = 0;
+    int finished = 0;
+    int failed = 0;
+    QEventLoop loop;
+    QElapsedTimer wall;
+    wall.start();
+
+    auto framesDone = [&]() {
+        qint64 frames = 0;
+        for (const JobState& state : states) {
+            frames += state.done;
+        }
+        return frames;
+    };
+
+    std::function<void()> startNext;
+    auto jobEnded = [&](int index, bool ok, const QString& reason) {
+        finished++;
+        running--;
+        if (!ok) {
+            failed++;
+            qWarning().noquote() << QString("Job %1 failed (%2), see %3.log").arg(index + 1).arg(reason, m_jobs[index].output);
+        } else {
+            const JobState& state = states[index];
+            qInfo().noquote() << QString("Job %1/%2 done: %3 frames in %4 (%5 fps) -> %6")
+                                     .arg(index + 1).arg(m_jobs.size()).arg(state.done)
+                                     .arg(formatDuration(state.timer.elapsed()))
+                                     .arg(state.done * 1000.0 / std::max<qint64>(state.timer.elapsed(), 1), 0, 'f', 1)
+                                     .arg(m_jobs[index].output);
+        }
+        if (finished == m_jobs.size()) {
+            loop.quit();
+        } else {
+            startNext();
+        }
+    };
+
+    startNext = [&]() {
+        while (running < workers && nextJob < m_jobs.size()) {
+            const int index = nextJob++;
+            const Job& job = m_jobs[index];
+            QDir().mkpath(QFileInfo(job.output).absolutePath());
+
+            auto* process = new QProcess();
+            process->setProcessEnvironment(environment);
+            process->setStandardErrorFile(job.output + ".log");
+            auto readProgress = [&states, process, index]() {
+                while (process->canReadLine()) {
+                    const QList<QByteArray> parts = process->readLine().trimmed().split(' ');
+                    if (parts.size() == 3 && parts[0] == "progress") {
+                        states[index].done = parts[1].toLongLong();
+                        states[index].total = parts[2].toLongLong();
+                    }
+                }
+            };
+            QObject::connect(process, &QProcess::readyReadStandardOutput, readProgress);
+            QObject::connect(process, &QProcess::finished, [&, process, index, readProgress](int exitCode, QProcess::ExitStatus status) {
+                readProgress();
+                process->deleteLater();
+                const bool ok = status == QProcess::NormalExit && exitCode == 0;
+                jobEnded(index, ok, status == QProcess::NormalExit ? QString("exit code %1").arg(exitCode)
+                                                                   : QString("crashed"));
+            });
+            QObject::connect(process, &QProcess::errorOccurred, [&, process, index](QProcess::ProcessError error) {
+                // finished() never comes for a process that didn't start
+                if (error == QProcess::FailedToStart) {
+                    process->deleteLater();
+                    jobEnded(index, false, process->errorString());
+                }
+            });
+
+            states[index].timer.start();
+            running++;
+            process->start(QCoreApplication::applicationFilePath(),
+                           {"--render-job", QString::fromUtf8(QJsonDocument(job.toJson()).toJson(QJsonDocument::Compact))});
+        }
+    };
+
+    qint64 lastFrames = 0;
+    QTimer progress;
+    QObject::connect(&progress, &QTimer::timeout, [&]() {
+        const qint64 frames = framesDone();
+        qint64 known = 0;
+        for (const JobState& state : states) {
+            known += state.total;
+        }
+        const double seconds = wall.elapsed() / 1000.0;
+        qInfo().noquote() << QString("Batch: %1/%2 jobs done, %3 running | %4 frames%5 | %6 fps aggregate, %7 fps now")
+                                 .arg(finished).arg(m_jobs.size()).arg(running).arg(frames)
+                                 .arg(known > 0 ? QString(" of %1 started").arg(known) : QString())
+                                 .arg(seconds > 0 ? frames / seconds : 0.0, 0, 'f', 1)
+                                 .arg((frames - lastFrames) * 1000.0 / PROGRESS_INTERVAL_MS, 0, 'f', 1);
+        lastFrames = frames;
+    });
+    progress.start(PROGRESS_INTERVAL_MS);
+
+    startNext();
+    if (finished < m_jobs.size()) {
+        loop.exec();
+    }
+    progress.stop();
+
+    const qint64 frames = framesDone();
+    const double seconds = std::max(wall.elapsed(), qint64(1)) / 1000.0;
+    qInfo().noquote() << QString("Batch finished: %1 jobs (%2 failed) in %3, %4 frames, %5 fps aggregate "
+                                 "(%6 fps per worker)")
+                             .arg(m_jobs.size()).arg(failed).arg(formatDuration(wall.elapsed())).arg(frames)
+                             .arg(frames / seconds, 0, 'f', 1).arg(frames / seconds / workers, 0, 'f', 1);
+    return failed > 0 ? 1 : 0;
+}
+
+int BatchRenderer::renderJob(const QString& jobJson)
+{
+    const Job job = Job::fromJson(QJsonDocument::fromJson(jobJson.toUtf8()).object());
+    const QString presetDir = job.presetDir.isEmpty() ? QCoreApplication::applicationDirPath() + "/../presets/"
+                                                      : job.presetDir;
+    const std::vector<std::string> presets = presetsFor(job, presetDir);
+
+    OffscreenRenderer renderer;
+    if (!renderer.initialize(job.width, job.height, OffscreenRenderer::defaultTexturePaths(presetDir.toStdString()))) {
+        qCritical() << "Could not create offscreen renderer.";
+        return 1;
+    }
+
+    // One video frame's worth of audio per frame, so the output stays in sync with the track
+    AudioFileReader audio;
+    const size_t chunkFrames = static_cast<size_t>(std::lround(double(AudioIngest::kTargetSampleRate) / job.fps));
+    if (!audio.open(job.audio, chunkFrames) || audio.sampleRate() <= 0) {
+        qCritical() << "Cannot open audio" << job.audio;
+        return 1;
+    }
+    const qint64 totalFrames = static_cast<qint64>(std::ceil(double(audio.length()) / audio.sampleRate() * job.fps));
+
+    QFile raw;
+    const bool rawOutput = job.output.endsWith(".rgba");
+    if (rawOutput) {
+        raw.setFileName(job.output);
+        if (!raw.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qCritical() << "Cannot write" << job.output << "-" << raw.errorString();
+            return 1;
+        }
+    } else if (!QDir().mkpath(job.output)) {
+        qCritical() << "Cannot create output directory" << job.output;
+        return 1;
+    }
+
+    qInfo() << "Rendering" << job.audio << ":" << totalFrames << "frames at" << job.width << "x" << job.height
+            << job.fps << "fps," << presets.size() << "presets on" << renderer.rendererName();
+
+    const qint64 framesPerPreset = std::max<qint64>(1, std::llround(job.presetDuration * job.fps));
+    QElapsedTimer timer;
+    timer.start();
+    for (qint64 frame = 0; frame < totalFrames; ++frame) {
+        if (frame % framesPerPreset == 0 && !presets.empty()) {
+            renderer.loadPreset(presets[static_cast<size_t>(frame / framesPerPreset) % presets.size()]);
+        }
+        size_t frames = 0;
+        const float* stereo = audio.readChunk(&frames);
+        if (frames > 0) {
+            renderer.pcm().Add(stereo, 2, frames);
+        }
+        renderer.renderFrame(static_cast<double>(frame) / job.fps);
+
+        const QImage image = renderer.grabFrame().convertToFormat(QImage::Format_RGBA8888);
+        bool written;
+        if (rawOutput) {
+            written = raw.write(reinterpret_cast<const char*>(image.constBits()), image.sizeInBytes()) ==
+                      image.sizeInBytes();
+        } else {
+            written = image.save(QString("%1/frame_%2.png").arg(job.output).arg(frame + 1, 6, 10, QChar('0')));
+        }
+        if (!written) {
+            qCritical() << "Writing frame" << frame << "failed";
+            return 1;
+        }
+
+        if ((frame + 1) % PROGRESS_EVERY_FRAMES == 0 || frame + 1 == totalFrames) {
+            std::printf("progress %lld %lld\n", static_cast<long long>(frame + 1), static_cast<long long>(totalFrames));
+            std::fflush(stdout);
+        }
+    }
+    qInfo() << "Rendered" << totalFrames << "frames in" << timer.elapsed() << "ms";
+    return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef BATCHRENDERER_H
+#define BATCHRENDERER_H
+
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Offline rendering of many tracks at once. A job list (JSON lines, one job
+// per line) is farmed out to a pool of worker processes, each running one
+// job at a time on its own offscreen context and projectM instance:
+//
+//   {"audio": "01.flac", "output": "out/01.rgba", "width": 1920, "height": 1080, "fps": 60,
+//    "presets": ["a.milk", "b.milk"], "presetDuration": 20}
+//   {"audio": "02.flac", "output": "out/02", "seed": 7}
+//
+// Without "presets", every preset under "presetDir" (default: the bundled
+// presets) is shuffled with "seed". Audio is fed in real time per frame
+// (sample rate / fps frames), so the output runs as long as the track.
+// Output ending in .rgba is one raw RGBA stream (for ffmpeg -f rawvideo);
+// anything else is a directory of numbered PNGs. Each worker's log goes
+// next to its output as <output>.log.
+//
+// Processes rather than threads: projectM keeps global state, and a crash
+// in one job doesn't take the batch down. The pool is sized from the core
+// count, and under llvmpipe each worker's rasterizer threads are capped so
+// the workers together don't oversubscribe the machine.
+class BatchRenderer
+{
+public:
+    struct Options {
+        QString jobFile;
+        int workers = 0;                // 0: from the core count
+    };
+
+    struct Job {
+        QString audio;
+        QString output;
+        QStringList presets;
+        QString presetDir;
+        quint32 seed = 0;
+        double presetDuration = 30.0;   // seconds
+        int width = 1280;
+        int height = 720;
+        int fps = 60;
+
+        static Job fromJson(const QJsonObject& object);
+        QJsonObject toJson() const;
+    };
+
+    // Runs the whole batch; returns 0 if every job succeeded, 1 if any
+    // failed, 2 if the batch could not start.
+    int run(const Options& options);
+
+    // Worker side: renders one job (compact JSON) and reports progress on stdout.
+    static int renderJob(const QString& jobJson);
+
+private:
+    bool load(const QString& path);
+
+    QVector<Job> m_jobs;
+};
+
+#endif // BATCHRENDERER_H
@@ -0,0 +1,406 @@
+#include "benchmarks.h"
+#include "audioingest.h"
+#include "frametimestats.h"
+#include "logging.h"
+#include "offscreenrenderer.h"
+#include "presetpack.h"
+#include "thumbnailatlas.h"
+#include "waveformpeaks.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Keeps the optimizer from deleting the work we are trying to time.
+volatile float g_sink = 0.0f;
+
+// Runs fn for `iterations` and reports throughput in samples/second.
+void report(const char* name, size_t samplesPerIteration, int iterations, const std::function<void()>& fn)
+{
+    // warm caches and branch predictors first
+    for (int i = 0; i < iterations / 10 + 1; ++i) fn();
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < iterations; ++i) fn();
+    const qint64 ns = timer.nsecsElapsed();
+
+    const double seconds = ns / 1e9;
+    const double msamples = (static_cast<double>(samplesPerIteration) * iterations) / seconds / 1e6;
+    qInfo().noquote() << QString("  %1: %2 ns/iter, %3 Msamples/s")
+                                 .arg(QString::fromLatin1(name), -28)
+                                 .arg(ns / iterations, 8)
+                                 .arg(msamples, 0, 'f', 1);
+}
+
+int benchIngest()
+{
+    const size_t frames = 4096;
+    const int iterations = 20000;
+    qInfo() << "Audio ingest kernels," << frames << "frames per iteration:";
+
+    std::vector<int16_t> pcm16(frames * 2);
+    std::vector<uint8_t> pcm24(frames * 2 * 3);
+    std::vector<int32_t> pcm32(frames * 2);
+    std::vector<float> pcmFloat(frames * 8);
+    for (size_t i = 0; i < pcmFloat.size(); ++i) {
+        pcmFloat[i] = std::sin(static_cast<float>(i) * 0.01f) * 0.8f;
+    }
+    for (size_t i = 0; i < pcm16.size(); ++i) {
+        pcm16[i] = static_cast<int16_t>(pcmFloat[i] * 32767.0f);
+        pcm32[i] = static_cast<int32_t>(pcmFloat[i] * 2147483000.0f);
+        const int32_t v = static_cast<int32_t>(pcmFloat[i] * 8388607.0f);
+        pcm24[3 * i] = static_cast<uint8_t>(v & 0xff);
+        pcm24[3 * i + 1] = static_cast<uint8_t>((v >> 8) & 0xff);
+        pcm24[3 * i + 2] = static_cast<uint8_t>((v >> 16) & 0xff);
+    }
+    std::vector<float> out(frames * 8);
+    std::vector<int16_t> out16(frames * 2);
+
+    report("int16 -> float", frames * 2, iterations, [&] {
+        AudioIngest::int16ToFloat(pcm16.data(), out.data(), frames * 2);
+        g_sink = out[frames];
+    });
+    report("int24 -> float", frames * 2, iterations, [&] {
+        AudioIngest::int24ToFloat(pcm24.data(), out.data(), frames * 2);
+        g_sink = out[frames];
+    });
+    report("int32 -> float", frames * 2, iterations, [&] {
+        AudioIngest::int32ToFloat(pcm32.data(), out.data(), frames * 2);
+        g_sink = out[frames];
+    });
+    report("float -> int16", frames * 2, iterations, [&] {
+        AudioIngest::floatToInt16(pcmFloat.data(), out16.data(), frames * 2);
+        g_sink = out16[frames];
+    });
+    report("mono -> stereo", frames, iterations, [&] {
+        AudioIngest::monoToStereo(pcmFloat.data(), out.data(), frames);
+        g_sink = out[frames];
+    });
+
+    for (int channels : {6, 8}) {
+        std::vector<float> matrix(channels * 2);
+        AudioIngest::buildDownmixMatrix(channels, matrix.data());
+        const QByteArray label = QString("downmix %1ch -> stereo").arg(channels).toUtf8();
+        report(label.constData(), frames * channels, iterations, [&] {
+            AudioIngest::downmixToStereo(pcmFloat.data(), channels, matrix.data(), out.data(), frames);
+            g_sink = out[frames];
+        });
+    }
+
+    for (int rate : {48000, 96000}) {
+        AudioIngest stage;
+        stage.configure(2, rate, frames);
+        const QByteArray label = QString("resample %1 -> %2").arg(rate).arg(AudioIngest::kTargetSampleRate).toUtf8();
+        report(label.constData(), frames * 2, iterations, [&] {
+            size_t produced = 0;
+            const float* result = stage.process(pcmFloat.data(), AudioIngest::SampleFormat::Float32, frames, &produced);
+            g_sink = result[produced / 2];
+        });
+    }
+
+    {
+        // The full path a 96 kHz 5.1 int24 file takes
+        AudioIngest stage;
+        stage.configure(6, 96000, frames / 3);
+        report("full: 5.1/int24/96k", (frames / 3) * 6, iterations, [&] {
+            size_t produced = 0;
+            const float* result = stage.process(pcm24.data(), AudioIngest::SampleFormat::Int24, frames / 3, &produced);
+            g_sink = result[0];
+        });
+    }
+
+    return 0;
+}
+
+int benchAtlas()
+{
+    const QString presetRoot = QCoreApplication::applicationDirPath() + "/../presets/";
+    QTemporaryDir dir;
+    const QString atlasPath = dir.filePath("bench.atlas");
+
+    ThumbnailAtlas::BuildStats full;
+    if (!ThumbnailAtlas::build(presetRoot, atlasPath, ThumbnailAtlas::DEFAULT_TILE_SIZE, &full)) {
+        return 1;
+    }
+    qInfo().noquote() << QString("  full build: %1 presets in %2 ms (%3 decodes/s)")
+                             .arg(full.entries).arg(full.elapsedMs)
+                             .arg(full.decoded * 1000.0 / std::max<qint64>(full.elapsedMs, 1), 0, 'f', 0);
+    ThumbnailAtlas::BuildStats incremental;
+    ThumbnailAtlas::build(presetRoot, atlasPath, ThumbnailAtlas::DEFAULT_TILE_SIZE, &incremental);
+    qInfo().noquote() << QString("  unchanged rebuild: %1 ms").arg(incremental.elapsedMs);
+
+    // What a browser grid does when it scrolls to a new page of thumbnails
+    const int pageTiles = 256;
+    ThumbnailAtlas atlas;
+    QElapsedTimer timer;
+    timer.start();
+    if (!atlas.open(atlasPath)) {
+        return 1;
+    }
+    const int first = std::max(0, atlas.count() / 2 - pageTiles / 2);
+    const int count = std::min(pageTiles, atlas.count() - first);
+    atlas.prefetch(first, count);
+    unsigned sum = 0;
+    for (int level = 0; level < atlas.levels(); ++level) {
+        const size_t bytes = static_cast<size_t>(atlas.levelSize(level)) * atlas.levelSize(level) * 4 * count;
+        const uchar* data = atlas.tiles(level, first);
+        for (size_t i = 0; i < bytes; i += 64) {
+            sum += data[i];
+        }
+    }
+    g_sink = static_cast<float>(sum);
+    qInfo().noquote() << QString("  open + page in %1 tiles (all mips): %2 us")
+                             .arg(count).arg(timer.nsecsElapsed() / 1000);
+    return 0;
+}
+
+int benchPack()
+{
+    const QString presetRoot = QCoreApplication::applicationDirPath() + "/../presets/";
+    QTemporaryDir dir;
+    const QString packPath = dir.filePath("bench.pack");
+
+    PresetPack::BuildStats stats;
+    if (!PresetPack::build(presetRoot, packPath, true, &stats)) {
+        return 1;
+    }
+    qInfo().noquote() << QString("  build: %1 presets, %2 compressed, %3 KB -> %4 KB in %5 ms")
+                             .arg(stats.entries).arg(stats.compressed)
+                             .arg(stats.rawBytes >> 10).arg(stats.fileBytes >> 10).arg(stats.elapsedMs);
+
+    // Every preset's text, the way startup + a full cycle would get at it.
+    // The page cache is warm for both, so this is the syscall and lookup cost.
+    QElapsedTimer timer;
+    timer.start();
+    qint64 bytes = 0;
+    QDirIterator it(presetRoot, QStringList() << "*.milk", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        QFile file(it.next());
+        if (file.open(QIODevice::ReadOnly)) {
+            bytes += file.readAll().size();
+        }
+    }
+    qInfo().noquote() << QString("  walk + read files: %1 ms (%2 KB)").arg(timer.elapsed()).arg(bytes >> 10);
+
+    timer.restart();
+    bytes = 0;
+    PresetPack pack;
+    if (!pack.open(packPath)) {
+        return 1;
+    }
+    for (int i = 0; i < pack.count(); ++i) {
+        bytes += pack.body(pack.indexOf(pack.keyAt(i))).size();
+    }
+    qInfo().noquote() << QString("  open pack + look up and inflate all: %1 ms (%2 KB)")
+                             .arg(timer.elapsed()).arg(bytes >> 10);
+    return 0;
+}
+
+int benchLogging()
+{
+    const int iterations = 1000000;
+    auto perCall = [](const char* name, int calls, const std::function<void()>& fn) {
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < calls; ++i) fn();
+        qInfo().noquote() << QString("  %1: %2 ns/call")
+                                 .arg(QString::fromLatin1(name), -28)
+                                 .arg(static_cast<double>(timer.nsecsElapsed()) / calls, 0, 'f', 1);
+    };
+    qInfo() << "Hot-path logging cost, compile-time minimum level" << MUSICVIS_LOG_MIN_LEVEL;
+
+    const int savedLevel = Log::g_levels[static_cast<int>(Log::Category::Render)].load();
+    Log::setOutputEnabled(false);
+    Log::setLevel(Log::Category::Render, Log::Level::Info);
+    double fps = 59.9;
+
+    perCall("below compile-time level", iterations, [&] {
+        MVLOG(Trace, Render, "FPS: %.1f", fps);
+    });
+    Log::setLevel(Log::Category::Render, Log::Level::Warning);
+    perCall("category disabled", iterations, [&] {
+        MVLOG(Info, Render, "FPS: %.1f", fps);
+    });
+    Log::setLevel(Log::Category::Render, Log::Level::Info);
+    perCall("rate-limited (suppressed)", iterations, [&] {
+        MVLOG_EVERY_MS(60000, Info, Render, "FPS: %.1f", fps);
+    });
+
+    // Enabled writes, in batches the flusher can drain so we time the write and not the full-ring path
+    const int batch = 512;
+    const int batches = 200;
+    const Log::Stats before = Log::stats();
+    qint64 ns = 0;
+    for (int b = 0; b < batches; ++b) {
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < batch; ++i) {
+            MVLOG(Info, Render, "FPS: %.1f", fps);
+        }
+        ns += timer.nsecsElapsed();
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    }
+    const Log::Stats after = Log::stats();
+    qInfo().noquote() << QString("  %1: %2 ns/call (%3 dropped)")
+                             .arg(QString::fromLatin1("enabled, into ring"), -28)
+                             .arg(static_cast<double>(ns) / (batch * batches), 0, 'f', 1)
+                             .arg(after.dropped - before.dropped);
+
+    // What the render loop used to do: qInfo formatting straight to the message handler
+    QtMessageHandler previous = qInstallMessageHandler([](QtMsgType, const QMessageLogContext&, const QString&) {});
+    perCall("qInfo() (null handler)", iterations / 10, [&] {
+        qInfo() << "FPS:" << fps;
+    });
+    qInstallMessageHandler(previous);
+
+    Log::setOutputEnabled(true);
+    Log::g_levels[static_cast<int>(Log::Category::Render)].store(savedLevel);
+    return 0;
+}
+
+// A window dragged around for two seconds: 8 resize events per 60 Hz frame
+// (a fast pointer), applied per event like resizeEvent() used to, or once
+// per frame. Needs a GL context; QT_QPA_PLATFORM=offscreen works.
+int benchResize()
+{
+    const int frames = 120;
+    const int resizesPerFrame = 8;
+    const std::vector<std::string> texturePaths = OffscreenRenderer::defaultTexturePaths(
+        (QCoreApplication::applicationDirPath() + "/../presets/").toStdString());
+
+    auto storm = [&](const char* name, int perFrame, bool coalesced) {
+        OffscreenRenderer renderer;
+        if (!renderer.initialize(1120, 630, texturePaths)) {
+            return false;
+        }
+        std::vector<double> frameTimesMs;
+        frameTimesMs.reserve(frames);
+        for (int frame = 0; frame < frames; ++frame) {
+            QElapsedTimer timer;
+            timer.start();
+            for (int i = 0; i < perFrame; ++i) {
+                const double t = (frame * perFrame + i) * 4.0 * M_PI / (frames * perFrame);
+                renderer.resize(1120 + static_cast<int>(480 * std::sin(t)),
+                                630 + static_cast<int>(270 * std::sin(t * 1.3)));
+                if (!coalesced) {
+                    renderer.applyPendingResize();
+                }
+            }
+            renderer.renderFrame(frame / 60.0);
+            frameTimesMs.push_back(timer.nsecsElapsed() / 1e6);
+        }
+        const ResizeCoalescer::Stats& stats = renderer.resizeStats();
+        qInfo().noquote() << QString("  %1: %2 | %3 resizes, %4 applied, %5 FBO allocations")
+                                 .arg(QString::fromLatin1(name), -20)
+                                 .arg(FrameTimeStats::compute(frameTimesMs).toString())
+                                 .arg(stats.requests).arg(stats.applied).arg(stats.allocations);
+        return true;
+    };
+
+    if (!storm("no resizes", 0, true)) {
+        return 1;
+    }
+    storm("applied per event", resizesPerFrame, false);
+    storm("coalesced", resizesPerFrame, true);
+    return 0;
+}
+
+// The reduction behind every waveform peak bucket, against a plain loop.
+int benchPeaks()
+{
+    const size_t samples = static_cast<size_t>(WaveformPeaks::BASE_BUCKET_FRAMES) * 2;
+    const int iterations = 200000;
+    qInfo() << "Waveform peak reduction," << samples << "samples per bucket:";
+
+    std::vector<float> pcm(samples);
+    for (size_t i = 0; i < pcm.size(); ++i) {
+        pcm[i] = std::sin(static_cast<float>(i) * 0.01f) * 0.8f;
+    }
+    report("min/max/sum of squares", samples, iterations, [&] {
+        float lo = 0.0f;
+        float hi = 0.0f;
+        float sumSquares = 0.0f;
+        WaveformPeaks::reduce(pcm.data(), samples, &lo, &hi, &sumSquares);
+        g_sink = lo + hi + sumSquares;
+    });
+    report("scalar reference", samples, iterations, [&] {
+        float lo = pcm[0];
+        float hi = pcm[0];
+        float sumSquares = 0.0f;
+        for (size_t i = 0; i < samples; ++i) {
+            lo = std::min(lo, pcm[i]);
+            hi = std::max(hi, pcm[i]);
+            sumSquares += pcm[i] * pcm[i];
+        }
+        g_sink = lo + hi + sumSquares;
+    });
+
+    // Not a timing, but the only thing that exercises the pyramid without a track
+    const bool pyramidOk = WaveformPeaks::checkPyramid(300);
+    qInfo() << "  pyramid vs. brute-force reduction, 1-300 buckets:" << (pyramidOk ? "ok" : "MISMATCH");
+    return pyramidOk ? 0 : 1;
+}
+
+struct Benchmark {
+    const char* name;
+    std::function<int()> fn;
+};
+
+const std::vector<Benchmark>& registry()
+{
+    static const std::vector<Benchmark> benchmarks = {
+        {"ingest", benchIngest},
+        {"atlas", benchAtlas},
+        {"pack", benchPack},
+        {"logging", benchLogging},
+        {"resize", benchResize},
+        {"peaks", benchPeaks},
+    };
+    return benchmarks;
+}
+
+} // namespace
+
+namespace Benchmarks {
+
+QStringList available()
+{
+    QStringList names;
+    for (const auto& b : registry()) {
+        names << QString::fromLatin1(b.name);
+    }
+    return names;
+}
+
+int run(const QString& name)
+{
+    int result = 0;
+    bool found = false;
+    for (const auto& b : registry()) {
+        if (name == "all" || name == QLatin1String(b.name)) {
+            found = true;
+            qInfo().noquote() << "=== benchmark:" << b.name << "===";
+            result |= b.fn();
+        }
+    }
+    if (!found) {
+        qWarning() << "Unknown benchmark:" << name << "- available:" << available().join(", ");
+        return 2;
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,18 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <QString>
+#include <QStringList>
+
+// Built-in microbenchmarks, run with --benchmark <name> (or "all").
+// They run headless and print one line per measurement via qInfo.
+namespace Benchmarks {
+
+QStringList available();
+
+// Returns a process exit code (0 on success).
+int run(const QString& name);
+
+}
+
+#endif // BENCHMARKS_H
@@ -0,0 +1,144 @@
+#include "decodecache.h"
+#include "mappedaudiofile.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <sndfile.h>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const int DECODE_BLOCK_FRAMES = 16384;
+
+QMutex s_pendingMutex;
+QSet<QString> s_pending; // sidecar paths currently being written
+
+QString cacheDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/decoded";
+}
+
+void decodeToSidecar(const QString& sourcePath, const QString& sidecar)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    SF_INFO inInfo;
+    memset(&inInfo, 0, sizeof(inInfo));
+    SNDFILE* in = sf_open(QFile::encodeName(sourcePath).constData(), SFM_READ, &inInfo);
+    if (!in) {
+        qWarning() << "Decode cache: cannot open" << sourcePath << "-" << sf_strerror(NULL);
+        return;
+    }
+
+    SF_INFO outInfo;
+    memset(&outInfo, 0, sizeof(outInfo));
+    outInfo.samplerate = inInfo.samplerate;
+    outInfo.channels = inInfo.channels;
+    outInfo.format = SF_FORMAT_RF64 | SF_FORMAT_FLOAT;
+
+    // Write under a temporary name so a half-written sidecar is never picked up
+    const QString tmpPath = sidecar + ".part";
+    SNDFILE* out = sf_open(QFile::encodeName(tmpPath).constData(), SFM_WRITE, &outInfo);
+    if (!out) {
+        qWarning() << "Decode cache: cannot create" << tmpPath << "-" << sf_strerror(NULL);
+        sf_close(in);
+        return;
+    }
+    // Plain WAV header unless the result really needs 64-bit sizes
+    sf_command(out, SFC_RF64_AUTO_DOWNGRADE, NULL, SF_TRUE);
+
+    std::vector<float> block(static_cast<size_t>(DECODE_BLOCK_FRAMES) * inInfo.channels);
+    bool ok = true;
+    sf_count_t total = 0;
+    sf_count_t got = 0;
+    while ((got = sf_readf_float(in, block.data(), DECODE_BLOCK_FRAMES)) > 0) {
+        if (sf_writef_float(out, block.data(), got) != got) {
+            ok = false;
+            break;
+        }
+        total += got;
+    }
+    sf_close(out);
+    sf_close(in);
+
+    if (!ok || total == 0) {
+        qWarning() << "Decode cache: failed writing" << tmpPath;
+        QFile::remove(tmpPath);
+        return;
+    }
+    QFile::remove(sidecar);
+    if (!QFile::rename(tmpPath, sidecar)) {
+        qWarning() << "Decode cache: could not finalize" << sidecar;
+        QFile::remove(tmpPath);
+        return;
+    }
+    qInfo() << "Decode cache: wrote" << total << "frames for" << QFileInfo(sourcePath).fileName()
+            << "in" << timer.elapsed() << "ms";
+}
+
+}
+
+namespace DecodeCache {
+
+QString sidecarPath(const QString& sourcePath)
+{
+    const QFileInfo info(sourcePath);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(info.absoluteFilePath().toUtf8());
+    hash.addData(QByteArray::number(info.size()));
+    hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+    return cacheDir() + "/" + QString::fromLatin1(hash.result().toHex()) + ".f32.wav";
+}
+
+QString lookup(const QString& sourcePath)
+{
+    const QString sidecar = sidecarPath(sourcePath);
+    {
+        QMutexLocker locker(&s_pendingMutex);
+        if (s_pending.contains(sidecar)) {
+            return QString();
+        }
+    }
+    return QFileInfo::exists(sidecar) ? sidecar : QString();
+}
+
+bool isCacheable(const QString& sourcePath)
+{
+    return !MappedAudioFile::isCandidate(sourcePath);
+}
+
+void decodeInBackground(const QString& sourcePath)
+{
+    const QString sidecar = sidecarPath(sourcePath);
+    if (QFileInfo::exists(sidecar)) {
+        return;
+    }
+    {
+        QMutexLocker locker(&s_pendingMutex);
+        if (s_pending.contains(sidecar)) {
+            return;
+        }
+        s_pending.insert(sidecar);
+    }
+    QDir().mkpath(cacheDir());
+
+    QThreadPool::globalInstance()->start([sourcePath, sidecar]() {
+        decodeToSidecar(sourcePath, sidecar);
+        QMutexLocker locker(&s_pendingMutex);
+        s_pending.remove(sidecar);
+    });
+}
+
+}
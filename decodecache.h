@@ -0,0 +1,27 @@
+#ifndef DECODECACHE_H
+#define DECODECACHE_H
+
+#include <QString>
+
+// Optional on-disk cache of compressed inputs (FLAC/OGG/...) decoded once to
+// float WAV, so later plays can go through MappedAudioFile instead of
+// decoding every chunk. Sidecars are keyed by path, size and mtime and live
+// under the user's cache directory.
+namespace DecodeCache {
+
+// Where the sidecar for `sourcePath` lives (whether or not it exists yet).
+QString sidecarPath(const QString& sourcePath);
+
+// Path to a complete sidecar for `sourcePath`, or an empty string.
+QString lookup(const QString& sourcePath);
+
+// Decodes `sourcePath` into its sidecar on the global thread pool. No-op if
+// the sidecar exists or a decode for it is already running.
+void decodeInBackground(const QString& sourcePath);
+
+// True if the format can't be mapped directly and is worth caching.
+bool isCacheable(const QString& sourcePath);
+
+}
+
+#endif // DECODECACHE_H
@@ -0,0 +1,56 @@
+#include "framearena.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+
+FrameArena::FrameArena(size_t capacity)
+    : m_buffer(new unsigned char[capacity])
+    , m_capacity(capacity)
+{
+}
+
+void FrameArena::reset()
+{
+    m_used = 0;
+}
+
+void* FrameArena::allocate(size_t bytes, size_t alignment)
+{
+    const size_t start = (m_used + alignment - 1) & ~(alignment - 1);
+    if (start + bytes > m_capacity) {
+        m_overflows++;
+        return nullptr;
+    }
+    m_used = start + bytes;
+    m_peak = std::max(m_peak, m_used);
+    return m_buffer.get() + start;
+}
+
+const char* FrameArena::format(const char* fmt, ...)
+{
+    static char empty[1] = {'\0'};
+    const size_t available = m_capacity - m_used;
+    if (available == 0) {
+        m_overflows++;
+        return empty;
+    }
+    char* out = reinterpret_cast<char*>(m_buffer.get() + m_used);
+
+    va_list args;
+    va_start(args, fmt);
+    const int needed = std::vsnprintf(out, available, fmt, args);
+    va_end(args);
+    if (needed < 0) {
+        out[0] = '\0';
+        return out;
+    }
+    if (static_cast<size_t>(needed) >= available) {
+        m_overflows++;
+        m_used = m_capacity;
+    } else {
+        m_used += static_cast<size_t>(needed) + 1;
+    }
+    m_peak = std::max(m_peak, m_used);
+    return out;
+}
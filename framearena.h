@@ -0,0 +1,48 @@
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <QtGlobal>
+#include <cstddef>
+#include <memory>
+
+// Bump allocator for data that only lives until the end of a frame (log
+// text, scratch arrays), so the frame loop doesn't go to the heap for it.
+// Sized once up front and reset at the start of every frame; a request that
+// doesn't fit returns nullptr and is counted rather than falling back to
+// the heap.
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t capacity);
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void reset();
+
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+    template <typename T>
+    T* allocateArray(size_t count) { return static_cast<T*>(allocate(sizeof(T) * count, alignof(T))); }
+
+    // printf into the arena. Output that doesn't fit is truncated (and
+    // counted as an overflow); never returns nullptr.
+    const char* format(const char* fmt, ...)
+#if defined(__GNUC__) || defined(__clang__)
+        __attribute__((format(printf, 2, 3)))
+#endif
+        ;
+
+    size_t capacity() const { return m_capacity; }
+    size_t used() const { return m_used; }
+    size_t peak() const { return m_peak; }      // most used in any frame
+    quint64 overflows() const { return m_overflows; }
+
+private:
+    std::unique_ptr<unsigned char[]> m_buffer;
+    size_t m_capacity = 0;
+    size_t m_used = 0;
+    size_t m_peak = 0;
+    quint64 m_overflows = 0;
+};
+
+#endif // FRAMEARENA_H
@@ -0,0 +1,38 @@
+#include "frametimestats.h"
+
+#include <algorithm>
+#include <numeric>
+
+FrameTimeStats FrameTimeStats::compute(std::vector<double> samplesMs)
+{
+    FrameTimeStats stats;
+    if (samplesMs.empty()) {
+        return stats;
+    }
+    std::sort(samplesMs.begin(), samplesMs.end());
+
+    // nearest-rank percentile
+    auto percentile = [&samplesMs](double p) {
+        const size_t rank = static_cast<size_t>(p * (samplesMs.size() - 1) + 0.5);
+        return samplesMs[std::min(rank, samplesMs.size() - 1)];
+    };
+
+    stats.count = static_cast<int>(samplesMs.size());
+    stats.mean = std::accumulate(samplesMs.begin(), samplesMs.end(), 0.0) / samplesMs.size();
+    stats.p50 = percentile(0.50);
+    stats.p95 = percentile(0.95);
+    stats.p99 = percentile(0.99);
+    stats.max = samplesMs.back();
+    return stats;
+}
+
+QString FrameTimeStats::toString() const
+{
+    return QString("n=%1 mean %2 p50 %3 p95 %4 p99 %5 max %6 ms")
+        .arg(count)
+        .arg(mean, 0, 'f', 2)
+        .arg(p50, 0, 'f', 2)
+        .arg(p95, 0, 'f', 2)
+        .arg(p99, 0, 'f', 2)
+        .arg(max, 0, 'f', 2);
+}
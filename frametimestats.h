@@ -0,0 +1,23 @@
+#ifndef FRAMETIMESTATS_H
+#define FRAMETIMESTATS_H
+
+#include <QString>
+#include <vector>
+
+// Summary of a series of frame times (milliseconds).
+struct FrameTimeStats
+{
+    int count = 0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+
+    static FrameTimeStats compute(std::vector<double> samplesMs);
+
+    // e.g. "n=600 mean 4.21 p50 4.02 p95 6.80 p99 9.13 max 31.50 ms"
+    QString toString() const;
+};
+
+#endif // FRAMETIMESTATS_H
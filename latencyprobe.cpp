@@ -0,0 +1,253 @@
+#include "latencyprobe.h"
+#include "audioingest.h"
+#include "frametimestats.h"
+#include "offscreenrenderer.h"
+#include "projectmsettings.h"
+
+#include <Audio/PCM.hpp>
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+const double FIRST_IMPULSE_SECONDS = 3.0;      // lets projectM's beat detection settle on the noise floor
+const double IMPULSE_INTERVAL_SECONDS = 2.0;
+const double IMPULSE_JITTER_SECONDS = 0.5;     // so clicks don't phase-lock with preset animation
+const double TAIL_SECONDS = 1.0;
+const double CLICK_SECONDS = 0.03;
+const float NOISE_LEVEL = 0.003f;              // about -50 dBFS
+const int LUMA_STRIDE = 8;                     // sample every 8th pixel in both directions
+const int BASELINE_FRAMES = 30;
+const int RESPONSE_FRAMES = 30;                // give up on a click after half a second at 60 fps
+const double RESPONSE_SIGMAS = 6.0;
+const double MIN_RESPONSE_STEP = 1.0;          // luma levels, for near-static presets
+const unsigned long POLL_US = 200;
+
+void LatencyProbe::scheduleImpulses(int count, quint32 seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> jitter(0.0, IMPULSE_JITTER_SECONDS);
+    m_impulses.clear();
+    double seconds = FIRST_IMPULSE_SECONDS;
+    for (int i = 0; i < count; ++i) {
+        Impulse impulse;
+        impulse.sample = static_cast<qint64>(seconds * AudioIngest::kTargetSampleRate);
+        impulse.playNs = static_cast<qint64>(seconds * 1e9);
+        m_impulses.push_back(impulse);
+        seconds += IMPULSE_INTERVAL_SECONDS + jitter(rng);
+    }
+}
+
+// Noise floor plus any click overlapping [firstSample, firstSample + frames):
+// a decaying 50 Hz burst with a sharp onset, which every beat detector sees.
+void LatencyProbe::fillChunk(float* stereo, qint64 firstSample, int frames, qint64 frame, quint32* noise)
+{
+    for (int i = 0; i < frames; ++i) {
+        *noise = *noise * 1664525u + 1013904223u;
+        const float value = (static_cast<float>(*noise >> 8) / 8388608.0f - 1.0f) * NOISE_LEVEL;
+        stereo[2 * i] = value;
+        stereo[2 * i + 1] = value;
+    }
+
+    const qint64 clickSamples = static_cast<qint64>(CLICK_SECONDS * AudioIngest::kTargetSampleRate);
+    const qint64 lastSample = firstSample + frames;
+    for (Impulse& impulse : m_impulses) {
+        if (impulse.sample >= lastSample || impulse.sample + clickSamples <= firstSample) {
+            continue;
+        }
+        if (impulse.frame < 0) {
+            impulse.frame = frame;
+        }
+        const qint64 begin = std::max(impulse.sample, firstSample);
+        const qint64 end = std::min(impulse.sample + clickSamples, lastSample);
+        for (qint64 s = begin; s < end; ++s) {
+            const double t = static_cast<double>(s - impulse.sample) / AudioIngest::kTargetSampleRate;
+            const float value = static_cast<float>(0.9 * std::exp(-t / (CLICK_SECONDS / 4)) * std::sin(2.0 * M_PI * 50.0 * t + M_PI / 2));
+            const size_t i = static_cast<size_t>(s - firstSample);
+            stereo[2 * i] += value;
+            stereo[2 * i + 1] += value;
+        }
+    }
+}
+
+void LatencyProbe::measureFrame(const uchar* rgba, int width, int height, qint64 frame)
+{
+    const int columns = (width + LUMA_STRIDE - 1) / LUMA_STRIDE;
+    const int rows = (height + LUMA_STRIDE - 1) / LUMA_STRIDE;
+    const size_t cells = static_cast<size_t>(columns) * rows;
+    const bool comparable = m_previousLuma.size() == cells;
+    m_previousLuma.resize(cells);
+
+    quint64 change = 0;
+    size_t cell = 0;
+    for (int y = 0; y < height; y += LUMA_STRIDE) {
+        const uchar* row = rgba + static_cast<size_t>(y) * width * 4;
+        for (int x = 0; x < width; x += LUMA_STRIDE, ++cell) {
+            const uchar* pixel = row + static_cast<size_t>(x) * 4;
+            const uchar luma = static_cast<uchar>((pixel[0] * 54 + pixel[1] * 183 + pixel[2] * 19) >> 8);
+            change += static_cast<quint64>(std::abs(luma - m_previousLuma[cell]));
+            m_previousLuma[cell] = luma;
+        }
+    }
+    if (frame >= 0 && frame < static_cast<qint64>(m_frames.size())) {
+        m_frames[static_cast<size_t>(frame)].activity = comparable ? static_cast<float>(change) / cells : 0.0f;
+    }
+}
+
+// First frame from the click's own on whose luma change stands out from the
+// frames just before it, or -1.
+qint64 LatencyProbe::detectResponse(const Impulse& impulse) const
+{
+    const qint64 first = impulse.frame;
+    const qint64 baselineStart = std::max<qint64>(1, first - BASELINE_FRAMES);
+    if (first < 0 || first - baselineStart < BASELINE_FRAMES / 2) {
+        return -1;
+    }
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    for (qint64 f = baselineStart; f < first; ++f) {
+        const double a = m_frames[static_cast<size_t>(f)].activity;
+        sum += a;
+        sumSquares += a * a;
+    }
+    const double n = static_cast<double>(first - baselineStart);
+    const double mean = sum / n;
+    const double deviation = std::sqrt(std::max(0.0, sumSquares / n - mean * mean));
+    const double threshold = mean + std::max(RESPONSE_SIGMAS * deviation, MIN_RESPONSE_STEP);
+
+    const qint64 last = std::min<qint64>(first + RESPONSE_FRAMES, static_cast<qint64>(m_frames.size()));
+    for (qint64 f = first; f < last; ++f) {
+        if (m_frames[static_cast<size_t>(f)].activity > threshold) {
+            return f;
+        }
+    }
+    return -1;
+}
+
+int LatencyProbe::run(const Options& options)
+{
+    const int fps = std::max(1, options.fps);
+    const int chunkFrames = options.chunkFrames > 0 ? options.chunkFrames : ProjectMSettings::AUDIO_FRAMES_PER_CHUNK;
+    scheduleImpulses(std::max(1, options.impulses), 1);
+
+    const qint64 totalSamples = m_impulses.back().sample +
+                                static_cast<qint64>(TAIL_SECONDS * AudioIngest::kTargetSampleRate);
+    const qint64 totalFrames = (totalSamples + chunkFrames - 1) / chunkFrames;
+    m_frames.assign(static_cast<size_t>(totalFrames), FrameTimes());
+    m_previousLuma.clear();
+
+    const std::string presetRoot = (QCoreApplication::applicationDirPath() + "/../presets/").toStdString();
+    OffscreenRenderer renderer;
+    if (!renderer.initialize(options.width, options.height, OffscreenRenderer::defaultTexturePaths(presetRoot))) {
+        qCritical() << "Could not create offscreen renderer for latency measurement.";
+        return 2;
+    }
+    if (!options.presetFile.isEmpty() && !renderer.loadPreset(options.presetFile.toStdString())) {
+        return 2;
+    }
+
+    qInfo() << "Measuring latency:" << m_impulses.size() << "clicks over" << totalFrames << "frames at" << fps
+            << "fps," << chunkFrames << "audio frames per frame, preset"
+            << (options.presetFile.isEmpty() ? QString("idle") : options.presetFile) << "on" << renderer.rendererName();
+    const double feedRate = static_cast<double>(chunkFrames) * fps / AudioIngest::kTargetSampleRate;
+    if (std::abs(feedRate - 1.0) > 0.01) {
+        qWarning().noquote() << QString("Audio is fed at %1x real time (%2 frames per frame at %3 fps vs %4 Hz); "
+                                        "visuals drift against playback")
+                                    .arg(feedRate, 0, 'f', 2).arg(chunkFrames).arg(fps).arg(AudioIngest::kTargetSampleRate);
+    }
+
+    QElapsedTimer clock;
+    const OffscreenRenderer::ReadbackConsumer consume = [&](const uchar* rgba, int width, int height, qint64 frame) {
+        const qint64 mapped = clock.nsecsElapsed();
+        if (frame >= 0 && frame < totalFrames) {
+            FrameTimes& times = m_frames[static_cast<size_t>(frame)];
+            times.gpuDone = m_pendingGpuDone > 0 ? m_pendingGpuDone : mapped;
+            times.mapped = mapped;
+        }
+        measureFrame(rgba, width, height, frame);
+    };
+    // Takes whatever the GPU has finished; with `wait`, at least the oldest frame
+    int stalls = 0;
+    auto drain = [&](bool wait) {
+        for (;;) {
+            const bool ready = renderer.readbackReady();
+            if (!ready && !wait) {
+                return;
+            }
+            m_pendingGpuDone = ready ? clock.nsecsElapsed() : 0;
+            if (!renderer.takeReadback(consume, !ready)) {
+                return;
+            }
+            wait = false;
+        }
+    };
+
+    std::vector<float> chunk(static_cast<size_t>(chunkFrames) * 2);
+    quint32 noise = 12345u;
+    clock.start();
+    for (qint64 frame = 0; frame < totalFrames; ++frame) {
+        // Real-time pacing like the window's frame timer, collecting readbacks meanwhile
+        const qint64 tick = frame * 1000000000LL / fps;
+        while (clock.nsecsElapsed() < tick) {
+            drain(false);
+            QThread::usleep(POLL_US);
+        }
+
+        FrameTimes& times = m_frames[static_cast<size_t>(frame)];
+        fillChunk(chunk.data(), frame * chunkFrames, chunkFrames, frame, &noise);
+        renderer.pcm().Add(chunk.data(), 2, static_cast<size_t>(chunkFrames));
+        times.fed = clock.nsecsElapsed();
+
+        if (!renderer.canSubmit()) {
+            drain(true);
+            stalls++;
+        }
+        times.submitStart = clock.nsecsElapsed();
+        renderer.submitFrame(static_cast<double>(frame) / fps, frame);
+        times.submitEnd = clock.nsecsElapsed();
+        drain(false);
+    }
+    while (renderer.takeReadback(consume, true)) {
+    }
+
+    std::vector<double> feed, analysis, render, gpu, readback, total, lagFrames;
+    int missed = 0;
+    for (const Impulse& impulse : m_impulses) {
+        const qint64 response = detectResponse(impulse);
+        if (response < 0) {
+            missed++;
+            continue;
+        }
+        const FrameTimes& clickFrame = m_frames[static_cast<size_t>(impulse.frame)];
+        const FrameTimes& shown = m_frames[static_cast<size_t>(response)];
+        feed.push_back((clickFrame.fed - impulse.playNs) / 1e6);
+        analysis.push_back((shown.submitStart - clickFrame.fed) / 1e6);
+        render.push_back((shown.submitEnd - shown.submitStart) / 1e6);
+        gpu.push_back((shown.gpuDone - shown.submitEnd) / 1e6);
+        readback.push_back((shown.mapped - shown.gpuDone) / 1e6);
+        total.push_back((shown.mapped - impulse.playNs) / 1e6);
+        lagFrames.push_back(static_cast<double>(response - impulse.frame));
+    }
+
+    qInfo().noquote() << QString("Latency: %1 of %2 clicks detected, %3 readback stalls")
+                             .arg(m_impulses.size() - missed).arg(m_impulses.size()).arg(stalls);
+    if (!total.empty()) {
+        qInfo().noquote() << "  feed     " << FrameTimeStats::compute(feed).toString();
+        qInfo().noquote() << "  analysis " << FrameTimeStats::compute(analysis).toString();
+        qInfo().noquote() << "  render   " << FrameTimeStats::compute(render).toString();
+        qInfo().noquote() << "  gpu      " << FrameTimeStats::compute(gpu).toString();
+        qInfo().noquote() << "  readback " << FrameTimeStats::compute(readback).toString();
+        qInfo().noquote() << "  total    " << FrameTimeStats::compute(total).toString();
+        const FrameTimeStats lag = FrameTimeStats::compute(lagFrames);
+        qInfo().noquote() << QString("  response after %1 frames (p50), %2 (max)").arg(lag.p50, 0, 'f', 0).arg(lag.max, 0, 'f', 0);
+    }
+    if (missed * 2 > static_cast<int>(m_impulses.size())) {
+        qWarning() << "Most clicks produced no visible response; try a more beat-reactive preset with --latency-preset.";
+        return 1;
+    }
+    return 0;
+}
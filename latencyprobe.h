@@ -0,0 +1,73 @@
+#ifndef LATENCYPROBE_H
+#define LATENCYPROBE_H
+
+#include <QString>
+#include <QtGlobal>
+#include <vector>
+
+// Audio-to-pixels latency harness. Drives an OffscreenRenderer in real time
+// the way the window does (one audio chunk per frame tick), injects clicks
+// into an otherwise quiet signal at jittered intervals, and reads every frame
+// back asynchronously through a pixel buffer ring. A click's response is the
+// first frame whose frame-to-frame luma change jumps well above the noise of
+// the frames before it.
+//
+// Per click, the time from its nominal playback time is split into stages:
+//
+//   feed      playback time -> chunk handed to projectM (negative: read ahead)
+//   analysis  fed -> render of the first frame that shows it (beat detection,
+//             smoothing, waiting for frame ticks)
+//   render    CPU time submitting that frame
+//   gpu       submitted -> GPU done (fence)
+//   readback  GPU done -> pixels mapped on the CPU
+//
+// Playback time assumes an ideal device starting with the first chunk; the
+// output device's own buffering and the swap/scanout after a real present
+// come on top and can't be seen offscreen.
+//
+//   QT_QPA_PLATFORM=offscreen musicvisqt --measure-latency --latency-preset foo.milk
+//
+// Exit code: 0 ok, 1 most clicks produced no detectable response, 2 could not run.
+class LatencyProbe
+{
+public:
+    struct Options {
+        QString presetFile;             // empty: projectM's idle preset
+        int impulses = 20;
+        int chunkFrames = 0;            // audio frames per rendered frame; 0: the window's
+        int width = 640;
+        int height = 360;
+        int fps = 60;
+    };
+
+    int run(const Options& options);
+
+private:
+    struct Impulse {
+        qint64 sample = 0;              // first sample of the click
+        qint64 frame = -1;              // frame whose chunk carried it
+        qint64 playNs = 0;
+    };
+
+    // Per-frame timestamps on the probe clock (ns), and the detector input
+    struct FrameTimes {
+        qint64 fed = 0;
+        qint64 submitStart = 0;
+        qint64 submitEnd = 0;
+        qint64 gpuDone = 0;
+        qint64 mapped = 0;
+        float activity = 0.0f;          // mean absolute luma change from the previous frame
+    };
+
+    void scheduleImpulses(int count, quint32 seed);
+    void fillChunk(float* stereo, qint64 firstSample, int frames, qint64 frame, quint32* noise);
+    void measureFrame(const uchar* rgba, int width, int height, qint64 frame);
+    qint64 detectResponse(const Impulse& impulse) const;
+
+    std::vector<Impulse> m_impulses;
+    std::vector<FrameTimes> m_frames;
+    std::vector<uchar> m_previousLuma;  // subsampled grid of the last frame read back
+    qint64 m_pendingGpuDone = 0;
+};
+
+#endif // LATENCYPROBE_H
@@ -0,0 +1,203 @@
+#include "librarybrowser.h"
+
+#include <QAbstractTableModel>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QVBoxLayout>
+#include <vector>
+
+const int FILTER_DELAY_MS = 150;
+
+// Rows are indices into the library, so filtering never copies tracks.
+class LibraryModel : public QAbstractTableModel
+{
+public:
+    enum Column { Title, Artist, Album, Duration, ColumnCount };
+
+    explicit LibraryModel(MusicLibrary *library, QObject *parent = nullptr)
+        : QAbstractTableModel(parent)
+        , m_library(library)
+    {
+    }
+
+    void setRows(std::vector<int> rows)
+    {
+        beginResetModel();
+        m_rows = std::move(rows);
+        endResetModel();
+    }
+
+    QString pathAt(int row) const
+    {
+        return m_library->track(m_rows[static_cast<size_t>(row)]).path;
+    }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : static_cast<int>(m_rows.size());
+    }
+
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : ColumnCount;
+    }
+
+    QVariant data(const QModelIndex &index, int role) const override
+    {
+        if (!index.isValid() || index.row() >= static_cast<int>(m_rows.size())) {
+            return QVariant();
+        }
+        const MusicLibrary::Track &track = m_library->track(m_rows[static_cast<size_t>(index.row())]);
+        if (role == Qt::ToolTipRole) {
+            if (track.sampleRate > 0) {
+                return tr("%1\n%2 Hz, %3 ch").arg(track.path).arg(track.sampleRate).arg(track.channels);
+            }
+            return track.path;
+        }
+        if (role == Qt::TextAlignmentRole && index.column() == Duration) {
+            return static_cast<int>(Qt::AlignRight | Qt::AlignVCenter);
+        }
+        if (role != Qt::DisplayRole) {
+            return QVariant();
+        }
+        switch (index.column()) {
+        case Title:
+            return track.title;
+        case Artist:
+            return track.artist;
+        case Album:
+            return track.album;
+        case Duration:
+            if (track.durationMs <= 0) {
+                return QString();
+            }
+            return QString("%1:%2").arg(track.durationMs / 60000).arg((track.durationMs / 1000) % 60, 2, 10, QChar('0'));
+        }
+        return QVariant();
+    }
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override
+    {
+        if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+            return QVariant();
+        }
+        switch (section) {
+        case Title:
+            return tr("Title");
+        case Artist:
+            return tr("Artist");
+        case Album:
+            return tr("Album");
+        case Duration:
+            return tr("Length");
+        }
+        return QVariant();
+    }
+
+private:
+    MusicLibrary *m_library;
+    std::vector<int> m_rows;
+};
+
+LibraryBrowser::LibraryBrowser(MusicLibrary *library, QWidget *parent)
+    : QWidget(parent)
+    , m_library(library)
+{
+    m_model = new LibraryModel(m_library, this);
+    setupUI();
+
+    m_filterTimer.setSingleShot(true);
+    m_filterTimer.setInterval(FILTER_DELAY_MS);
+    connect(&m_filterTimer, &QTimer::timeout, this, &LibraryBrowser::applyFilter);
+
+    connect(m_library, &MusicLibrary::tracksChanged, this, &LibraryBrowser::applyFilter);
+    connect(m_library, &MusicLibrary::scanProgress, this, &LibraryBrowser::updateProgress);
+    connect(m_library, &MusicLibrary::scanFinished, this, &LibraryBrowser::showScanStats);
+    applyFilter();
+}
+
+void LibraryBrowser::setupUI()
+{
+    m_searchEdit = new QLineEdit(this);
+    m_searchEdit->setPlaceholderText(tr("Search title, artist, album or file"));
+    m_searchEdit->setClearButtonEnabled(true);
+
+    m_addFolderButton = new QPushButton(tr("Add Folder..."), this);
+    m_rescanButton = new QPushButton(tr("Rescan"), this);
+    m_rescanButton->setToolTip(tr("Pick up files added or changed since the last scan"));
+
+    m_view = new QTableView(this);
+    m_view->setModel(m_model);
+    m_view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_view->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_view->setWordWrap(false);
+    m_view->verticalHeader()->hide();
+    // Fixed row heights keep scrolling through tens of thousands of rows cheap
+    m_view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    m_view->horizontalHeader()->setSectionResizeMode(QHeaderView::Interactive);
+    m_view->horizontalHeader()->setStretchLastSection(false);
+    m_view->horizontalHeader()->setSectionResizeMode(LibraryModel::Title, QHeaderView::Stretch);
+
+    m_statusLabel = new QLabel(this);
+
+    // Connect signals
+    connect(m_searchEdit, &QLineEdit::textChanged, this, [this]() { m_filterTimer.start(); });
+    connect(m_searchEdit, &QLineEdit::returnPressed, this, [this]() {
+        if (m_model->rowCount() > 0) {
+            emit trackActivated(m_model->pathAt(0));
+        }
+    });
+    connect(m_addFolderButton, &QPushButton::clicked, this, &LibraryBrowser::addFolder);
+    connect(m_rescanButton, &QPushButton::clicked, m_library, &MusicLibrary::rescan);
+    connect(m_view, &QTableView::activated, this, [this](const QModelIndex &index) {
+        emit trackActivated(m_model->pathAt(index.row()));
+    });
+
+    // Layout
+    QHBoxLayout *topLayout = new QHBoxLayout();
+    topLayout->addWidget(m_searchEdit, 1);
+    topLayout->addWidget(m_addFolderButton);
+    topLayout->addWidget(m_rescanButton);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(topLayout);
+    layout->addWidget(m_view, 1);
+    layout->addWidget(m_statusLabel);
+
+    setLayout(layout);
+}
+
+void LibraryBrowser::addFolder()
+{
+    const QString dir = QFileDialog::getExistingDirectory(this, tr("Add Music Folder"));
+    if (!dir.isEmpty()) {
+        m_library->addFolder(dir);
+    }
+}
+
+void LibraryBrowser::applyFilter()
+{
+    m_model->setRows(m_library->search(m_searchEdit->text()));
+    if (!m_library->isScanning()) {
+        m_statusLabel->setText(tr("%1 of %2 tracks").arg(m_model->rowCount()).arg(m_library->count()));
+    }
+}
+
+void LibraryBrowser::updateProgress(int done, int total)
+{
+    if (total > 0) {
+        m_statusLabel->setText(tr("Scanning... %1 / %2 new or changed files").arg(done).arg(total));
+    } else {
+        m_statusLabel->setText(tr("Scanning folders..."));
+    }
+}
+
+void LibraryBrowser::showScanStats(const MusicLibrary::ScanStats &stats)
+{
+    m_statusLabel->setText(tr("%1 tracks, %2 new or changed, %3 removed")
+                               .arg(m_library->count())
+                               .arg(stats.files - stats.reused)
+                               .arg(stats.removed));
+}
@@ -0,0 +1,49 @@
+#ifndef LIBRARYBROWSER_H
+#define LIBRARYBROWSER_H
+
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QTableView>
+#include <QTimer>
+#include <QWidget>
+
+#include "musiclibrary.h"
+
+class LibraryModel;
+
+// Searchable track list over a MusicLibrary. Typing filters after a short
+// pause rather than per keystroke; double-click or Enter on a row emits
+// trackActivated(). Scanning runs in the background and the list updates
+// when it lands.
+class LibraryBrowser : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit LibraryBrowser(MusicLibrary *library, QWidget *parent = nullptr);
+
+signals:
+    void trackActivated(const QString &path);
+
+private slots:
+    void addFolder();
+    void applyFilter();
+    void updateProgress(int done, int total);
+    void showScanStats(const MusicLibrary::ScanStats &stats);
+
+private:
+    MusicLibrary *m_library;
+    LibraryModel *m_model;
+
+    QLineEdit *m_searchEdit;
+    QPushButton *m_addFolderButton;
+    QPushButton *m_rescanButton;
+    QTableView *m_view;
+    QLabel *m_statusLabel;
+    QTimer m_filterTimer;
+
+    void setupUI();
+};
+
+#endif // LIBRARYBROWSER_H
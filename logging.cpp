@@ -0,0 +1,260 @@
+#include "logging.h"
+
+#include <QByteArray>
+#include <QDebug>
+#include <QList>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+namespace Log {
+
+std::atomic<int> g_levels[static_cast<int>(Category::Count)] = {
+    {MUSICVIS_LOG_MIN_LEVEL}, {MUSICVIS_LOG_MIN_LEVEL}, {MUSICVIS_LOG_MIN_LEVEL},
+    {MUSICVIS_LOG_MIN_LEVEL}, {MUSICVIS_LOG_MIN_LEVEL}, {MUSICVIS_LOG_MIN_LEVEL},
+};
+
+}
+
+namespace {
+
+const size_t RING_SIZE = 1024;              // power of two
+const size_t MESSAGE_SIZE = 240;
+const int FLUSH_INTERVAL_MS = 20;
+
+const char* const CATEGORY_NAMES[] = {"render", "audio", "media", "presets", "textures", "power"};
+const char* const LEVEL_NAMES[] = {"trace", "debug", "info", "warning", "critical"};
+static_assert(sizeof(CATEGORY_NAMES) / sizeof(CATEGORY_NAMES[0]) == static_cast<size_t>(Log::Category::Count),
+              "every category needs a name and an entry in g_levels");
+
+// Bounded multi-producer ring (Vyukov): producers claim a slot with one CAS
+// on the head and publish it through the slot's sequence number. The only
+// consumer is the flusher thread.
+struct Slot {
+    std::atomic<size_t> sequence;
+    Log::Category category;
+    Log::Level level;
+    char text[MESSAGE_SIZE];
+};
+
+struct Ring {
+    Ring()
+    {
+        for (size_t i = 0; i < RING_SIZE; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    Slot slots[RING_SIZE];
+    std::atomic<size_t> head{0};
+    size_t tail = 0;                        // flusher thread only
+};
+
+Ring s_ring;
+std::atomic<quint64> s_written{0};
+std::atomic<quint64> s_dropped{0};
+std::atomic<quint64> s_suppressed{0};
+std::atomic<bool> s_running{false};
+std::atomic<bool> s_output{true};
+std::thread s_flusher;
+
+Slot* claim()
+{
+    size_t pos = s_ring.head.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot& slot = s_ring.slots[pos & (RING_SIZE - 1)];
+        const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (s_ring.head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                return &slot;
+            }
+        } else if (diff < 0) {
+            return nullptr;                 // full
+        } else {
+            pos = s_ring.head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void publish(Slot* slot)
+{
+    // The claimed position is sequence; publishing makes it sequence + 1
+    const size_t pos = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+void vwrite(Log::Category category, Log::Level level, int suppressed, const char* format, va_list args)
+{
+    Slot* slot = claim();
+    if (!slot) {
+        s_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    slot->category = category;
+    slot->level = level;
+    int used = 0;
+    if (suppressed > 0) {
+        used = std::snprintf(slot->text, MESSAGE_SIZE, "(+%d suppressed) ", suppressed);
+    }
+    std::vsnprintf(slot->text + used, MESSAGE_SIZE - used, format, args);
+    publish(slot);
+    s_written.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Moves everything published so far to the Qt message output.
+void drain()
+{
+    for (;;) {
+        Slot& slot = s_ring.slots[s_ring.tail & (RING_SIZE - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != s_ring.tail + 1) {
+            return;
+        }
+        if (s_output.load(std::memory_order_relaxed)) {
+            const char* name = CATEGORY_NAMES[static_cast<int>(slot.category)];
+            switch (slot.level) {
+                case Log::Level::Trace:
+                case Log::Level::Debug:
+                    qDebug().noquote() << QString("[%1]").arg(QLatin1String(name)) << slot.text;
+                    break;
+                case Log::Level::Info:
+                    qInfo().noquote() << QString("[%1]").arg(QLatin1String(name)) << slot.text;
+                    break;
+                case Log::Level::Warning:
+                    qWarning().noquote() << QString("[%1]").arg(QLatin1String(name)) << slot.text;
+                    break;
+                case Log::Level::Critical:
+                    qCritical().noquote() << QString("[%1]").arg(QLatin1String(name)) << slot.text;
+                    break;
+            }
+        }
+        slot.sequence.store(s_ring.tail + RING_SIZE, std::memory_order_release);
+        s_ring.tail++;
+    }
+}
+
+int parseLevel(const QByteArray& name)
+{
+    for (int i = 0; i < static_cast<int>(sizeof(LEVEL_NAMES) / sizeof(LEVEL_NAMES[0])); ++i) {
+        if (name == LEVEL_NAMES[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+}
+
+namespace Log {
+
+void setLevel(Category category, Level level)
+{
+    g_levels[static_cast<int>(category)].store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+void configure(const QByteArray& spec)
+{
+    for (const QByteArray& item : spec.split(',')) {
+        const QList<QByteArray> parts = item.trimmed().split('=');
+        if (parts.size() == 1 && !parts[0].isEmpty()) {
+            const int level = parseLevel(parts[0].toLower());
+            if (level < 0) {
+                qWarning() << "MUSICVIS_LOG: unknown level" << parts[0];
+                continue;
+            }
+            for (int c = 0; c < static_cast<int>(Category::Count); ++c) {
+                g_levels[c].store(level, std::memory_order_relaxed);
+            }
+        } else if (parts.size() == 2) {
+            const int level = parseLevel(parts[1].trimmed().toLower());
+            int category = -1;
+            for (int c = 0; c < static_cast<int>(Category::Count); ++c) {
+                if (parts[0].trimmed().toLower() == CATEGORY_NAMES[c]) {
+                    category = c;
+                }
+            }
+            if (level < 0 || category < 0) {
+                qWarning() << "MUSICVIS_LOG: cannot parse" << item;
+                continue;
+            }
+            g_levels[category].store(level, std::memory_order_relaxed);
+        }
+    }
+}
+
+void write(Category category, Level level, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vwrite(category, level, 0, format, args);
+    va_end(args);
+}
+
+void writeSuppressed(Category category, Level level, int suppressed, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vwrite(category, level, suppressed, format, args);
+    va_end(args);
+}
+
+void start()
+{
+    if (s_running.exchange(true)) {
+        return;
+    }
+    const QByteArray spec = qgetenv("MUSICVIS_LOG");
+    if (!spec.isEmpty()) {
+        configure(spec);
+    }
+    s_flusher = std::thread([]() {
+        while (s_running.load(std::memory_order_acquire)) {
+            drain();
+            std::this_thread::sleep_for(std::chrono::milliseconds(FLUSH_INTERVAL_MS));
+        }
+    });
+}
+
+void stop()
+{
+    if (!s_running.exchange(false)) {
+        return;
+    }
+    s_flusher.join();
+    drain();
+    const Stats totals = stats();
+    if (totals.dropped > 0 || totals.suppressed > 0) {
+        qInfo() << "Log ring:" << totals.written << "written," << totals.dropped << "dropped,"
+                << totals.suppressed << "rate-limited";
+    }
+}
+
+void setOutputEnabled(bool enabled)
+{
+    s_output.store(enabled, std::memory_order_relaxed);
+}
+
+Stats stats()
+{
+    Stats result;
+    result.written = s_written.load(std::memory_order_relaxed);
+    result.dropped = s_dropped.load(std::memory_order_relaxed);
+    result.suppressed = s_suppressed.load(std::memory_order_relaxed);
+    return result;
+}
+
+bool RateLimit::allow(int intervalMs)
+{
+    const qint64 now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    qint64 next = m_next.load(std::memory_order_relaxed);
+    if (now >= next && m_next.compare_exchange_strong(next, now + intervalMs, std::memory_order_relaxed)) {
+        return true;
+    }
+    m_suppressed.fetch_add(1, std::memory_order_relaxed);
+    s_suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+}
@@ -0,0 +1,115 @@
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include <QtGlobal>
+#include <atomic>
+
+// Category logging for the render and audio paths. MVLOG formats with
+// snprintf straight into a slot of a fixed lock-free ring and returns; a
+// background thread drains the ring into the normal Qt message output. So
+// the render thread never allocates, takes a lock or touches stderr.
+//
+//   MVLOG(Info, Render, "FPS: %.1f", fps);
+//   MVLOG_EVERY_MS(1000, Debug, Audio, "chunk max amplitude %f", maxAmp);
+//
+// Levels below MUSICVIS_LOG_MIN_LEVEL are compiled out, arguments and all
+// (default: Debug, or Info when NDEBUG is defined; override with
+// -DMUSICVIS_LOG_MIN_LEVEL=<0..4> at configure time). Above that, levels are
+// set per category at runtime with MUSICVIS_LOG="render=debug,media=warning".
+// MVLOG_EVERY_MS lets at most one message per interval through per call
+// site and reports how many it swallowed with the next one.
+
+#ifndef MUSICVIS_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define MUSICVIS_LOG_MIN_LEVEL 2
+#else
+#define MUSICVIS_LOG_MIN_LEVEL 1
+#endif
+#endif
+
+namespace Log {
+
+enum class Level : int { Trace = 0, Debug = 1, Info = 2, Warning = 3, Critical = 4 };
+enum class Category : int { Render, Audio, Media, Presets, Textures, Power, Count };
+
+struct Stats {
+    quint64 written = 0;
+    quint64 dropped = 0;      // ring was full; the render thread never waits
+    quint64 suppressed = 0;   // swallowed by rate limits
+};
+
+// Per-category runtime levels; read on every log call, so kept lock-free.
+extern std::atomic<int> g_levels[static_cast<int>(Category::Count)];
+
+inline bool enabled(Category category, Level level)
+{
+    return static_cast<int>(level) >= g_levels[static_cast<int>(category)].load(std::memory_order_relaxed);
+}
+
+void setLevel(Category category, Level level);
+// "render=debug,audio=warning" or a bare level for every category
+void configure(const QByteArray& spec);
+
+void write(Category category, Level level, const char* format, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 3, 4)))
+#endif
+    ;
+void writeSuppressed(Category category, Level level, int suppressed, const char* format, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 4, 5)))
+#endif
+    ;
+
+// Starts the thread that drains the ring (and reads MUSICVIS_LOG). Messages
+// logged before start() wait in the ring.
+void start();
+// Drains what's left and joins the thread.
+void stop();
+// Drain without printing; for benchmarks.
+void setOutputEnabled(bool enabled);
+Stats stats();
+
+// RAII start()/stop() for main()
+struct Flusher {
+    Flusher() { start(); }
+    ~Flusher() { stop(); }
+};
+
+// One per MVLOG_EVERY_MS call site.
+class RateLimit
+{
+public:
+    // True if this call site may log now; otherwise counts the message.
+    bool allow(int intervalMs);
+    int takeSuppressed() { return m_suppressed.exchange(0, std::memory_order_relaxed); }
+
+private:
+    std::atomic<qint64> m_next{0};
+    std::atomic<int> m_suppressed{0};
+};
+
+}
+
+#define MVLOG(level, category, ...)                                                                  \
+    do {                                                                                             \
+        if constexpr (static_cast<int>(Log::Level::level) >= MUSICVIS_LOG_MIN_LEVEL) {               \
+            if (Log::enabled(Log::Category::category, Log::Level::level)) {                          \
+                Log::write(Log::Category::category, Log::Level::level, __VA_ARGS__);                 \
+            }                                                                                        \
+        }                                                                                            \
+    } while (0)
+
+#define MVLOG_EVERY_MS(intervalMs, level, category, ...)                                             \
+    do {                                                                                             \
+        if constexpr (static_cast<int>(Log::Level::level) >= MUSICVIS_LOG_MIN_LEVEL) {               \
+            static Log::RateLimit mvlogRateLimit;                                                    \
+            if (Log::enabled(Log::Category::category, Log::Level::level) &&                          \
+                mvlogRateLimit.allow(intervalMs)) {                                                  \
+                Log::writeSuppressed(Log::Category::category, Log::Level::level,                     \
+                                     mvlogRateLimit.takeSuppressed(), __VA_ARGS__);                  \
+            }                                                                                        \
+        }                                                                                            \
+    } while (0)
+
+#endif // LOGGING_H
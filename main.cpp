@@ -1,4 +1,15 @@
 #include "mainwindow.h"
+#include "allocationcounter.h"
+#include "audioshm.h"
+#include "batchrenderer.h"
+#include "benchmarks.h"
+#include "latencyprobe.h"
+#include "logging.h"
+#include "musiclibrary.h"
+#include "presetcostanalyzer.h"
+#include "presetpack.h"
+#include "sessionreplayer.h"
+#include "thumbnailatlas.h"
 
 #include <QApplication>
 #include <QCommandLineParser>
@@ -29,9 +40,12 @@ int main(int argc, char *argv[])
     format.setSamples(4); // Enable multisampling for smoother rendering
     QSurfaceFormat::setDefaultFormat(format);
     
+    AllocationCounter::setThreadName("gui");
     QApplication app(argc, argv);
     QApplication::setApplicationName("QtProjectMVisualizer");
     QApplication::setApplicationVersion("1.0");
+    // drains the render/audio log ring on its own thread until main() returns
+    Log::Flusher logFlusher;
     
     // pwd debug
     qInfo() << "Current directory:" << QDir::currentPath();
@@ -40,11 +54,155 @@ int main(int argc, char *argv[])
     parser.setApplicationDescription("Qt ProjectM Music Visualizer");
     parser.addHelpOption();
     parser.addVersionOption();
+    // headless microbenchmarks
+    QCommandLineOption benchmarkOption("benchmark",
+        QApplication::translate("main", "Run a built-in benchmark and exit (%1, or all).").arg(Benchmarks::available().join(", ")),
+        "name");
+    parser.addOption(benchmarkOption);
+    QCommandLineOption decodeCacheOption("decode-cache",
+        QApplication::translate("main", "Decode compressed audio once into a cached float file that later plays memory-map."));
+    parser.addOption(decodeCacheOption);
+    QCommandLineOption previewOption("preview",
+        QApplication::translate("main", "Start with the live preview strip of upcoming presets shown (toggle with V)."));
+    parser.addOption(previewOption);
+    QCommandLineOption buildAtlasOption("build-atlas",
+        QApplication::translate("main", "Pack all preset preview images into the thumbnail atlas (incremental) and exit."));
+    parser.addOption(buildAtlasOption);
+    QCommandLineOption buildPackOption("build-preset-pack",
+        QApplication::translate("main", "Pack every preset into one file for --preset-pack and exit."), "file");
+    parser.addOption(buildPackOption);
+    QCommandLineOption packUncompressedOption("pack-uncompressed",
+        QApplication::translate("main", "With --build-preset-pack, store preset bodies without compression."));
+    parser.addOption(packUncompressedOption);
+    QCommandLineOption presetPackOption("preset-pack",
+        QApplication::translate("main", "Load presets from a pack built with --build-preset-pack instead of the preset tree."), "file");
+    parser.addOption(presetPackOption);
+    // static preset cost estimates
+    QCommandLineOption analyzePresetsOption("analyze-presets",
+        QApplication::translate("main", "Estimate every preset's render cost without rendering, write a ranked report and exit."), "report");
+    parser.addOption(analyzePresetsOption);
+    QCommandLineOption scanLibraryOption("scan-library",
+        QApplication::translate("main", "Add a folder to the music library, index it and exit."), "folder");
+    parser.addOption(scanLibraryOption);
+    QCommandLineOption skipExpensiveOption("skip-expensive-presets",
+        QApplication::translate("main", "Leave the most expensive percent of presets (by estimated cost) out of the rotation."), "percent");
+    parser.addOption(skipExpensiveOption);
+    QCommandLineOption gpuBudgetOption("gpu-budget",
+        QApplication::translate("main", "Memory budget for preset textures and render targets, in MB (default 256)."), "MB", "256");
+    parser.addOption(gpuBudgetOption);
+    QCommandLineOption publishAudioOption("publish-audio",
+        QApplication::translate("main", "Publish per-frame PCM, spectrum and band energies to shared memory (%1) for other processes.")
+            .arg(MUSICVIS_SHM_NAME));
+    parser.addOption(publishAudioOption);
+    // session record / replay for frame-time regression checks
+    QCommandLineOption recordOption("record",
+        QApplication::translate("main", "Record the session (audio, seed, presets, resizes, keys) to a log file."), "file");
+    QCommandLineOption seedOption("seed",
+        QApplication::translate("main", "Seed for the preset shuffle."), "seed");
+    QCommandLineOption replayOption("replay",
+        QApplication::translate("main", "Replay a recorded session offscreen on a fixed timestep and exit."), "file");
+    QCommandLineOption baselineOption("baseline",
+        QApplication::translate("main", "Frame-time baseline to compare a replay against (created if missing)."), "file");
+    QCommandLineOption writeBaselineOption("write-baseline",
+        QApplication::translate("main", "Overwrite the baseline with this replay's frame times."));
+    QCommandLineOption toleranceOption("tolerance",
+        QApplication::translate("main", "Allowed p95/p99 frame-time growth over the baseline, in percent (default 20)."), "percent", "20");
+    parser.addOption(recordOption);
+    parser.addOption(seedOption);
+    parser.addOption(replayOption);
+    parser.addOption(baselineOption);
+    parser.addOption(writeBaselineOption);
+    parser.addOption(toleranceOption);
+    // offline batch rendering across worker processes
+    QCommandLineOption batchOption("batch",
+        QApplication::translate("main", "Render every job in a JSON-lines job list offline on a pool of worker processes and exit."), "jobfile");
+    QCommandLineOption workersOption("workers",
+        QApplication::translate("main", "Number of batch worker processes (default: from the core count)."), "n", "0");
+    QCommandLineOption renderJobOption("render-job",
+        QApplication::translate("main", "Render a single batch job (used by --batch workers)."), "json");
+    renderJobOption.setFlags(QCommandLineOption::HiddenFromHelp);
+    parser.addOption(batchOption);
+    parser.addOption(workersOption);
+    parser.addOption(renderJobOption);
+    // audio-to-pixels latency measurement
+    QCommandLineOption measureLatencyOption("measure-latency",
+        QApplication::translate("main", "Inject clicks into the audio path, detect them in offscreen frames, print per-stage latency and exit."));
+    QCommandLineOption latencyPresetOption("latency-preset",
+        QApplication::translate("main", "Preset to measure latency with (default: projectM's idle preset)."), "file");
+    QCommandLineOption latencyImpulsesOption("latency-impulses",
+        QApplication::translate("main", "Number of clicks to inject (default 20)."), "n", "20");
+    QCommandLineOption latencyChunkOption("latency-chunk",
+        QApplication::translate("main", "Audio frames fed per rendered frame while measuring (default: the window's)."), "frames", "0");
+    parser.addOption(measureLatencyOption);
+    parser.addOption(latencyPresetOption);
+    parser.addOption(latencyImpulsesOption);
+    parser.addOption(latencyChunkOption);
+    QCommandLineOption allocCheckOption("alloc-check",
+        QApplication::translate("main", "Fail (exit code 1) if a steady-state frame allocates within the given number of frames "
+                                        "(needs a -DMUSICVIS_COUNT_ALLOCATIONS=ON build)."), "frames");
+    parser.addOption(allocCheckOption);
     // positional arg audio file
     parser.addPositionalArgument("audiofile", QApplication::translate("main", "Audio file to visualize."), "[audiofile]");
 
     parser.process(app);
 
+    if (parser.isSet(benchmarkOption)) {
+        return Benchmarks::run(parser.value(benchmarkOption));
+    }
+
+    if (parser.isSet(buildAtlasOption)) {
+        const QString presetRoot = QCoreApplication::applicationDirPath() + "/../presets/";
+        return ThumbnailAtlas::build(presetRoot, ThumbnailAtlas::defaultPath()) ? 0 : 1;
+    }
+
+    if (parser.isSet(analyzePresetsOption)) {
+        const QString presetRoot = QCoreApplication::applicationDirPath() + "/../presets/";
+        return PresetCostAnalyzer::writeReport(presetRoot, parser.value(analyzePresetsOption));
+    }
+
+    if (parser.isSet(scanLibraryOption)) {
+        MusicLibrary library;
+        QObject::connect(&library, &MusicLibrary::scanFinished, &app, [&app]() { app.quit(); });
+        library.addFolder(parser.value(scanLibraryOption));   // loads the index first
+        return app.exec();
+    }
+
+    if (parser.isSet(buildPackOption)) {
+        const QString presetRoot = QCoreApplication::applicationDirPath() + "/../presets/";
+        return PresetPack::build(presetRoot, parser.value(buildPackOption), !parser.isSet(packUncompressedOption)) ? 0 : 1;
+    }
+
+    if (parser.isSet(replayOption)) {
+        SessionReplayer::Options options;
+        options.sessionPath = parser.value(replayOption);
+        options.baselinePath = parser.value(baselineOption);
+        options.writeBaseline = parser.isSet(writeBaselineOption);
+        options.tolerance = parser.value(toleranceOption).toDouble() / 100.0;
+        SessionReplayer replayer;
+        return replayer.run(options);
+    }
+
+    if (parser.isSet(measureLatencyOption)) {
+        LatencyProbe::Options options;
+        options.presetFile = parser.value(latencyPresetOption);
+        options.impulses = parser.value(latencyImpulsesOption).toInt();
+        options.chunkFrames = parser.value(latencyChunkOption).toInt();
+        LatencyProbe probe;
+        return probe.run(options);
+    }
+
+    if (parser.isSet(renderJobOption)) {
+        return BatchRenderer::renderJob(parser.value(renderJobOption));
+    }
+
+    if (parser.isSet(batchOption)) {
+        BatchRenderer::Options options;
+        options.jobFile = parser.value(batchOption);
+        options.workers = parser.value(workersOption).toInt();
+        BatchRenderer batch;
+        return batch.run(options);
+    }
+
     const QStringList args = parser.positionalArguments();
     QString audioFilePath;
     if (!args.isEmpty()) {
@@ -69,6 +227,33 @@ int main(int argc, char *argv[])
     }
 
     MainWindow w; // Create main window
+    w.setDecodeCacheEnabled(parser.isSet(decodeCacheOption));
+    w.visualizer()->setGpuBudgetMb(parser.value(gpuBudgetOption).toInt());
+    if (parser.isSet(previewOption)) {
+        w.visualizer()->setPreviewEnabled(true);
+    }
+    if (parser.isSet(publishAudioOption)) {
+        w.visualizer()->startAudioPublishing();
+    }
+    if (parser.isSet(skipExpensiveOption)) {
+        w.visualizer()->setSkipExpensivePresets(parser.value(skipExpensiveOption).toDouble());
+    }
+    if (parser.isSet(presetPackOption)) {
+        w.visualizer()->setPresetPack(parser.value(presetPackOption));
+    }
+    if (parser.isSet(seedOption)) {
+        w.visualizer()->setPresetSeed(parser.value(seedOption).toUInt());
+    }
+    if (parser.isSet(recordOption)) {
+        w.visualizer()->startRecording(parser.value(recordOption));
+    }
+    if (parser.isSet(allocCheckOption)) {
+        if (!AllocationCounter::enabled()) {
+            qCritical() << "--alloc-check needs a build configured with -DMUSICVIS_COUNT_ALLOCATIONS=ON.";
+            return 2;
+        }
+        w.visualizer()->startAllocationCheck(parser.value(allocCheckOption).toInt());
+    }
 
     // Pass the audio file path (which might be empty) to the main window.
     w.setAudioFile(audioFilePath);
@@ -1,10 +1,12 @@
 #include "mainwindow.h"
 #include "./ui_mainwindow.h"
 #include "projectmwindow.h"
+#include "librarybrowser.h"
 #include <QVBoxLayout>
 #include <QFileDialog>
 #include <QMenu>
 #include <QAction>
+#include <QDockWidget>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -47,9 +49,23 @@ MainWindow::MainWindow(QWidget *parent)
         }
     });
     
+    // Music library, indexed in the background; hidden until asked for
+    m_library = new MusicLibrary(this);
+    LibraryBrowser *libraryBrowser = new LibraryBrowser(m_library, this);
+    connect(libraryBrowser, &LibraryBrowser::trackActivated, this, &MainWindow::setAudioFile);
+    QDockWidget *libraryDock = new QDockWidget(tr("Music Library"), this);
+    libraryDock->setObjectName("libraryDock");
+    libraryDock->setWidget(libraryBrowser);
+    addDockWidget(Qt::LeftDockWidgetArea, libraryDock);
+    libraryDock->hide();
+    QAction *libraryAction = libraryDock->toggleViewAction();
+    libraryAction->setShortcut(QKeySequence(tr("Ctrl+L")));
+    m_library->open();
+
     // Add menu bar
     QMenu *fileMenu = menuBar()->addMenu(tr("File"));
     fileMenu->addAction(openAction);
+    fileMenu->addAction(libraryAction);
     
     // Set window title
     setWindowTitle(tr("MusicVisQT"));
@@ -65,4 +81,11 @@ void MainWindow::setAudioFile(const QString& filePath)
     if (m_projectMWindow) {
         m_projectMWindow->setAudioFile(filePath);
     }
+}
+
+void MainWindow::setDecodeCacheEnabled(bool enabled)
+{
+    if (m_projectMWindow) {
+        m_projectMWindow->setDecodeCacheEnabled(enabled);
+    }
 }
\ No newline at end of file
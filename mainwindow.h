@@ -7,6 +7,7 @@
 #include <QWidget>
 #include "projectmwindow.h"
 #include "playercontroller.h"
+#include "musiclibrary.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -21,11 +22,14 @@ public:
     ~MainWindow();
 
     void setAudioFile(const QString& filePath);
+    void setDecodeCacheEnabled(bool enabled);
+    ProjectMWindow* visualizer() const { return m_projectMWindow; }
 
 private:
     Ui::MainWindow *ui;
     ProjectMWindow *m_projectMWindow;
     QWidget *m_containerWidget;
     PlayerController *m_playerController;
+    MusicLibrary *m_library;
 };
 #endif // MAINWINDOW_H
\ No newline at end of file
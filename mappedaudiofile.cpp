@@ -0,0 +1,345 @@
+#include "mappedaudiofile.h"
+
+#include <QDebug>
+#include <QFileInfo>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// How far ahead of the read position we ask the kernel to page in.
+constexpr uint64_t READAHEAD_BYTES = 4 * 1024 * 1024;
+
+uint16_t le16(const unsigned char* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+uint32_t le32(const unsigned char* p) { return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+                                               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24); }
+uint64_t le64(const unsigned char* p) { return static_cast<uint64_t>(le32(p)) | (static_cast<uint64_t>(le32(p + 4)) << 32); }
+uint16_t be16(const unsigned char* p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+uint32_t be32(const unsigned char* p) { return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+                                               (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]); }
+
+// AIFF stores the sample rate as an 80-bit IEEE extended float.
+double extended80(const unsigned char* p)
+{
+    const int exponent = ((p[0] & 0x7f) << 8) | p[1];
+    uint64_t mantissa = 0;
+    for (int i = 0; i < 8; ++i) {
+        mantissa = (mantissa << 8) | p[2 + i];
+    }
+    if (exponent == 0 && mantissa == 0) return 0.0;
+    const double value = std::ldexp(static_cast<double>(mantissa), exponent - 16383 - 63);
+    return (p[0] & 0x80) ? -value : value;
+}
+
+bool formatFromBits(int bits, bool isFloat, AudioIngest::SampleFormat* format)
+{
+    if (isFloat) {
+        if (bits != 32) return false;
+        *format = AudioIngest::SampleFormat::Float32;
+        return true;
+    }
+    switch (bits) {
+        case 16: *format = AudioIngest::SampleFormat::Int16; return true;
+        case 24: *format = AudioIngest::SampleFormat::Int24; return true;
+        case 32: *format = AudioIngest::SampleFormat::Int32; return true;
+        default: return false;
+    }
+}
+
+}
+
+MappedAudioFile::~MappedAudioFile()
+{
+    close();
+}
+
+bool MappedAudioFile::isCandidate(const QString& path)
+{
+    const QString suffix = QFileInfo(path).suffix().toLower();
+    return suffix == "wav" || suffix == "wave" || suffix == "rf64" ||
+           suffix == "aif" || suffix == "aiff" || suffix == "aifc" || isRaw(path);
+}
+
+bool MappedAudioFile::isRaw(const QString& path)
+{
+    const QString suffix = QFileInfo(path).suffix().toLower();
+    return suffix == "raw" || suffix == "pcm";
+}
+
+bool MappedAudioFile::mapFile(const QString& path)
+{
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    m_size = static_cast<uint64_t>(m_file.size());
+    if (m_size < 12) {
+        close();
+        return false;
+    }
+    m_data = m_file.map(0, static_cast<qint64>(m_size));
+    if (!m_data) {
+        qWarning() << "Could not memory-map" << path << "-" << m_file.errorString();
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool MappedAudioFile::open(const QString& path)
+{
+    if (!mapFile(path)) {
+        return false;
+    }
+
+    bool parsed = false;
+    if (!memcmp(m_data, "RIFF", 4) && !memcmp(m_data + 8, "WAVE", 4)) {
+        parsed = parseWav(false);
+    } else if (!memcmp(m_data, "RF64", 4) && !memcmp(m_data + 8, "WAVE", 4)) {
+        parsed = parseWav(true);
+    } else if (!memcmp(m_data, "FORM", 4) && !memcmp(m_data + 8, "AIFF", 4)) {
+        parsed = parseAiff(false);
+    } else if (!memcmp(m_data, "FORM", 4) && !memcmp(m_data + 8, "AIFC", 4)) {
+        parsed = parseAiff(true);
+    }
+
+    if (!parsed || !finishOpen()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool MappedAudioFile::openRaw(const QString& path, int channels, int sampleRate, AudioIngest::SampleFormat format)
+{
+    if (channels < 1 || sampleRate <= 0 || !mapFile(path)) {
+        return false;
+    }
+    m_channels = channels;
+    m_sampleRate = sampleRate;
+    m_format = format;
+    m_bytesPerSample = (format == AudioIngest::SampleFormat::Int16) ? 2
+                     : (format == AudioIngest::SampleFormat::Int24) ? 3 : 4;
+    m_samples = m_data;
+    m_frames = static_cast<int64_t>(m_size / (static_cast<uint64_t>(m_bytesPerSample) * channels));
+    m_bigEndian = false;
+    m_container = "raw";
+    if (!finishOpen()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool MappedAudioFile::parseWav(bool rf64)
+{
+    uint64_t ds64DataSize = 0;
+    bool haveFmt = false;
+    bool isFloat = false;
+    int bits = 0;
+    uint64_t offset = 12;
+
+    while (offset + 8 <= m_size) {
+        const unsigned char* chunk = m_data + offset;
+        const uint64_t chunkSize = le32(chunk + 4);
+        const unsigned char* body = chunk + 8;
+        const uint64_t available = m_size - offset - 8;
+
+        if (!memcmp(chunk, "ds64", 4) && chunkSize >= 16 && available >= 16) {
+            ds64DataSize = le64(body + 8);
+        } else if (!memcmp(chunk, "fmt ", 4) && chunkSize >= 16 && available >= 16) {
+            uint16_t tag = le16(body);
+            m_channels = le16(body + 2);
+            m_sampleRate = static_cast<int>(le32(body + 4));
+            bits = le16(body + 14);
+            if (tag == 0xFFFE && chunkSize >= 40 && available >= 40) {
+                tag = le16(body + 24); // WAVE_FORMAT_EXTENSIBLE: first two bytes of the sub-format GUID
+            }
+            if (tag != 1 && tag != 3) {
+                return false; // ADPCM, mu-law and friends go through libsndfile
+            }
+            isFloat = (tag == 3);
+            haveFmt = true;
+        } else if (!memcmp(chunk, "data", 4)) {
+            if (!haveFmt || !formatFromBits(bits, isFloat, &m_format) || m_channels < 1 || m_sampleRate <= 0) {
+                return false;
+            }
+            uint64_t dataSize = chunkSize;
+            if (rf64 && chunkSize == 0xFFFFFFFFu) {
+                dataSize = ds64DataSize;
+            }
+            // Recorders that crash mid-set leave a stale size; trust the file length
+            dataSize = std::min<uint64_t>(dataSize, available);
+            m_bytesPerSample = bits / 8;
+            m_samples = body;
+            m_frames = static_cast<int64_t>(dataSize / (static_cast<uint64_t>(m_bytesPerSample) * m_channels));
+            m_bigEndian = false;
+            m_container = rf64 ? "RF64" : "WAV";
+            return true;
+        }
+
+        offset += 8 + chunkSize + (chunkSize & 1);
+    }
+    return false;
+}
+
+bool MappedAudioFile::parseAiff(bool aifc)
+{
+    bool haveComm = false;
+    bool isFloat = false;
+    bool bigEndian = true;
+    int bits = 0;
+    uint64_t offset = 12;
+
+    while (offset + 8 <= m_size) {
+        const unsigned char* chunk = m_data + offset;
+        const uint64_t chunkSize = be32(chunk + 4);
+        const unsigned char* body = chunk + 8;
+        const uint64_t available = m_size - offset - 8;
+
+        if (!memcmp(chunk, "COMM", 4) && chunkSize >= 18 && available >= 18) {
+            m_channels = be16(body);
+            bits = be16(body + 6);
+            m_sampleRate = static_cast<int>(std::lround(extended80(body + 8)));
+            if (aifc && chunkSize >= 22 && available >= 22) {
+                const unsigned char* compression = body + 18;
+                if (!memcmp(compression, "sowt", 4)) {
+                    bigEndian = false;
+                } else if (!memcmp(compression, "fl32", 4) || !memcmp(compression, "FL32", 4)) {
+                    isFloat = true;
+                } else if (memcmp(compression, "NONE", 4) && memcmp(compression, "twos", 4)) {
+                    return false;
+                }
+            }
+            haveComm = true;
+        } else if (!memcmp(chunk, "SSND", 4) && chunkSize >= 8 && available >= 8) {
+            if (!haveComm || !formatFromBits(bits, isFloat, &m_format) || m_channels < 1 || m_sampleRate <= 0) {
+                return false;
+            }
+            const uint64_t dataOffset = be32(body);
+            const uint64_t dataSize = std::min<uint64_t>(chunkSize, available);
+            if (dataOffset + 8 > dataSize) {
+                return false;
+            }
+            m_bytesPerSample = bits / 8;
+            m_samples = body + 8 + dataOffset;
+            m_frames = static_cast<int64_t>((dataSize - 8 - dataOffset) / (static_cast<uint64_t>(m_bytesPerSample) * m_channels));
+            m_bigEndian = bigEndian;
+            m_container = aifc ? "AIFF-C" : "AIFF";
+            return true;
+        }
+
+        offset += 8 + chunkSize + (chunkSize & 1);
+    }
+    return false;
+}
+
+bool MappedAudioFile::finishOpen()
+{
+    if (m_frames <= 0) {
+        return false;
+    }
+    m_position = 0;
+    m_advisedUpTo = 0;
+    setMaxReadFrames(4096);
+
+#ifdef Q_OS_UNIX
+    // Playback is a linear scan: let the kernel read ahead aggressively and drop pages behind us.
+    madvise(const_cast<unsigned char*>(m_data), m_size, MADV_SEQUENTIAL);
+#endif
+    adviseReadahead();
+    return true;
+}
+
+void MappedAudioFile::setMaxReadFrames(size_t frames)
+{
+    m_maxReadFrames = frames;
+    if (m_bigEndian) {
+        m_swapBuffer.assign(frames * m_channels * m_bytesPerSample, 0);
+    } else {
+        m_swapBuffer.clear();
+        m_swapBuffer.shrink_to_fit();
+    }
+}
+
+void MappedAudioFile::close()
+{
+    if (m_data) {
+        m_file.unmap(const_cast<unsigned char*>(m_data));
+    }
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+    m_data = nullptr;
+    m_samples = nullptr;
+    m_size = 0;
+    m_frames = 0;
+    m_position = 0;
+    m_advisedUpTo = 0;
+    m_channels = 0;
+    m_sampleRate = 0;
+}
+
+void MappedAudioFile::adviseReadahead()
+{
+#ifdef Q_OS_UNIX
+    const uint64_t frameBytes = static_cast<uint64_t>(m_bytesPerSample) * m_channels;
+    const uint64_t pos = static_cast<uint64_t>(m_samples - m_data) + static_cast<uint64_t>(m_position) * frameBytes;
+    // Only re-issue once we're halfway through the previously advised window
+    if (m_advisedUpTo > pos + READAHEAD_BYTES / 2) {
+        return;
+    }
+    static const uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    const uint64_t start = pos & ~(pageSize - 1);
+    const uint64_t end = std::min(m_size, pos + READAHEAD_BYTES);
+    if (end > start) {
+        madvise(const_cast<unsigned char*>(m_data) + start, end - start, MADV_WILLNEED);
+    }
+    m_advisedUpTo = end;
+#endif
+}
+
+const unsigned char* MappedAudioFile::read(size_t frames, size_t* framesRead)
+{
+    *framesRead = 0;
+    if (!m_data || m_position >= m_frames) {
+        return nullptr;
+    }
+
+    frames = std::min(frames, m_maxReadFrames);
+    const int64_t count = std::min<int64_t>(static_cast<int64_t>(frames), m_frames - m_position);
+    const size_t frameBytes = static_cast<size_t>(m_bytesPerSample) * m_channels;
+    const unsigned char* src = m_samples + static_cast<uint64_t>(m_position) * frameBytes;
+    m_position += count;
+    *framesRead = static_cast<size_t>(count);
+    adviseReadahead();
+
+    if (!m_bigEndian) {
+        return src;
+    }
+
+    // AIFF: byte-swap each sample into the scratch buffer
+    const size_t samples = static_cast<size_t>(count) * m_channels;
+    unsigned char* dst = m_swapBuffer.data();
+    const int width = m_bytesPerSample;
+    for (size_t i = 0; i < samples; ++i) {
+        for (int b = 0; b < width; ++b) {
+            dst[i * width + b] = src[i * width + (width - 1 - b)];
+        }
+    }
+    return dst;
+}
+
+void MappedAudioFile::seek(int64_t frame)
+{
+    m_position = std::max<int64_t>(0, std::min(frame, m_frames));
+    m_advisedUpTo = 0;
+    adviseReadahead();
+}
@@ -0,0 +1,82 @@
+#ifndef MAPPEDAUDIOFILE_H
+#define MAPPEDAUDIOFILE_H
+
+#include <QFile>
+#include <QString>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "audioingest.h"
+
+// Memory-mapped reader for uncompressed PCM (WAV/RF64, AIFF/AIFF-C, headerless raw).
+// The header is parsed once in open(); read() then hands out pointers straight
+// into the mapping, so little-endian files are never copied before ingest.
+// Big-endian AIFF data is byte-swapped into a scratch buffer sized in open().
+class MappedAudioFile
+{
+public:
+    MappedAudioFile() = default;
+    ~MappedAudioFile();
+
+    MappedAudioFile(const MappedAudioFile&) = delete;
+    MappedAudioFile& operator=(const MappedAudioFile&) = delete;
+
+    // Detects WAV/RF64/AIFF by header. Returns false for anything the mapped
+    // path can't serve (compressed, 8-bit, unknown), so callers can fall back
+    // to libsndfile.
+    bool open(const QString& path);
+    // Headerless little-endian PCM with an externally known layout.
+    bool openRaw(const QString& path, int channels, int sampleRate, AudioIngest::SampleFormat format);
+    void close();
+
+    // Upper bound on frames handed out per read(); sizes the byte-swap buffer.
+    void setMaxReadFrames(size_t frames);
+
+    bool isOpen() const { return m_data != nullptr; }
+
+    // Returns a pointer to up to `frames` interleaved frames at the current
+    // position and advances it. *framesRead is 0 at end of file.
+    const unsigned char* read(size_t frames, size_t* framesRead);
+    void seek(int64_t frame);
+
+    int channels() const { return m_channels; }
+    int sampleRate() const { return m_sampleRate; }
+    int64_t frames() const { return m_frames; }
+    int64_t position() const { return m_position; }
+    AudioIngest::SampleFormat format() const { return m_format; }
+    const char* containerName() const { return m_container; }
+
+    // True for extensions the mapped path is worth trying on.
+    static bool isCandidate(const QString& path);
+    // Headerless extensions (.raw/.pcm); these need openRaw().
+    static bool isRaw(const QString& path);
+
+private:
+    bool mapFile(const QString& path);
+    bool parseWav(bool rf64);
+    bool parseAiff(bool aifc);
+    bool finishOpen();
+    void adviseReadahead();
+
+    QFile m_file;
+    const unsigned char* m_data = nullptr; // whole mapping
+    uint64_t m_size = 0;
+
+    // Located by the header parser
+    const unsigned char* m_samples = nullptr;
+    int m_channels = 0;
+    int m_sampleRate = 0;
+    int m_bytesPerSample = 0;
+    int64_t m_frames = 0;
+    AudioIngest::SampleFormat m_format = AudioIngest::SampleFormat::Int16;
+    bool m_bigEndian = false;
+    const char* m_container = "";
+
+    int64_t m_position = 0;
+    size_t m_maxReadFrames = 0;
+    uint64_t m_advisedUpTo = 0;            // byte offset readahead has been requested to
+    std::vector<unsigned char> m_swapBuffer; // only used for big-endian data
+};
+
+#endif // MAPPEDAUDIOFILE_H
@@ -0,0 +1,576 @@
+#include "musiclibrary.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMediaMetaData>
+#include <QSet>
+#include <QStandardPaths>
+#include <QThread>
+#include <QUrl>
+#include <sndfile.h>
+#include <algorithm>
+#include <cstring>
+
+const char INDEX_MAGIC[4] = {'M', 'V', 'L', 'I'};
+const quint32 INDEX_VERSION = 1;
+const int PROGRESS_INTERVAL_MS = 200;
+const int FALLBACK_TIMEOUT_MS = 5000;       // per file; a stuck backend doesn't stall the queue
+const qint64 DURATION_UNREADABLE = -1;      // neither libsndfile nor Qt Multimedia could read it
+
+struct MusicLibrary::ScanResult {
+    bool loadedOnly = false;    // the stored index, before the rescan
+    QStringList folders;
+    std::vector<Track> tracks;
+    std::vector<QString> fallback;
+    ScanStats stats;
+};
+
+namespace {
+
+const QStringList AUDIO_FILTERS = {
+    "*.mp3", "*.wav", "*.ogg", "*.oga", "*.opus", "*.flac",
+    "*.aif", "*.aiff", "*.m4a", "*.aac", "*.wma"
+};
+
+struct IndexHeader {
+    char magic[4];
+    quint32 version;
+    quint32 count;
+    quint32 folderCount;
+    quint32 stringsSize;
+    quint32 reserved;
+};
+
+struct StringRef {
+    quint32 offset;     // into the string block, UTF-8
+    quint32 length;
+};
+
+struct IndexRecord {
+    StringRef path;
+    StringRef title;
+    StringRef artist;
+    StringRef album;
+    qint64 mtime;
+    qint64 size;
+    qint64 durationMs;
+    quint32 sampleRate;
+    quint16 channels;
+    quint16 reserved;
+};
+
+// Artist and album names repeat across a whole album; store each string once.
+class StringBlock
+{
+public:
+    StringRef add(const QString& text)
+    {
+        const auto found = m_refs.constFind(text);
+        if (found != m_refs.constEnd()) {
+            return found.value();
+        }
+        const QByteArray utf8 = text.toUtf8();
+        const StringRef ref = {static_cast<quint32>(m_data.size()), static_cast<quint32>(utf8.size())};
+        m_data.append(utf8);
+        m_refs.insert(text, ref);
+        return ref;
+    }
+    const QByteArray& data() const { return m_data; }
+
+private:
+    QByteArray m_data;
+    QHash<QString, StringRef> m_refs;
+};
+
+void updateSearchText(MusicLibrary::Track& track)
+{
+    const QString fileName = track.path.mid(track.path.lastIndexOf('/') + 1);
+    track.searchText = (track.title + '\n' + track.artist + '\n' + track.album + '\n' + fileName).toLower();
+}
+
+QString baseName(const QString& path)
+{
+    return QFileInfo(path).completeBaseName();
+}
+
+// Header and tags only; libsndfile doesn't decode anything to fill SF_INFO.
+bool probeWithSndfile(MusicLibrary::Track& track)
+{
+    SF_INFO info;
+    memset(&info, 0, sizeof(info));
+    SNDFILE* file = sf_open(QFile::encodeName(track.path).constData(), SFM_READ, &info);
+    if (!file) {
+        return false;
+    }
+    track.sampleRate = info.samplerate;
+    track.channels = info.channels;
+    track.durationMs = info.samplerate > 0 ? info.frames * 1000 / info.samplerate : 0;
+    if (const char* title = sf_get_string(file, SF_STR_TITLE)) {
+        track.title = QString::fromUtf8(title).trimmed();
+    }
+    if (const char* artist = sf_get_string(file, SF_STR_ARTIST)) {
+        track.artist = QString::fromUtf8(artist).trimmed();
+    }
+    if (const char* album = sf_get_string(file, SF_STR_ALBUM)) {
+        track.album = QString::fromUtf8(album).trimmed();
+    }
+    sf_close(file);
+    if (track.title.isEmpty()) {
+        track.title = baseName(track.path);
+    }
+    return true;
+}
+
+bool writeIndex(const QString& indexPath, const QStringList& folders, const std::vector<MusicLibrary::Track>& tracks)
+{
+    StringBlock strings;
+    std::vector<IndexRecord> records(tracks.size());
+    for (size_t i = 0; i < tracks.size(); ++i) {
+        const MusicLibrary::Track& track = tracks[i];
+        IndexRecord& r = records[i];
+        std::memset(&r, 0, sizeof(r));
+        r.path = strings.add(track.path);
+        r.title = strings.add(track.title);
+        r.artist = strings.add(track.artist);
+        r.album = strings.add(track.album);
+        r.mtime = track.mtime;
+        r.size = track.size;
+        r.durationMs = track.durationMs;
+        r.sampleRate = static_cast<quint32>(track.sampleRate);
+        r.channels = static_cast<quint16>(track.channels);
+    }
+    std::vector<StringRef> folderRefs;
+    for (const QString& folder : folders) {
+        folderRefs.push_back(strings.add(folder));
+    }
+
+    IndexHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.version = INDEX_VERSION;
+    header.count = static_cast<quint32>(records.size());
+    header.folderCount = static_cast<quint32>(folderRefs.size());
+    header.stringsSize = static_cast<quint32>(strings.data().size());
+
+    // Write next to the target, then swap it in
+    QDir().mkpath(QFileInfo(indexPath).absolutePath());
+    const QString tmpPath = indexPath + ".part";
+    QFile out(tmpPath);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Music library: cannot create" << tmpPath << "-" << out.errorString();
+        return false;
+    }
+    bool ok = out.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header);
+    if (ok && !records.empty()) {
+        const qint64 bytes = static_cast<qint64>(sizeof(IndexRecord) * records.size());
+        ok = out.write(reinterpret_cast<const char*>(records.data()), bytes) == bytes;
+    }
+    if (ok && !folderRefs.empty()) {
+        const qint64 bytes = static_cast<qint64>(sizeof(StringRef) * folderRefs.size());
+        ok = out.write(reinterpret_cast<const char*>(folderRefs.data()), bytes) == bytes;
+    }
+    ok = ok && out.write(strings.data()) == strings.data().size();
+    if (!ok) {
+        qWarning() << "Music library: write failed for" << tmpPath << "-" << out.errorString();
+        out.remove();
+        return false;
+    }
+    out.close();
+    QFile::remove(indexPath);
+    if (!QFile::rename(tmpPath, indexPath)) {
+        qWarning() << "Music library: could not finalize" << indexPath;
+        QFile::remove(tmpPath);
+        return false;
+    }
+    return true;
+}
+
+bool readIndex(const QString& indexPath, QStringList* folders, std::vector<MusicLibrary::Track>* tracks)
+{
+    QFile file(indexPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QByteArray data = file.readAll();
+    if (data.size() < static_cast<qint64>(sizeof(IndexHeader))) {
+        return false;
+    }
+    IndexHeader header;
+    std::memcpy(&header, data.constData(), sizeof(header));
+    if (std::memcmp(header.magic, INDEX_MAGIC, sizeof(header.magic)) != 0 || header.version != INDEX_VERSION) {
+        qWarning() << "Music library: ignoring index with unknown format" << indexPath;
+        return false;
+    }
+    const quint64 recordsOffset = sizeof(IndexHeader);
+    const quint64 foldersOffset = recordsOffset + static_cast<quint64>(sizeof(IndexRecord)) * header.count;
+    const quint64 stringsOffset = foldersOffset + static_cast<quint64>(sizeof(StringRef)) * header.folderCount;
+    if (stringsOffset + header.stringsSize != static_cast<quint64>(data.size())) {
+        qWarning() << "Music library: truncated index" << indexPath;
+        return false;
+    }
+    const char* strings = data.constData() + stringsOffset;
+    bool valid = true;
+    auto text = [&](const StringRef& ref) {
+        if (static_cast<quint64>(ref.offset) + ref.length > header.stringsSize) {
+            valid = false;
+            return QString();
+        }
+        return QString::fromUtf8(strings + ref.offset, static_cast<qsizetype>(ref.length));
+    };
+
+    tracks->resize(header.count);
+    for (quint32 i = 0; i < header.count; ++i) {
+        IndexRecord r;
+        std::memcpy(&r, data.constData() + recordsOffset + sizeof(IndexRecord) * i, sizeof(r));
+        MusicLibrary::Track& track = (*tracks)[i];
+        track.path = text(r.path);
+        track.title = text(r.title);
+        track.artist = text(r.artist);
+        track.album = text(r.album);
+        track.mtime = r.mtime;
+        track.size = r.size;
+        track.durationMs = r.durationMs;
+        track.sampleRate = static_cast<int>(r.sampleRate);
+        track.channels = r.channels;
+        updateSearchText(track);
+    }
+    for (quint32 i = 0; i < header.folderCount; ++i) {
+        StringRef ref;
+        std::memcpy(&ref, data.constData() + foldersOffset + sizeof(StringRef) * i, sizeof(ref));
+        folders->append(text(ref));
+    }
+    if (!valid) {
+        qWarning() << "Music library: corrupt index" << indexPath;
+        tracks->clear();
+        folders->clear();
+    }
+    return valid;
+}
+
+}
+
+MusicLibrary::MusicLibrary(QObject *parent)
+    : QObject(parent)
+{
+    m_scanPool.setMaxThreadCount(1);
+
+    m_progressTimer.setInterval(PROGRESS_INTERVAL_MS);
+    connect(&m_progressTimer, &QTimer::timeout, this, [this]() {
+        emit scanProgress(m_progressDone.load(), m_progressTotal.load());
+    });
+
+    m_fallbackPlayer = new QMediaPlayer(this);
+    m_fallbackTimeout.setSingleShot(true);
+    connect(&m_fallbackTimeout, &QTimer::timeout, this, [this]() { finishFallback(false); });
+    connect(m_fallbackPlayer, &QMediaPlayer::mediaStatusChanged, this, [this](QMediaPlayer::MediaStatus status) {
+        if (status == QMediaPlayer::LoadedMedia) {
+            finishFallback(true);
+        } else if (status == QMediaPlayer::InvalidMedia) {
+            finishFallback(false);
+        }
+    });
+}
+
+MusicLibrary::~MusicLibrary()
+{
+    m_cancelled = true;
+    m_scanPool.waitForDone();
+}
+
+QString MusicLibrary::defaultIndexPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/library.index";
+}
+
+void MusicLibrary::open(const QString& indexPath)
+{
+    m_indexPath = indexPath;
+    if (m_scanning) {
+        m_rescanPending = true;
+        return;
+    }
+    startScan(true);
+}
+
+void MusicLibrary::addFolder(const QString& dir)
+{
+    const QString folder = QDir(dir).absolutePath();
+    if (m_folders.contains(folder)) {
+        return;
+    }
+    m_folders.append(folder);
+    rescan();
+}
+
+void MusicLibrary::rescan()
+{
+    if (m_indexPath.isEmpty()) {
+        open();
+        return;
+    }
+    if (m_scanning) {
+        m_rescanPending = true;
+        return;
+    }
+    startScan(false);
+}
+
+void MusicLibrary::startScan(bool loadIndex)
+{
+    m_scanning = true;
+    m_cancelled = false;
+    m_progressDone = 0;
+    m_progressTotal = 0;
+    m_progressTimer.start();
+
+    const QString indexPath = m_indexPath;
+    const QStringList knownFolders = m_folders;
+    QStringList indexedFolders = m_indexedFolders;      // replaced by the stored list when loading
+    std::vector<Track> known = m_tracks;    // strings are shared, not copied
+
+    m_scanPool.start([this, indexPath, knownFolders, indexedFolders, known = std::move(known), loadIndex]() mutable {
+        QElapsedTimer timer;
+        timer.start();
+        QStringList folders = knownFolders;
+
+        // --- Stored index, shown while the folders are walked ---
+        if (loadIndex) {
+            QStringList storedFolders;
+            std::vector<Track> stored;
+            if (readIndex(indexPath, &storedFolders, &stored)) {
+                for (const QString& folder : storedFolders) {
+                    if (!folders.contains(folder)) {
+                        folders.append(folder);
+                    }
+                }
+                known = std::move(stored);
+                indexedFolders = storedFolders;
+                auto loaded = std::make_shared<ScanResult>();
+                loaded->loadedOnly = true;
+                loaded->folders = folders;
+                loaded->tracks = known;
+                QMetaObject::invokeMethod(this, [this, loaded]() { finishScan(loaded); }, Qt::QueuedConnection);
+            }
+        }
+
+        // --- Walk ---
+        auto result = std::make_shared<ScanResult>();
+        result->folders = folders;
+        QSet<QString> seen;
+        for (const QString& folder : folders) {
+            QDirIterator it(folder, AUDIO_FILTERS, QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext() && !m_cancelled) {
+                Track track;
+                track.path = it.next();
+                if (seen.contains(track.path)) {
+                    continue;   // nested folders
+                }
+                seen.insert(track.path);
+                const QFileInfo info = it.fileInfo();
+                track.mtime = info.lastModified().toMSecsSinceEpoch();
+                track.size = info.size();
+                result->tracks.push_back(std::move(track));
+            }
+        }
+        if (m_cancelled) {
+            return;
+        }
+        std::sort(result->tracks.begin(), result->tracks.end(),
+                  [](const Track& a, const Track& b) { return a.path < b.path; });
+
+        // --- Reuse what hasn't changed ---
+        QHash<QString, const Track*> previous;
+        previous.reserve(static_cast<qsizetype>(known.size()));
+        for (const Track& track : known) {
+            previous.insert(track.path, &track);
+        }
+        std::vector<int> pending;
+        for (size_t i = 0; i < result->tracks.size(); ++i) {
+            Track& track = result->tracks[i];
+            const Track* old = previous.value(track.path, nullptr);
+            if (old && old->mtime == track.mtime && old->size == track.size) {
+                track = *old;
+                ++result->stats.reused;
+                if (track.durationMs == 0 && track.sampleRate == 0) {
+                    result->fallback.push_back(track.path);   // still waiting for Qt Multimedia
+                }
+            } else {
+                pending.push_back(static_cast<int>(i));
+            }
+        }
+        result->stats.files = static_cast<int>(result->tracks.size());
+        result->stats.removed = static_cast<int>(std::count_if(known.begin(), known.end(),
+            [&](const Track& track) { return !seen.contains(track.path); }));
+        m_progressTotal = static_cast<int>(pending.size());
+
+        // --- Probe new and changed files on all cores ---
+        std::vector<char> probed(pending.size(), 0);
+        std::atomic<int> next(0);
+        auto worker = [&]() {
+            for (int i = next++; i < static_cast<int>(pending.size()) && !m_cancelled; i = next++) {
+                Track& track = result->tracks[static_cast<size_t>(pending[static_cast<size_t>(i)])];
+                probed[static_cast<size_t>(i)] = probeWithSndfile(track) ? 1 : 0;
+                if (!probed[static_cast<size_t>(i)]) {
+                    track.title = baseName(track.path);
+                }
+                updateSearchText(track);
+                ++m_progressDone;
+            }
+        };
+        // Own pool so a long scan never starves the global one
+        QThreadPool pool;
+        pool.setMaxThreadCount(QThread::idealThreadCount());
+        for (int t = 0; t < pool.maxThreadCount(); ++t) {
+            pool.start(worker);
+        }
+        pool.waitForDone();
+        if (m_cancelled) {
+            return;
+        }
+        for (size_t i = 0; i < pending.size(); ++i) {
+            if (probed[i]) {
+                ++result->stats.probed;
+            } else {
+                result->fallback.push_back(result->tracks[static_cast<size_t>(pending[i])].path);
+            }
+        }
+        result->stats.fallback = static_cast<int>(result->fallback.size());
+
+        if (!pending.empty() || result->stats.removed > 0 || folders != indexedFolders) {
+            writeIndex(indexPath, folders, result->tracks);
+        }
+        result->stats.elapsedMs = timer.elapsed();
+        qInfo() << "Music library:" << result->stats.files << "files," << result->stats.reused << "unchanged,"
+                << result->stats.probed << "probed," << result->stats.fallback << "for Qt Multimedia,"
+                << result->stats.removed << "removed, in" << result->stats.elapsedMs << "ms on"
+                << pool.maxThreadCount() << "threads";
+        QMetaObject::invokeMethod(this, [this, result]() { finishScan(result); }, Qt::QueuedConnection);
+    });
+}
+
+void MusicLibrary::finishScan(const std::shared_ptr<ScanResult>& result)
+{
+    for (const QString& folder : result->folders) {
+        if (!m_folders.contains(folder)) {
+            m_folders.append(folder);
+        }
+    }
+    m_tracks = std::move(result->tracks);
+    m_trackIndex.clear();
+    m_trackIndex.reserve(static_cast<qsizetype>(m_tracks.size()));
+    for (size_t i = 0; i < m_tracks.size(); ++i) {
+        m_trackIndex.insert(m_tracks[i].path, static_cast<int>(i));
+    }
+    emit tracksChanged();
+    if (result->loadedOnly) {
+        return;
+    }
+
+    m_scanning = false;
+    m_indexedFolders = result->folders;
+    m_progressTimer.stop();
+    m_fallbackQueue.assign(result->fallback.begin(), result->fallback.end());
+    emit scanProgress(m_progressTotal.load(), m_progressTotal.load());
+    emit scanFinished(result->stats);
+
+    if (m_rescanPending) {
+        m_rescanPending = false;
+        startScan(false);
+    } else {
+        probeNextFallback();
+    }
+}
+
+std::vector<int> MusicLibrary::search(const QString& query, int limit) const
+{
+    const QStringList words = query.toLower().split(' ', Qt::SkipEmptyParts);
+    std::vector<int> matches;
+    for (size_t i = 0; i < m_tracks.size(); ++i) {
+        if (limit >= 0 && static_cast<int>(matches.size()) >= limit) {
+            break;
+        }
+        const QString& haystack = m_tracks[i].searchText;
+        bool match = true;
+        for (const QString& word : words) {
+            if (!haystack.contains(word)) {
+                match = false;
+                break;
+            }
+        }
+        if (match) {
+            matches.push_back(static_cast<int>(i));
+        }
+    }
+    return matches;
+}
+
+// --- Qt Multimedia fallback: one file at a time, driven by the player's
+// status signals, so it never waits on the GUI thread ---
+
+void MusicLibrary::probeNextFallback()
+{
+    if (m_fallbackProbing || m_scanning) {
+        return;
+    }
+    if (m_fallbackQueue.empty()) {
+        if (m_fallbackDirty) {
+            m_fallbackDirty = false;
+            emit tracksChanged();
+            saveInBackground();
+        }
+        return;
+    }
+    m_fallbackPath = m_fallbackQueue.front();
+    m_fallbackQueue.pop_front();
+    m_fallbackProbing = true;
+    m_fallbackTimeout.start(FALLBACK_TIMEOUT_MS);
+    m_fallbackPlayer->setSource(QUrl::fromLocalFile(m_fallbackPath));
+}
+
+void MusicLibrary::finishFallback(bool loaded)
+{
+    if (!m_fallbackProbing) {
+        return;     // late status change for a file that already timed out
+    }
+    m_fallbackProbing = false;
+    m_fallbackTimeout.stop();
+    // By path: a rescan may have replaced the queue and the track list meanwhile
+    const QString path = m_fallbackPath;
+    m_fallbackPath.clear();
+
+    const int index = m_trackIndex.value(path, -1);
+    if (index >= 0) {
+        Track& track = m_tracks[static_cast<size_t>(index)];
+        if (loaded) {
+            const QMediaMetaData meta = m_fallbackPlayer->metaData();
+            const QString title = meta.stringValue(QMediaMetaData::Title).trimmed();
+            track.title = title.isEmpty() ? baseName(track.path) : title;
+            track.artist = meta.stringValue(QMediaMetaData::ContributingArtist).trimmed();
+            if (track.artist.isEmpty()) {
+                track.artist = meta.stringValue(QMediaMetaData::AlbumArtist).trimmed();
+            }
+            track.album = meta.stringValue(QMediaMetaData::AlbumTitle).trimmed();
+            track.durationMs = m_fallbackPlayer->duration();
+        }
+        if (!loaded || track.durationMs <= 0) {
+            track.durationMs = DURATION_UNREADABLE;
+        }
+        updateSearchText(track);
+        m_fallbackDirty = true;
+    }
+    m_fallbackPlayer->setSource(QUrl());
+    QTimer::singleShot(0, this, &MusicLibrary::probeNextFallback);
+}
+
+void MusicLibrary::saveInBackground()
+{
+    const QString indexPath = m_indexPath;
+    const QStringList folders = m_folders;
+    const std::vector<Track> tracks = m_tracks;
+    m_scanPool.start([indexPath, folders, tracks]() { writeIndex(indexPath, folders, tracks); });
+}
@@ -0,0 +1,113 @@
+#ifndef MUSICLIBRARY_H
+#define MUSICLIBRARY_H
+
+#include <QHash>
+#include <QMediaPlayer>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+// Index of the audio files under a set of music folders, for picking
+// tracks without a file dialog. Everything slow happens off the GUI thread:
+// the index file is read, folders are walked and headers are probed on a
+// scan thread with a pool of probe workers, and the GUI thread only swaps
+// in the finished track list.
+//
+// Tags, duration, sample rate and channels come from libsndfile, which
+// only reads headers. Files it can't open (AAC, WMA, MP3 with older
+// libsndfile) are handed to a QMediaPlayer afterwards, one at a time and
+// asynchronously; that path has tags and duration but no format details.
+//
+// The index (under the user cache directory) keeps each file's mtime and
+// size, so a rescan only probes what was added or changed since.
+class MusicLibrary : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Track {
+        QString path;
+        QString title;          // from the tags, else the file name
+        QString artist;
+        QString album;
+        qint64 durationMs = 0;
+        int sampleRate = 0;     // 0 when only the Qt fallback could read it
+        int channels = 0;
+        qint64 mtime = 0;       // ms since epoch
+        qint64 size = 0;
+        QString searchText;     // lower-case title, artist, album and file name; not stored
+    };
+
+    struct ScanStats {
+        int files = 0;
+        int reused = 0;         // unchanged since the last scan
+        int probed = 0;         // read with libsndfile
+        int fallback = 0;       // queued for Qt Multimedia
+        int removed = 0;
+        qint64 elapsedMs = 0;
+    };
+
+    explicit MusicLibrary(QObject *parent = nullptr);
+    ~MusicLibrary();
+
+    static QString defaultIndexPath();
+
+    // Loads the index in the background, then rescans its folders.
+    void open(const QString& indexPath = defaultIndexPath());
+    void addFolder(const QString& dir);
+    void rescan();
+    bool isScanning() const { return m_scanning; }
+    QStringList folders() const { return m_folders; }
+
+    int count() const { return static_cast<int>(m_tracks.size()); }
+    const Track& track(int index) const { return m_tracks[static_cast<size_t>(index)]; }
+
+    // Indices of the tracks matching every word of `query` (case-insensitive,
+    // anywhere in title, artist, album or file name), in index order. An
+    // empty query matches everything. At most `limit` results if >= 0.
+    std::vector<int> search(const QString& query, int limit = -1) const;
+
+signals:
+    void tracksChanged();
+    void scanProgress(int done, int total);
+    void scanFinished(const MusicLibrary::ScanStats& stats);
+
+private:
+    struct ScanResult;
+
+    void startScan(bool loadIndex);
+    void finishScan(const std::shared_ptr<ScanResult>& result);
+    void probeNextFallback();
+    void finishFallback(bool loaded);
+    void saveInBackground();
+
+    QString m_indexPath;
+    QStringList m_folders;
+    QStringList m_indexedFolders;           // as stored in the index file
+    std::vector<Track> m_tracks;            // sorted by path
+    QHash<QString, int> m_trackIndex;       // path -> index, for the fallback prober
+
+    QThreadPool m_scanPool;                 // one scan or save at a time
+    bool m_scanning = false;
+    bool m_rescanPending = false;
+    std::atomic<bool> m_cancelled{false};
+    std::atomic<int> m_progressDone{0};
+    std::atomic<int> m_progressTotal{0};
+    QTimer m_progressTimer;
+
+    // Qt Multimedia fallback for files libsndfile can't read
+    QMediaPlayer *m_fallbackPlayer = nullptr;
+    std::deque<QString> m_fallbackQueue;
+    QString m_fallbackPath;                 // being probed, already off the queue
+    QTimer m_fallbackTimeout;
+    bool m_fallbackProbing = false;
+    bool m_fallbackDirty = false;
+};
+
+#endif // MUSICLIBRARY_H
@@ -0,0 +1,302 @@
+#include "offscreenrenderer.h"
+#include "presetpack.h"
+#include "projectmsettings.h"
+
+#include <ProjectM.hpp>
+#include <Audio/PCM.hpp>
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSurfaceFormat>
+#include <stdexcept>
+
+OffscreenRenderer::OffscreenRenderer() = default;
+
+OffscreenRenderer::~OffscreenRenderer()
+{
+    // projectM and the FBO own GL objects; release them with the context current
+    if (m_context.isValid() && makeCurrent()) {
+        releaseReadbacks();
+        m_projectM.reset();
+        m_fbo.reset();
+        m_context.doneCurrent();
+    }
+}
+
+std::vector<std::string> OffscreenRenderer::defaultTexturePaths(const std::string& presetPath)
+{
+    std::string base = presetPath;
+    if (!base.empty() && base.back() != '/') {
+        base += '/';
+    }
+    return {base + "Textures", "/usr/share/projectM/textures"};
+}
+
+bool OffscreenRenderer::makeCurrent()
+{
+    if (!m_context.makeCurrent(&m_surface)) {
+        qWarning() << "Failed to make offscreen OpenGL context current!";
+        return false;
+    }
+    return true;
+}
+
+bool OffscreenRenderer::initialize(int width, int height, const std::vector<std::string>& texturePaths)
+{
+    QSurfaceFormat format;
+    format.setRenderableType(QSurfaceFormat::OpenGL);
+    format.setDepthBufferSize(24);
+    format.setStencilBufferSize(8);
+    format.setVersion(3, 3);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+
+    m_surface.setFormat(format);
+    m_surface.create();
+    m_context.setFormat(format);
+    if (!m_context.create()) {
+        qCritical() << "Failed to create offscreen OpenGL context!";
+        return false;
+    }
+    if (!makeCurrent()) {
+        return false;
+    }
+    initializeOpenGLFunctions();
+    m_extra = m_context.extraFunctions();
+    m_rendererName = QString::fromLatin1(reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+
+    m_width = width;
+    m_height = height;
+    m_resize.reset(m_width, m_height);
+    m_resize.fitCapacity(m_width, m_height);
+    recreateFramebuffer();
+
+    try {
+        m_projectM = std::make_unique<libprojectM::ProjectM>();
+        m_projectM->SetWindowSize(m_width, m_height);
+        m_projectM->SetMeshSize(ProjectMSettings::MESH_WIDTH, ProjectMSettings::MESH_HEIGHT);
+        m_projectM->SetPresetDuration(ProjectMSettings::PRESET_DURATION);
+        m_projectM->SetHardCutDuration(ProjectMSettings::HARD_CUT_DURATION);
+        m_projectM->SetTargetFramesPerSecond(ProjectMSettings::FPS_TARGET);
+        m_projectM->SetTexturePaths(texturePaths);
+        m_projectM->LoadPresetFile("idle://", false);
+    } catch (const std::exception& e) {
+        qCritical() << "Exception during offscreen projectM initialization:" << e.what();
+        m_projectM.reset();
+    }
+
+    m_context.doneCurrent();
+    return m_projectM != nullptr;
+}
+
+void OffscreenRenderer::recreateFramebuffer()
+{
+    QOpenGLFramebufferObjectFormat fboFormat;
+    fboFormat.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+    m_fbo = std::make_unique<QOpenGLFramebufferObject>(m_resize.capacityWidth(), m_resize.capacityHeight(), fboFormat);
+}
+
+void OffscreenRenderer::resize(int width, int height)
+{
+    m_resize.request(width, height);
+}
+
+void OffscreenRenderer::applyPendingResize()
+{
+    if (!m_projectM || !m_resize.hasPending() || !makeCurrent()) {
+        return;
+    }
+    applyResize();
+    m_context.doneCurrent();
+}
+
+// Needs the context current. The FBO is only replaced when the new size
+// doesn't fit its capacity; projectM reallocates its own buffers regardless.
+void OffscreenRenderer::applyResize()
+{
+    int width = 0;
+    int height = 0;
+    if (!m_resize.take(&width, &height)) {
+        return;
+    }
+    m_width = width;
+    m_height = height;
+    if (m_resize.fitCapacity(m_width, m_height)) {
+        recreateFramebuffer();
+    }
+    m_projectM->SetWindowSize(m_width, m_height);
+}
+
+bool OffscreenRenderer::loadPreset(const std::string& path, bool smooth)
+{
+    if (!m_projectM || !makeCurrent()) {
+        return false;
+    }
+    bool ok = true;
+    try {
+        ok = PresetPack::loadPreset(*m_projectM, path, smooth);
+    } catch (const std::exception& e) {
+        qWarning() << "Failed to load preset" << QString::fromStdString(path) << "-" << e.what();
+        ok = false;
+    }
+    m_context.doneCurrent();
+    return ok;
+}
+
+libprojectM::Audio::PCM& OffscreenRenderer::pcm()
+{
+    if (!m_projectM) {
+        throw std::runtime_error("OffscreenRenderer used before initialize()");
+    }
+    return m_projectM->PCM();
+}
+
+qint64 OffscreenRenderer::renderFrame(double frameTimeSeconds)
+{
+    if (!m_projectM || !makeCurrent()) {
+        return 0;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    drawFrame(frameTimeSeconds);
+    glFinish();
+
+    const qint64 elapsed = timer.nsecsElapsed();
+    m_context.doneCurrent();
+    return elapsed;
+}
+
+// Needs the context current.
+void OffscreenRenderer::drawFrame(double frameTimeSeconds)
+{
+    applyResize();
+    m_fbo->bind();
+    glViewport(0, 0, m_width, m_height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    try {
+        // Fixed timestep: animation time comes from the caller, not the wall clock
+        m_projectM->SetFrameTime(frameTimeSeconds);
+        m_projectM->RenderFrame(m_fbo->handle());
+    } catch (const std::exception& e) {
+        qCritical() << "Exception during offscreen projectM rendering:" << e.what();
+    }
+}
+
+qint64 OffscreenRenderer::submitFrame(double frameTimeSeconds, qint64 tag)
+{
+    if (!m_projectM || !canSubmit() || !makeCurrent()) {
+        return 0;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    drawFrame(frameTimeSeconds);
+    queueReadback(tag);
+    glFlush();
+
+    const qint64 elapsed = timer.nsecsElapsed();
+    m_context.doneCurrent();
+    return elapsed;
+}
+
+// Needs the context current. glReadPixels into a bound pack buffer only
+// records the copy; the fence tells when it (and the frame) is done.
+void OffscreenRenderer::queueReadback(qint64 tag)
+{
+    ReadbackSlot& slot = m_readbacks[(m_readbackHead + m_readbackCount) % READBACK_SLOTS];
+    const size_t bytes = static_cast<size_t>(m_width) * m_height * 4;
+    if (slot.buffer == 0) {
+        glGenBuffers(1, &slot.buffer);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (slot.capacity < bytes) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(bytes), nullptr, GL_STREAM_READ);
+        slot.capacity = bytes;
+    }
+    // projectM leaves its own framebuffers bound
+    m_fbo->bind();
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = m_extra->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.width = m_width;
+    slot.height = m_height;
+    slot.tag = tag;
+    m_readbackCount++;
+}
+
+bool OffscreenRenderer::readbackReady()
+{
+    if (m_readbackCount == 0 || !makeCurrent()) {
+        return false;
+    }
+    const GLenum status = m_extra->glClientWaitSync(m_readbacks[m_readbackHead].fence, 0, 0);
+    m_context.doneCurrent();
+    return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+}
+
+bool OffscreenRenderer::takeReadback(const ReadbackConsumer& consume, bool wait)
+{
+    if (m_readbackCount == 0 || !makeCurrent()) {
+        return false;
+    }
+    ReadbackSlot& slot = m_readbacks[m_readbackHead];
+    const GLuint64 timeout = wait ? GLuint64(1000000000) : 0;   // 1 s
+    const GLenum status = m_extra->glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, timeout);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+        m_context.doneCurrent();
+        return false;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const size_t bytes = static_cast<size_t>(slot.width) * slot.height * 4;
+    const void* pixels = m_extra->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(bytes), GL_MAP_READ_BIT);
+    if (pixels) {
+        consume(static_cast<const uchar*>(pixels), slot.width, slot.height, slot.tag);
+        m_extra->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    } else {
+        qWarning() << "Failed to map readback buffer for frame" << slot.tag;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    m_extra->glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    m_readbackHead = (m_readbackHead + 1) % READBACK_SLOTS;
+    m_readbackCount--;
+    m_context.doneCurrent();
+    return pixels != nullptr;
+}
+
+// Needs the context current.
+void OffscreenRenderer::releaseReadbacks()
+{
+    for (ReadbackSlot& slot : m_readbacks) {
+        if (slot.fence) {
+            m_extra->glDeleteSync(slot.fence);
+        }
+        if (slot.buffer) {
+            glDeleteBuffers(1, &slot.buffer);
+        }
+        slot = ReadbackSlot();
+    }
+    m_readbackHead = 0;
+    m_readbackCount = 0;
+}
+
+QImage OffscreenRenderer::grabFrame()
+{
+    if (!m_fbo || !makeCurrent()) {
+        return QImage();
+    }
+    QImage image = m_fbo->toImage();
+    if (image.size() != QSize(m_width, m_height)) {
+        // toImage() is top-down; the frame sits at the bottom of a larger FBO
+        image = image.copy(0, image.height() - m_height, m_width, m_height);
+    }
+    m_context.doneCurrent();
+    return image;
+}
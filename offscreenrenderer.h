@@ -0,0 +1,117 @@
+#ifndef OFFSCREENRENDERER_H
+#define OFFSCREENRENDERER_H
+
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "resizecoalescer.h"
+
+// projectM classes
+namespace libprojectM {
+    class ProjectM;
+    namespace Audio {
+        class PCM;
+    }
+}
+
+// A projectM instance rendering into an FBO on its own offscreen context, on
+// a caller-driven fixed timestep. Works without a display or GPU
+// (QT_QPA_PLATFORM=offscreen with Mesa llvmpipe), which is what replay, batch
+// rendering and latency measurement rely on. Must be used from the thread
+// that created it.
+class OffscreenRenderer : protected QOpenGLFunctions
+{
+public:
+    OffscreenRenderer();
+    ~OffscreenRenderer();
+
+    OffscreenRenderer(const OffscreenRenderer&) = delete;
+    OffscreenRenderer& operator=(const OffscreenRenderer&) = delete;
+
+    bool initialize(int width, int height, const std::vector<std::string>& texturePaths);
+    bool isInitialized() const { return m_projectM != nullptr; }
+
+    // Takes effect at the start of the next renderFrame(); only the last of
+    // several resizes between frames is applied.
+    void resize(int width, int height);
+    // Applies a pending resize right away instead.
+    void applyPendingResize();
+    bool loadPreset(const std::string& path, bool smooth = false);
+
+    // Feed audio before renderFrame(); projectM analyses whatever is queued.
+    libprojectM::Audio::PCM& pcm();
+
+    // Renders one frame at `frameTimeSeconds` of animation time and waits for
+    // the GPU. Returns the wall time it took in nanoseconds.
+    qint64 renderFrame(double frameTimeSeconds);
+
+    // Reads back the last rendered frame (synchronous).
+    QImage grabFrame();
+
+    // Asynchronous readback through a small ring of pixel pack buffers, for
+    // measuring the pipeline without stalling it. submitFrame() renders like
+    // renderFrame() but doesn't wait for the GPU; it queues a readback of the
+    // frame under `tag` and returns the CPU time spent in nanoseconds.
+    qint64 submitFrame(double frameTimeSeconds, qint64 tag);
+    bool canSubmit() const { return m_readbackCount < READBACK_SLOTS; }
+    // Whether the GPU has finished the oldest queued frame.
+    bool readbackReady();
+    // Maps the oldest queued frame (waiting for it if `wait`) and hands its
+    // RGBA pixels, bottom row first, to `consume`. False if none was ready.
+    using ReadbackConsumer = std::function<void(const uchar* rgba, int width, int height, qint64 tag)>;
+    bool takeReadback(const ReadbackConsumer& consume, bool wait);
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    QString rendererName() const { return m_rendererName; }
+    QOpenGLContext* context() { return &m_context; }
+    // May be larger than width() x height(); the frame is in its lower left corner.
+    QOpenGLFramebufferObject* framebuffer() { return m_fbo.get(); }
+    const ResizeCoalescer::Stats& resizeStats() const { return m_resize.stats(); }
+
+    // Default texture search paths for a preset root, same as the window uses.
+    static std::vector<std::string> defaultTexturePaths(const std::string& presetPath);
+
+private:
+    static constexpr int READBACK_SLOTS = 3;
+
+    struct ReadbackSlot {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+        size_t capacity = 0;
+        int width = 0;
+        int height = 0;
+        qint64 tag = 0;
+    };
+
+    bool makeCurrent();
+    void recreateFramebuffer();
+    void applyResize();
+    void drawFrame(double frameTimeSeconds);
+    void queueReadback(qint64 tag);
+    void releaseReadbacks();
+
+    QOffscreenSurface m_surface;
+    QOpenGLContext m_context;
+    std::unique_ptr<QOpenGLFramebufferObject> m_fbo;
+    std::unique_ptr<libprojectM::ProjectM> m_projectM;
+    int m_width = 0;
+    int m_height = 0;
+    ResizeCoalescer m_resize;
+    QString m_rendererName;
+
+    QOpenGLExtraFunctions* m_extra = nullptr;
+    ReadbackSlot m_readbacks[READBACK_SLOTS];
+    int m_readbackHead = 0;                 // oldest queued slot
+    int m_readbackCount = 0;
+};
+
+#endif // OFFSCREENRENDERER_H
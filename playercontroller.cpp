@@ -1,5 +1,6 @@
 #include "playercontroller.h"
 #include <QTime>
+#include <QUrl>
 
 PlayerController::PlayerController(QWidget *parent)
     : QWidget(parent)
@@ -17,6 +18,9 @@ void PlayerController::setMediaPlayer(QMediaPlayer *player)
                 this, &PlayerController::updatePosition);
         connect(m_mediaPlayer, &QMediaPlayer::durationChanged,
                 this, &PlayerController::updateDuration);
+        connect(m_mediaPlayer, &QMediaPlayer::sourceChanged,
+                this, &PlayerController::loadWaveform);
+        loadWaveform(m_mediaPlayer->source());
     }
 }
 
@@ -39,10 +43,8 @@ void PlayerController::setupUI()
     m_stopButton->setIcon(style()->standardIcon(QStyle::SP_MediaStop));
     m_stopButton->setToolTip(tr("Stop"));
     
-    // Create sliders
-    m_positionSlider = new QSlider(Qt::Horizontal, this);
-    m_positionSlider->setRange(0, 0);
-    m_positionSlider->setToolTip(tr("Position"));
+    // Create seek bar and volume slider
+    m_seekBar = new WaveformSeekBar(this);
     
     m_volumeSlider = new QSlider(Qt::Horizontal, this);
     m_volumeSlider->setRange(0, 100);
@@ -57,14 +59,14 @@ void PlayerController::setupUI()
     connect(m_playPauseButton, &QPushButton::clicked, this, &PlayerController::playPause);
     connect(m_stopButton, &QPushButton::clicked, this, &PlayerController::stop);
     connect(m_volumeSlider, &QSlider::valueChanged, this, &PlayerController::setVolume);
-    connect(m_positionSlider, &QSlider::sliderMoved, this, &PlayerController::setPosition);
+    connect(m_seekBar, &WaveformSeekBar::seekRequested, this, &PlayerController::setPosition);
     
     // Layout
     QHBoxLayout *layout = new QHBoxLayout(this);
     layout->addWidget(m_playPauseButton);
     layout->addWidget(m_stopButton);
     layout->addWidget(m_positionLabel);
-    layout->addWidget(m_positionSlider);
+    layout->addWidget(m_seekBar, 1);
     layout->addWidget(m_durationLabel);
     layout->addWidget(new QLabel(tr("Vol:")));
     layout->addWidget(m_volumeSlider);
@@ -108,22 +110,32 @@ void PlayerController::updatePlayPauseButton()
 
 void PlayerController::updatePosition(qint64 position)
 {
-    m_positionSlider->setValue(static_cast<int>(position));
+    m_seekBar->setPosition(position);
     m_positionLabel->setText(formatTime(position));
 }
 
 void PlayerController::updateDuration(qint64 duration)
 {
-    m_positionSlider->setRange(0, static_cast<int>(duration));
+    m_seekBar->setDuration(duration);
     m_durationLabel->setText(formatTime(duration));
 }
 
-void PlayerController::setPosition(int position)
+void PlayerController::setPosition(qint64 position)
 {
     if (!m_mediaPlayer) return;
     m_mediaPlayer->setPosition(position);
 }
 
+void PlayerController::loadWaveform(const QUrl &source)
+{
+    // The previous track's extraction has nothing left to show
+    if (m_peaks) {
+        m_peaks->cancel();
+    }
+    m_peaks = source.isLocalFile() ? WaveformPeaks::open(source.toLocalFile()) : nullptr;
+    m_seekBar->setPeaks(m_peaks);
+}
+
 QString PlayerController::formatTime(qint64 ms)
 {
     QTime time(0, 0);
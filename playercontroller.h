@@ -9,6 +9,9 @@
 #include <QLabel>
 #include <QHBoxLayout>
 #include <QStyle>
+#include <memory>
+
+#include "waveformseekbar.h"
 
 class PlayerController : public QWidget
 {
@@ -26,7 +29,8 @@ private slots:
     void updatePlayPauseButton();
     void updatePosition(qint64 position);
     void updateDuration(qint64 duration);
-    void setPosition(int position);
+    void setPosition(qint64 position);
+    void loadWaveform(const QUrl &source);
 
 private:
     QMediaPlayer *m_mediaPlayer = nullptr;
@@ -35,7 +39,8 @@ private:
     QPushButton *m_playPauseButton;
     QPushButton *m_stopButton;
     QSlider *m_volumeSlider;
-    QSlider *m_positionSlider;
+    WaveformSeekBar *m_seekBar;
+    std::shared_ptr<WaveformPeaks> m_peaks;
     QLabel *m_positionLabel;
     QLabel *m_durationLabel;
     
@@ -0,0 +1,71 @@
+#include "powerstate.h"
+
+#include <cstdio>
+
+const size_t SUMMARY_SIZE = 128;
+
+PowerStateTracker::PowerStateTracker()
+{
+    m_sinceTransition.start();
+}
+
+void PowerStateTracker::transition(PowerState next)
+{
+    if (next == m_state) {
+        return;
+    }
+    m_accumulated[static_cast<size_t>(m_state)] += m_sinceTransition.restart();
+    m_state = next;
+    m_transitions++;
+}
+
+qint64 PowerStateTracker::timeIn(PowerState state) const
+{
+    qint64 ms = m_accumulated[static_cast<size_t>(state)];
+    if (state == m_state) {
+        ms += m_sinceTransition.elapsed();
+    }
+    return ms;
+}
+
+QString PowerStateTracker::summary() const
+{
+    char text[SUMMARY_SIZE];
+    formatSummary(text, sizeof(text));
+    return QString::fromLatin1(text);
+}
+
+void PowerStateTracker::formatSummary(char* out, size_t size) const
+{
+    if (size == 0) {
+        return;
+    }
+    const PowerState states[] = {PowerState::Active, PowerState::LowRate, PowerState::Suspended};
+    qint64 total = 0;
+    for (PowerState s : states) {
+        total += timeIn(s);
+    }
+
+    out[0] = '\0';
+    size_t used = 0;
+    for (PowerState s : states) {
+        const qint64 ms = timeIn(s);
+        const int percent = total > 0 ? static_cast<int>(ms * 100 / total) : 0;
+        const int written = std::snprintf(out + used, size - used, "%s%s %.1fs (%d%%)", used > 0 ? ", " : "",
+                                          name(s), ms / 1000.0, percent);
+        if (written < 0 || used + static_cast<size_t>(written) >= size) {
+            break;
+        }
+        used += static_cast<size_t>(written);
+    }
+}
+
+const char* PowerStateTracker::name(PowerState state)
+{
+    switch (state) {
+        case PowerState::Active: return "active";
+        case PowerState::LowRate: return "low";
+        case PowerState::Suspended: return "suspended";
+    }
+    return "unknown";
+}
@@ -0,0 +1,43 @@
+#ifndef POWERSTATE_H
+#define POWERSTATE_H
+
+#include <QElapsedTimer>
+#include <QString>
+#include <array>
+
+// How hard the render loop is allowed to work.
+enum class PowerState {
+    Active,     // full frame rate
+    LowRate,    // playback paused/stopped or audio silent: a few frames per second
+    Suspended   // window not exposed (minimized, occluded, hidden): no frames at all
+};
+
+// Accounts wall-clock time spent in each PowerState so kiosk deployments can
+// see how much of the day the visualizer actually spent rendering.
+class PowerStateTracker
+{
+public:
+    PowerStateTracker();
+
+    PowerState state() const { return m_state; }
+    void transition(PowerState next);
+
+    // Milliseconds spent in `state`, including the current stretch.
+    qint64 timeIn(PowerState state) const;
+    int transitionCount() const { return m_transitions; }
+
+    // e.g. "active 812.4s (93%), low 60.0s (7%), suspended 0.0s (0%)"
+    QString summary() const;
+    // Same into a caller's buffer, for logging from the frame loop without allocating.
+    void formatSummary(char* out, size_t size) const;
+
+    static const char* name(PowerState state);
+
+private:
+    PowerState m_state = PowerState::Active;
+    QElapsedTimer m_sinceTransition;
+    std::array<qint64, 3> m_accumulated = {0, 0, 0};
+    int m_transitions = 0;
+};
+
+#endif // POWERSTATE_H
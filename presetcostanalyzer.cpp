@@ -0,0 +1,501 @@
+#include "presetcostanalyzer.h"
+#include "presetpack.h"
+#include "projectmsettings.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+const int MAX_CUSTOM = 4;                   // custom waves / shapes per preset
+const int MAX_WAVE_SAMPLES = 512;
+const int MAX_SHAPE_INSTANCES = 1024;
+const int VERTICES = (ProjectMSettings::MESH_WIDTH + 1) * (ProjectMSettings::MESH_HEIGHT + 1);
+const double TRANSCENDENTAL_OPS = 4.0;      // sin, pow, sqrt, ... against one add
+const double DRAW_VERTEX_OPS = 4.0;         // submitting one wave point / shape vertex
+const double SAMPLE_OPS = 8.0;              // one texture fetch in ALU operations
+const double BLUR_LEVEL_OPS = 24.0;         // per output pixel for each blur level read
+const double DEFAULT_WARP_OPS = 8.0;        // projectM's built-in shaders for presets without any
+const double DEFAULT_COMP_OPS = 16.0;
+const double REFERENCE_PIXELS = 1920.0 * 1080.0;
+const double GPU_OP_WEIGHT = 1.0 / 2000.0;  // a shader op against an interpreted equation op
+
+namespace {
+
+struct Work {
+    double ops = 0.0;
+    double samples = 0.0;
+
+    Work& operator+=(const Work& other)
+    {
+        ops += other.ops;
+        samples += other.samples;
+        return *this;
+    }
+};
+
+struct Scan {
+    bool shader = false;
+    int blurLevel = 0;
+    bool loops = false;
+};
+
+bool isIdentifierStart(char c)
+{
+    return std::isalpha(static_cast<unsigned char>(c)) || c == '_';
+}
+
+bool isIdentifierChar(char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+bool isOneOf(const std::string& word, const char* const* list)
+{
+    for (; *list; ++list) {
+        if (word == *list) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* const EEL_TRANSCENDENTAL[] = {"sin", "cos", "tan", "asin", "acos", "atan", "atan2", "pow", "exp", "log",
+                                          "log10", "sqrt", "invsqrt", "sigmoid", "rand", nullptr};
+const char* const HLSL_TRANSCENDENTAL[] = {"sin", "cos", "tan", "asin", "acos", "atan", "atan2", "sincos", "sinh",
+                                           "cosh", "tanh", "pow", "exp", "exp2", "log", "log2", "log10", "sqrt",
+                                           "rsqrt", "length", "distance", "normalize", nullptr};
+const char* const HLSL_SAMPLES[] = {"tex2D", "tex3D", "tex2Dlod", "tex2Dbias", "tex2Dgrad", "tex2Dproj", "texCUBE",
+                                    "GetPixel", "GetMain", nullptr};
+const char* const HLSL_FREE[] = {"float", "float2", "float3", "float4", "float2x2", "float3x3", "float4x4",
+                                 "half", "half2", "half3", "half4", "int", "int2", "int3", "int4", "bool", nullptr};
+
+size_t skipSpace(const std::string& s, size_t i, size_t end)
+{
+    while (i < end && std::isspace(static_cast<unsigned char>(s[i]))) {
+        ++i;
+    }
+    return i;
+}
+
+// Index of the bracket closing the one at `open`, or `end`.
+size_t matching(const std::string& s, size_t open, size_t end)
+{
+    const char opening = s[open];
+    const char closing = opening == '(' ? ')' : '}';
+    int depth = 0;
+    for (size_t i = open; i < end; ++i) {
+        if (s[i] == opening) {
+            depth++;
+        } else if (s[i] == closing && --depth == 0) {
+            return i;
+        }
+    }
+    return end;
+}
+
+Work count(const std::string& s, size_t i, size_t end, Scan& scan);
+
+Work callCost(const std::string& name, Scan& scan)
+{
+    Work work;
+    if (!scan.shader) {
+        work.ops = isOneOf(name, EEL_TRANSCENDENTAL) ? TRANSCENDENTAL_OPS : 1.0;
+        return work;
+    }
+    if (name.size() == 8 && name.compare(0, 7, "GetBlur") == 0 && name[7] >= '1' && name[7] <= '3') {
+        scan.blurLevel = std::max(scan.blurLevel, name[7] - '0');
+        work.samples = 1.0;
+    } else if (isOneOf(name, HLSL_SAMPLES)) {
+        work.samples = 1.0;
+    } else if (isOneOf(name, HLSL_TRANSCENDENTAL)) {
+        work.ops = TRANSCENDENTAL_OPS;
+    } else if (!isOneOf(name, HLSL_FREE)) {
+        work.ops = 1.0;
+    }
+    return work;
+}
+
+// Operations and texture samples in s[i, end), skipping comments. Loop
+// bodies count LOOP_ITERATIONS times: loop(n, body) and while(body) in
+// the equation language, for/while (header) body in shaders.
+Work count(const std::string& s, size_t i, size_t end, Scan& scan)
+{
+    Work work;
+    while (i < end) {
+        const char c = s[i];
+        if (c == '/' && i + 1 < end && s[i + 1] == '/') {
+            const size_t newline = s.find('\n', i);
+            i = newline == std::string::npos ? end : std::min(newline, end);
+            continue;
+        }
+        if (c == '/' && i + 1 < end && s[i + 1] == '*') {
+            const size_t close = s.find("*/", i + 2);
+            i = close == std::string::npos ? end : std::min(close + 2, end);
+            continue;
+        }
+        if (isIdentifierStart(c)) {
+            size_t j = i;
+            while (j < end && isIdentifierChar(s[j])) {
+                ++j;
+            }
+            const std::string name = s.substr(i, j - i);
+            const size_t open = skipSpace(s, j, end);
+            if (open < end && s[open] == '(') {
+                const bool loop = scan.shader ? (name == "for" || name == "while") : (name == "loop" || name == "while");
+                if (loop) {
+                    scan.loops = true;
+                    const size_t close = matching(s, open, end);
+                    size_t bodyEnd = std::min(close + 1, end);
+                    if (scan.shader && bodyEnd < end) {
+                        const size_t body = skipSpace(s, bodyEnd, end);
+                        if (body < end && s[body] == '{') {
+                            bodyEnd = std::min(matching(s, body, end) + 1, end);
+                        } else {
+                            const size_t semicolon = s.find(';', body);
+                            bodyEnd = semicolon == std::string::npos ? end : std::min(semicolon + 1, end);
+                        }
+                    }
+                    Work body = count(s, open + 1, bodyEnd, scan);
+                    body.ops *= PresetCostAnalyzer::LOOP_ITERATIONS;
+                    body.samples *= PresetCostAnalyzer::LOOP_ITERATIONS;
+                    work += body;
+                    i = bodyEnd;
+                    continue;
+                }
+                work += callCost(name, scan);
+            }
+            i = j;
+            continue;
+        }
+        if (std::isdigit(static_cast<unsigned char>(c)) ||
+            (c == '.' && i + 1 < end && std::isdigit(static_cast<unsigned char>(s[i + 1])))) {
+            // 1.5, .5, 1e-3, 2.0f, 0x10
+            while (i < end && (isIdentifierChar(s[i]) || s[i] == '.' ||
+                               ((s[i] == '-' || s[i] == '+') && (s[i - 1] == 'e' || s[i - 1] == 'E')))) {
+                ++i;
+            }
+            continue;
+        }
+        if (std::strchr("+-*/%^&|<>=!?", c)) {
+            work.ops += 1.0;
+            // two-character operators (==, <=, &&, +=, ...) are one operation
+            i += (i + 1 < end && std::strchr("=&|<>", s[i + 1])) ? 2 : 1;
+            continue;
+        }
+        ++i;
+    }
+    return work;
+}
+
+Work countAll(const std::string& code, Scan& scan)
+{
+    return count(code, 0, code.size(), scan);
+}
+
+bool startsWith(const std::string& s, const char* prefix)
+{
+    return s.compare(0, std::strlen(prefix), prefix) == 0;
+}
+
+// "wave_2_per_point" -> 2 after `prefix` "wave_", with *rest at "_per_point"; -1 if no index.
+int customIndex(const std::string& key, const char* prefix, std::string* rest)
+{
+    const size_t start = std::strlen(prefix);
+    if (key.size() <= start + 1 || !std::isdigit(static_cast<unsigned char>(key[start])) || key[start + 1] != '_') {
+        return -1;
+    }
+    *rest = key.substr(start + 1);
+    const int index = key[start] - '0';
+    return index < MAX_CUSTOM ? index : -1;
+}
+
+bool allDigits(const std::string& s, size_t from)
+{
+    if (from >= s.size()) {
+        return false;
+    }
+    for (size_t i = from; i < s.size(); ++i) {
+        if (!std::isdigit(static_cast<unsigned char>(s[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct CustomWave {
+    bool enabled = false;
+    int samples = MAX_WAVE_SAMPLES;
+    std::string perFrame;
+    std::string perPoint;
+};
+
+struct CustomShape {
+    bool enabled = false;
+    int instances = 1;
+    int sides = 4;
+    std::string perFrame;
+};
+
+void append(std::string& code, const std::string& line)
+{
+    code += line;
+    code += '\n';
+}
+
+}
+
+PresetCostAnalyzer::Cost PresetCostAnalyzer::analyze(const char* text, size_t size)
+{
+    std::string perFrame;
+    std::string perVertex;
+    std::string warp;
+    std::string comp;
+    CustomWave waves[MAX_CUSTOM];
+    CustomShape shapes[MAX_CUSTOM];
+
+    // --- Split into the blocks projectM evaluates at different rates ---
+    size_t pos = 0;
+    while (pos < size) {
+        const char* newline = static_cast<const char*>(std::memchr(text + pos, '\n', size - pos));
+        const size_t lineEnd = newline ? static_cast<size_t>(newline - text) : size;
+        std::string line(text + pos, lineEnd - pos);
+        pos = lineEnd + 1;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        const size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            continue;
+        }
+        const std::string key = line.substr(0, equals);
+        std::string value = line.substr(equals + 1);
+        std::string rest;
+        int index = -1;
+
+        if (startsWith(key, "per_frame_") && !startsWith(key, "per_frame_init_")) {
+            append(perFrame, value);
+        } else if (startsWith(key, "per_pixel_")) {
+            append(perVertex, value);
+        } else if ((startsWith(key, "warp_") && allDigits(key, 5)) || (startsWith(key, "comp_") && allDigits(key, 5))) {
+            if (!value.empty() && value[0] == '`') {
+                value.erase(0, 1);
+            }
+            append(key[0] == 'w' ? warp : comp, value);
+        } else if ((index = customIndex(key, "wavecode_", &rest)) >= 0) {
+            if (rest == "_enabled") {
+                waves[index].enabled = std::atoi(value.c_str()) != 0;
+            } else if (rest == "_samples") {
+                waves[index].samples = std::clamp(std::atoi(value.c_str()), 0, MAX_WAVE_SAMPLES);
+            }
+        } else if ((index = customIndex(key, "wave_", &rest)) >= 0) {
+            if (startsWith(rest, "_per_point")) {
+                append(waves[index].perPoint, value);
+            } else if (startsWith(rest, "_per_frame")) {
+                append(waves[index].perFrame, value);
+            }
+        } else if ((index = customIndex(key, "shapecode_", &rest)) >= 0) {
+            if (rest == "_enabled") {
+                shapes[index].enabled = std::atoi(value.c_str()) != 0;
+            } else if (rest == "_num_inst") {
+                shapes[index].instances = std::clamp(std::atoi(value.c_str()), 1, MAX_SHAPE_INSTANCES);
+            } else if (rest == "_sides") {
+                shapes[index].sides = std::clamp(std::atoi(value.c_str()), 3, 100);
+            }
+        } else if ((index = customIndex(key, "shape_", &rest)) >= 0) {
+            if (startsWith(rest, "_per_frame")) {
+                append(shapes[index].perFrame, value);
+            }
+        }
+    }
+
+    // --- Equations, at the rate each block runs ---
+    Cost cost;
+    cost.valid = true;
+    Scan eel;
+    cost.perFrameOps = countAll(perFrame, eel).ops;
+    cost.perVertexOps = countAll(perVertex, eel).ops;
+    double cpu = cost.perFrameOps + cost.perVertexOps * VERTICES;
+    for (const CustomWave& wave : waves) {
+        if (!wave.enabled) {
+            continue;
+        }
+        cost.waves++;
+        cost.waveSamples += wave.samples;
+        cpu += countAll(wave.perFrame, eel).ops + wave.samples * (countAll(wave.perPoint, eel).ops + DRAW_VERTEX_OPS);
+    }
+    for (const CustomShape& shape : shapes) {
+        if (!shape.enabled) {
+            continue;
+        }
+        cost.shapeInstances += shape.instances;
+        cpu += shape.instances * (countAll(shape.perFrame, eel).ops + (shape.sides + 2) * DRAW_VERTEX_OPS);
+    }
+
+    // --- Shaders, per pixel at the reference resolution ---
+    Scan hlsl;
+    hlsl.shader = true;
+    Work shading;
+    if (warp.empty()) {
+        shading.ops += DEFAULT_WARP_OPS;
+        shading.samples += 1.0;
+    } else {
+        shading += countAll(warp, hlsl);
+    }
+    if (comp.empty()) {
+        shading.ops += DEFAULT_COMP_OPS;
+        shading.samples += 1.0;
+    } else {
+        shading += countAll(comp, hlsl);
+    }
+    for (int level = 3; level > hlsl.blurLevel; --level) {
+        const std::string sampler = "sampler_blur" + std::to_string(level);
+        if (warp.find(sampler) != std::string::npos || comp.find(sampler) != std::string::npos) {
+            hlsl.blurLevel = level;
+            break;
+        }
+    }
+    cost.shaderOps = shading.ops;
+    cost.textureSamples = static_cast<int>(shading.samples);
+    cost.blurLevels = hlsl.blurLevel;
+    cost.loops = eel.loops || hlsl.loops;
+
+    const double perPixel = shading.ops + shading.samples * SAMPLE_OPS + hlsl.blurLevel * BLUR_LEVEL_OPS;
+    cost.cpu = cpu;
+    cost.gpu = perPixel * REFERENCE_PIXELS * GPU_OP_WEIGHT;
+    cost.total = cost.cpu + cost.gpu;
+    return cost;
+}
+
+PresetCostAnalyzer::Cost PresetCostAnalyzer::analyzeFile(const std::string& path)
+{
+    const QByteArray text = PresetPack::readPreset(path);
+    if (text.isEmpty()) {
+        return Cost();
+    }
+    return analyze(text.constData(), static_cast<size_t>(text.size()));
+}
+
+std::vector<PresetCostAnalyzer::Cost> PresetCostAnalyzer::analyzeAll(const std::vector<std::string>& files)
+{
+    std::vector<Cost> costs(files.size());
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < files.size(); i = next++) {
+            costs[i] = analyzeFile(files[i]);
+        }
+    };
+    // Own pool so a full scan doesn't hold up the global one
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    for (int t = 0; t < pool.maxThreadCount(); ++t) {
+        pool.start(worker);
+    }
+    pool.waitForDone();
+    return costs;
+}
+
+double PresetCostAnalyzer::limitForPercent(const std::vector<Cost>& costs, double percent)
+{
+    std::vector<double> totals;
+    totals.reserve(costs.size());
+    for (const Cost& cost : costs) {
+        if (cost.valid) {
+            totals.push_back(cost.total);
+        }
+    }
+    if (totals.empty() || percent <= 0.0) {
+        return 0.0;
+    }
+    std::sort(totals.begin(), totals.end());
+    const double keep = std::clamp(1.0 - percent / 100.0, 0.0, 1.0);
+    const size_t index = std::min(totals.size() - 1, static_cast<size_t>(keep * (totals.size() - 1)));
+    return totals[index];
+}
+
+int PresetCostAnalyzer::writeReport(const QString& presetRoot, const QString& reportPath)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const QDir root(presetRoot);
+    std::vector<std::string> files;
+    QDirIterator it(presetRoot, QStringList() << "*.milk", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        files.push_back(it.next().toStdString());
+    }
+    if (files.empty()) {
+        qCritical() << "No presets found under" << presetRoot;
+        return 1;
+    }
+    const qint64 scanMs = timer.elapsed();
+    const std::vector<Cost> costs = analyzeAll(files);
+    const qint64 analyzeMs = timer.elapsed() - scanMs;
+
+    std::vector<size_t> order(files.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return costs[a].total > costs[b].total; });
+
+    QFile out(reportPath);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qCritical() << "Cannot write preset cost report" << reportPath << "-" << out.errorString();
+        return 1;
+    }
+    out.write("rank\ttotal\tcpu\tgpu\tper_frame_ops\tper_vertex_ops\tshader_ops\tsamples\tblur\t"
+              "waves\twave_samples\tshape_instances\tloops\tpreset\n");
+    int unreadable = 0;
+    for (size_t rank = 0; rank < order.size(); ++rank) {
+        const Cost& cost = costs[order[rank]];
+        if (!cost.valid) {
+            unreadable++;
+            continue;
+        }
+        const QString line = QString("%1\t%2\t%3\t%4\t%5\t%6\t%7\t%8\t%9\t%10\t%11\t%12\t%13\t%14\n")
+                                 .arg(rank + 1)
+                                 .arg(cost.total, 0, 'f', 0)
+                                 .arg(cost.cpu, 0, 'f', 0)
+                                 .arg(cost.gpu, 0, 'f', 0)
+                                 .arg(cost.perFrameOps, 0, 'f', 0)
+                                 .arg(cost.perVertexOps, 0, 'f', 0)
+                                 .arg(cost.shaderOps, 0, 'f', 0)
+                                 .arg(cost.textureSamples)
+                                 .arg(cost.blurLevels)
+                                 .arg(cost.waves)
+                                 .arg(cost.waveSamples)
+                                 .arg(cost.shapeInstances)
+                                 .arg(cost.loops ? 1 : 0)
+                                 .arg(root.relativeFilePath(QString::fromStdString(files[order[rank]])));
+        out.write(line.toUtf8());
+    }
+    out.close();
+
+    const double median = limitForPercent(costs, 50.0);
+    const double p90 = limitForPercent(costs, 10.0);
+    const double p99 = limitForPercent(costs, 1.0);
+    qInfo().noquote() << QString("Analyzed %1 presets in %2 ms on %3 threads (scan %4 ms), %5 unreadable")
+                             .arg(files.size()).arg(analyzeMs).arg(QThread::idealThreadCount()).arg(scanMs)
+                             .arg(unreadable);
+    qInfo().noquote() << QString("Cost p50 %1, p90 %2, p99 %3").arg(median, 0, 'f', 0).arg(p90, 0, 'f', 0)
+                             .arg(p99, 0, 'f', 0);
+    qInfo().noquote() << "Most expensive:";
+    for (size_t rank = 0; rank < std::min<size_t>(10, order.size()); ++rank) {
+        const Cost& cost = costs[order[rank]];
+        qInfo().noquote() << QString("  %1 (cpu %2, gpu %3)  %4")
+                                 .arg(cost.total, 10, 'f', 0)
+                                 .arg(cost.cpu, 0, 'f', 0)
+                                 .arg(cost.gpu, 0, 'f', 0)
+                                 .arg(root.relativeFilePath(QString::fromStdString(files[order[rank]])));
+    }
+    qInfo() << "Report written to" << reportPath;
+    return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef PRESETCOSTANALYZER_H
+#define PRESETCOSTANALYZER_H
+
+#include <QString>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Estimates what a preset costs to render from its text alone, so thousands
+// of presets can be ranked in seconds instead of rendering each one.
+//
+// Equations (per-frame, per-vertex, custom wave per-point, custom shape
+// per-frame) are counted in operations, with transcendental calls weighted
+// heavier and loop bodies assumed to run LOOP_ITERATIONS times, then
+// multiplied by how often projectM evaluates them: once per frame, per mesh
+// vertex, per wave sample, per shape instance. Warp and composite shaders
+// are counted in ALU operations and texture samples per pixel (GetBlurN
+// counts as a sample and pulls in the blur passes it needs), scaled to a
+// reference resolution. The GPU side is weighted down to CPU-equivalent
+// operations so both add up to one number. The weights only aim to order
+// presets sensibly; they are not a frame time.
+class PresetCostAnalyzer
+{
+public:
+    static constexpr int LOOP_ITERATIONS = 16;     // unknown trip counts
+
+    struct Cost {
+        bool valid = false;          // false if the preset couldn't be read
+        double perFrameOps = 0.0;
+        double perVertexOps = 0.0;
+        double shaderOps = 0.0;      // warp + composite ALU per pixel
+        int textureSamples = 0;      // warp + composite, per pixel
+        int blurLevels = 0;          // highest blur level the shaders read (0-3)
+        int waves = 0;               // enabled custom waves
+        int waveSamples = 0;         // points over all enabled custom waves
+        int shapeInstances = 0;      // instances over all enabled custom shapes
+        bool loops = false;          // any loop(), while() or for
+        double cpu = 0.0;            // equation operations per frame
+        double gpu = 0.0;            // shading work per frame, CPU-equivalent operations
+        double total = 0.0;          // cpu + gpu; what presets are ranked by
+    };
+
+    static Cost analyze(const char* text, size_t size);
+    // A preset file or a preset inside a pack (see PresetPack).
+    static Cost analyzeFile(const std::string& path);
+    // Every file on all cores; results in the same order as `files`.
+    static std::vector<Cost> analyzeAll(const std::vector<std::string>& files);
+
+    // The total above which the most expensive `percent` of `costs` lie.
+    static double limitForPercent(const std::vector<Cost>& costs, double percent);
+
+    // --analyze-presets: analyzes every .milk under presetRoot and writes a
+    // ranked report (tab-separated, most expensive first) to reportPath.
+    static int writeReport(const QString& presetRoot, const QString& reportPath);
+};
+
+#endif // PRESETCOSTANALYZER_H
@@ -0,0 +1,240 @@
+#include "presetlibrarywatcher.h"
+#include "logging.h"
+
+#include <QDir>
+#include <QFile>
+#include <QSocketNotifier>
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+const int DEBOUNCE_MS = 250;      // rsync/cp of a pack arrives as a burst; apply it once
+const int EVENT_BUFFER_SIZE = 64 * 1024;
+
+namespace {
+
+QString stripTrailingSlashes(QString path)
+{
+    while (path.size() > 1 && path.endsWith('/')) {
+        path.chop(1);
+    }
+    return path;
+}
+
+}
+
+PresetLibraryWatcher::PresetLibraryWatcher(QObject* parent)
+    : QObject(parent)
+{
+    m_debounce.setSingleShot(true);
+    m_debounce.setInterval(DEBOUNCE_MS);
+    connect(&m_debounce, &QTimer::timeout, this, &PresetLibraryWatcher::flush);
+}
+
+PresetLibraryWatcher::~PresetLibraryWatcher()
+{
+    stop();
+}
+
+bool PresetLibraryWatcher::start(const QString& presetRoot, const QStringList& textureRoots)
+{
+    stop();
+#ifdef Q_OS_LINUX
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+        MVLOG(Warning, Presets, "Preset watcher: inotify_init1 failed (errno %d)", errno);
+        return false;
+    }
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &PresetLibraryWatcher::readEvents);
+
+    QElapsedTimer timer;
+    timer.start();
+    // Directories only: files come and go through their parent's watch
+    addTree(stripTrailingSlashes(presetRoot), false, nullptr);
+    for (const QString& root : textureRoots) {
+        if (QDir(root).exists()) {
+            addTree(stripTrailingSlashes(root), true, nullptr);
+        }
+    }
+    MVLOG(Info, Presets, "Preset watcher: %d directories watched in %lld ms", static_cast<int>(m_watches.size()),
+          static_cast<long long>(timer.elapsed()));
+    return true;
+#else
+    Q_UNUSED(presetRoot);
+    Q_UNUSED(textureRoots);
+    MVLOG(Info, Presets, "Preset watcher: not supported on this platform; new presets need a restart");
+    return false;
+#endif
+}
+
+void PresetLibraryWatcher::stop()
+{
+    m_debounce.stop();
+    delete m_notifier;
+    m_notifier = nullptr;
+#ifdef Q_OS_LINUX
+    if (m_fd >= 0) {
+        ::close(m_fd);     // drops every watch with it
+    }
+#endif
+    m_fd = -1;
+    m_watches.clear();
+    m_written.clear();
+    m_removed.clear();
+    m_removedDirs.clear();
+    m_newDirs.clear();
+    m_texturesChanged = false;
+    m_overflowed = false;
+}
+
+// Watches `dir` and every directory below it. If milkFiles is given, also
+// collects the presets found on the way (for directories that just appeared).
+void PresetLibraryWatcher::addTree(const QString& dir, bool textures, QStringList* milkFiles)
+{
+#ifdef Q_OS_LINUX
+    const uint32_t mask = IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                          IN_DELETE_SELF | IN_ONLYDIR;
+    const int wd = inotify_add_watch(m_fd, QFile::encodeName(dir).constData(), mask);
+    if (wd < 0) {
+        MVLOG(Warning, Presets, "Preset watcher: cannot watch %s (errno %d)", qPrintable(dir), errno);
+        return;
+    }
+    m_watches.insert(wd, Watch{dir, textures});
+
+    const QDir d(dir);
+    if (milkFiles) {
+        for (const QString& name : d.entryList(QStringList() << "*.milk", QDir::Files)) {
+            milkFiles->append(dir + '/' + name);
+        }
+    }
+    for (const QString& name : d.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        addTree(dir + '/' + name, textures, milkFiles);
+    }
+#else
+    Q_UNUSED(dir);
+    Q_UNUSED(textures);
+    Q_UNUSED(milkFiles);
+#endif
+}
+
+// Forgets the watches for a directory that moved away (deleted ones go by themselves).
+void PresetLibraryWatcher::removeTree(const QString& dir)
+{
+#ifdef Q_OS_LINUX
+    const QString prefix = dir + '/';
+    for (auto it = m_watches.begin(); it != m_watches.end();) {
+        if (it->dir == dir || it->dir.startsWith(prefix)) {
+            inotify_rm_watch(m_fd, it.key());
+            it = m_watches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+#else
+    Q_UNUSED(dir);
+#endif
+}
+
+void PresetLibraryWatcher::readEvents()
+{
+#ifdef Q_OS_LINUX
+    alignas(struct inotify_event) char buffer[EVENT_BUFFER_SIZE];
+    for (;;) {
+        const ssize_t length = ::read(m_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;     // EAGAIN: drained
+        }
+        if (!m_firstEvent.isValid()) {
+            m_firstEvent.start();
+        }
+        for (char* p = buffer; p < buffer + length;) {
+            const auto* event = reinterpret_cast<const struct inotify_event*>(p);
+            p += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                m_overflowed = true;
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                m_watches.remove(event->wd);
+                continue;
+            }
+            const auto watch = m_watches.constFind(event->wd);
+            if (watch == m_watches.constEnd() || event->len == 0) {
+                continue;
+            }
+            const QString path = watch->dir + '/' + QFile::decodeName(event->name);
+
+            if (watch->textures) {
+                m_texturesChanged = true;
+                if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                    m_newDirs.append(path);
+                }
+                continue;
+            }
+
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    m_newDirs.append(path);
+                } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    m_removedDirs.append(path);
+                    removeTree(path);
+                }
+                continue;
+            }
+            if (!path.endsWith(QLatin1String(".milk"))) {
+                continue;
+            }
+            // IN_CREATE alone means the file is still being written; wait for the close
+            if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                m_written.insert(path);
+                m_removed.remove(path);
+            } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                m_removed.insert(path);
+                m_written.remove(path);
+            }
+        }
+    }
+    m_debounce.start();
+#endif
+}
+
+void PresetLibraryWatcher::flush()
+{
+    Update update;
+    QElapsedTimer scanTimer;
+    scanTimer.start();
+    for (const QString& dir : m_newDirs) {
+        const bool textures = std::any_of(m_watches.cbegin(), m_watches.cend(), [&](const Watch& w) {
+            return w.textures && dir.startsWith(w.dir + '/');
+        });
+        addTree(dir, textures, textures ? nullptr : &update.written);
+    }
+    update.scanMs = scanTimer.elapsed();
+
+    update.written += QStringList(m_written.cbegin(), m_written.cend());
+    update.removed = QStringList(m_removed.cbegin(), m_removed.cend());
+    update.removedDirs = m_removedDirs;
+    update.texturesChanged = m_texturesChanged;
+    update.overflowed = m_overflowed;
+    update.latencyMs = m_firstEvent.isValid() ? m_firstEvent.elapsed() : 0;
+
+    m_written.clear();
+    m_removed.clear();
+    m_removedDirs.clear();
+    m_newDirs.clear();
+    m_texturesChanged = false;
+    m_overflowed = false;
+    m_firstEvent.invalidate();
+
+    if (update.written.isEmpty() && update.removed.isEmpty() && update.removedDirs.isEmpty() &&
+        !update.texturesChanged && !update.overflowed) {
+        return;     // only noise (non-preset files, .part files, ...)
+    }
+    emit libraryChanged(update);
+}
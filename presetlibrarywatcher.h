@@ -0,0 +1,73 @@
+#ifndef PRESETLIBRARYWATCHER_H
+#define PRESETLIBRARYWATCHER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+class QSocketNotifier;
+
+// Watches the preset tree and texture directories with inotify and reports
+// what changed, so the catalog can be patched instead of rescanned. Runs on
+// the GUI thread off a QSocketNotifier; bursts of events (a pack being
+// synced in) are coalesced into one update. Only newly appearing
+// directories are walked. Linux only; elsewhere start() returns false.
+class PresetLibraryWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Update {
+        QStringList written;       // .milk files created, rewritten or moved in
+        QStringList removed;       // .milk files deleted or moved out
+        QStringList removedDirs;   // whole directories gone; drop everything under them
+        bool texturesChanged = false;
+        bool overflowed = false;   // kernel queue overflowed: events were lost, rescan everything
+        qint64 scanMs = 0;         // walking new directories
+        qint64 latencyMs = 0;      // first event of the batch until delivery
+    };
+
+    explicit PresetLibraryWatcher(QObject* parent = nullptr);
+    ~PresetLibraryWatcher();
+
+    bool start(const QString& presetRoot, const QStringList& textureRoots);
+    void stop();
+    bool isActive() const { return m_fd >= 0; }
+    int watchCount() const { return m_watches.size(); }
+
+signals:
+    void libraryChanged(const PresetLibraryWatcher::Update& update);
+
+private slots:
+    void readEvents();
+    void flush();
+
+private:
+    struct Watch {
+        QString dir;
+        bool textures = false;
+    };
+
+    void addTree(const QString& dir, bool textures, QStringList* milkFiles);
+    void removeTree(const QString& dir);
+
+    int m_fd = -1;
+    QSocketNotifier* m_notifier = nullptr;
+    QHash<int, Watch> m_watches;       // inotify watch descriptor -> directory
+
+    // pending batch
+    QSet<QString> m_written;
+    QSet<QString> m_removed;
+    QStringList m_removedDirs;
+    QStringList m_newDirs;
+    bool m_texturesChanged = false;
+    bool m_overflowed = false;
+    QElapsedTimer m_firstEvent;
+    QTimer m_debounce;
+};
+
+#endif // PRESETLIBRARYWATCHER_H
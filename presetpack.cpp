@@ -0,0 +1,436 @@
+#include "presetpack.h"
+
+#include <ProjectM.hpp>
+
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <istream>
+#include <streambuf>
+#include <vector>
+
+const char PACK_MAGIC[4] = {'M', 'V', 'P', 'P'};
+const quint32 PACK_VERSION = 1;
+const quint32 FLAG_COMPRESSED = 1;
+const double MIN_COMPRESSION_GAIN = 0.9;    // keep compressed bodies only below 90% of raw
+
+struct PresetPack::FileHeader {
+    char magic[4];
+    quint32 version;
+    quint32 count;
+    quint32 stringsSize;
+    quint64 indexOffset;
+    quint64 stringsOffset;
+    quint64 bodiesOffset;
+    quint64 bodiesSize;
+};
+
+struct PresetPack::IndexEntry {
+    quint32 keyOffset;     // into the string block
+    quint32 keyLength;
+    quint64 bodyOffset;    // into the body block
+    quint32 storedSize;
+    quint32 rawSize;
+    quint32 flags;
+    quint32 reserved;
+};
+
+namespace {
+
+QMutex s_sharedMutex;
+QHash<QString, std::shared_ptr<const PresetPack>> s_shared;   // failed opens stay as nullptr
+
+struct Source {
+    QByteArray key;        // UTF-8 relative .milk path; byte order is the index order
+    QString path;
+    QByteArray body;       // as stored
+    quint32 rawSize = 0;
+    bool compressed = false;
+    bool failed = false;
+};
+
+int keyCompare(const char* a, int aLength, const QByteArray& b)
+{
+    const int common = std::min(aLength, static_cast<int>(b.size()));
+    const int c = std::memcmp(a, b.constData(), static_cast<size_t>(common));
+    return c != 0 ? c : aLength - static_cast<int>(b.size());
+}
+
+// Read-only istream source over memory we already have, for LoadPresetData().
+class MemoryStreamBuffer : public std::streambuf
+{
+public:
+    MemoryStreamBuffer(const char* data, size_t size)
+    {
+        char* begin = const_cast<char*>(data);
+        setg(begin, begin, begin + size);
+    }
+};
+
+}
+
+bool PresetPack::build(const QString& presetRoot, const QString& packPath, bool compress, BuildStats* stats)
+{
+    QElapsedTimer timer;
+    timer.start();
+    BuildStats local;
+    BuildStats& result = stats ? *stats : local;
+    result = BuildStats();
+
+    // --- Scan ---
+    const QDir root(presetRoot);
+    std::vector<Source> sources;
+    QDirIterator it(presetRoot, QStringList() << "*.milk", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        Source source;
+        source.path = it.next();
+        source.key = root.relativeFilePath(source.path).toUtf8();
+        sources.push_back(std::move(source));
+    }
+    std::sort(sources.begin(), sources.end(), [](const Source& a, const Source& b) { return a.key < b.key; });
+
+    // --- Read and compress on all cores ---
+    std::atomic<int> next(0);
+    auto worker = [&]() {
+        for (int i = next++; i < static_cast<int>(sources.size()); i = next++) {
+            Source& source = sources[i];
+            QFile file(source.path);
+            if (!file.open(QIODevice::ReadOnly)) {
+                source.failed = true;
+                continue;
+            }
+            source.body = file.readAll();
+            source.rawSize = static_cast<quint32>(source.body.size());
+            if (compress && !source.body.isEmpty()) {
+                QByteArray packed = qCompress(source.body);
+                if (packed.size() < source.body.size() * MIN_COMPRESSION_GAIN) {
+                    source.body = std::move(packed);
+                    source.compressed = true;
+                }
+            }
+        }
+    };
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    for (int t = 0; t < pool.maxThreadCount(); ++t) {
+        pool.start(worker);
+    }
+    pool.waitForDone();
+
+    sources.erase(std::remove_if(sources.begin(), sources.end(), [](const Source& source) {
+        if (source.failed) {
+            qWarning() << "Preset pack: cannot read" << source.path;
+        }
+        return source.failed;
+    }), sources.end());
+
+    // --- Layout ---
+    QByteArray strings;
+    std::vector<IndexEntry> index(sources.size());
+    quint64 bodiesSize = 0;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        IndexEntry& e = index[i];
+        std::memset(&e, 0, sizeof(e));
+        e.keyOffset = static_cast<quint32>(strings.size());
+        e.keyLength = static_cast<quint32>(sources[i].key.size());
+        e.bodyOffset = bodiesSize;
+        e.storedSize = static_cast<quint32>(sources[i].body.size());
+        e.rawSize = sources[i].rawSize;
+        e.flags = sources[i].compressed ? FLAG_COMPRESSED : 0;
+        strings.append(sources[i].key);
+        bodiesSize += e.storedSize;
+        result.rawBytes += e.rawSize;
+        result.compressed += sources[i].compressed ? 1 : 0;
+    }
+    result.entries = static_cast<int>(sources.size());
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+    header.version = PACK_VERSION;
+    header.count = static_cast<quint32>(sources.size());
+    header.stringsSize = static_cast<quint32>(strings.size());
+    header.indexOffset = sizeof(FileHeader);
+    header.stringsOffset = header.indexOffset + sizeof(IndexEntry) * sources.size();
+    header.bodiesOffset = header.stringsOffset + static_cast<quint64>(strings.size());
+    header.bodiesSize = bodiesSize;
+
+    // --- Write next to the target, then swap it in ---
+    QDir().mkpath(QFileInfo(packPath).absolutePath());
+    const QString tmpPath = packPath + ".part";
+    QFile out(tmpPath);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Preset pack: cannot create" << tmpPath << "-" << out.errorString();
+        return false;
+    }
+    bool ok = out.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header);
+    if (ok && !index.empty()) {
+        const qint64 bytes = static_cast<qint64>(sizeof(IndexEntry) * index.size());
+        ok = out.write(reinterpret_cast<const char*>(index.data()), bytes) == bytes;
+    }
+    ok = ok && out.write(strings) == strings.size();
+    for (size_t i = 0; ok && i < sources.size(); ++i) {
+        ok = out.write(sources[i].body) == sources[i].body.size();
+    }
+    if (!ok) {
+        qWarning() << "Preset pack: write failed for" << tmpPath << "-" << out.errorString();
+        out.remove();
+        return false;
+    }
+    out.close();
+    QFile::remove(packPath);
+    if (!QFile::rename(tmpPath, packPath)) {
+        qWarning() << "Preset pack: could not finalize" << packPath;
+        QFile::remove(tmpPath);
+        return false;
+    }
+
+    result.fileBytes = QFileInfo(packPath).size();
+    result.elapsedMs = timer.elapsed();
+    qInfo() << "Preset pack:" << result.entries << "presets," << result.compressed << "compressed,"
+            << (result.rawBytes >> 10) << "KB ->" << (result.fileBytes >> 10) << "KB, in" << result.elapsedMs
+            << "ms on" << pool.maxThreadCount() << "threads";
+    return true;
+}
+
+std::shared_ptr<const PresetPack> PresetPack::shared(const QString& packPath)
+{
+    const QString path = QFileInfo(packPath).absoluteFilePath();
+    QMutexLocker locker(&s_sharedMutex);
+    const auto found = s_shared.constFind(path);
+    if (found != s_shared.constEnd()) {
+        return found.value();
+    }
+    auto pack = std::make_shared<PresetPack>();
+    std::shared_ptr<const PresetPack> opened;
+    if (pack->open(path)) {
+        opened = std::move(pack);
+    }
+    s_shared.insert(path, opened);
+    return opened;
+}
+
+bool PresetPack::splitPath(const std::string& path, QString* packPath, QString* key)
+{
+    const QString full = QString::fromStdString(path);
+    int separator = -1;
+    {
+        // Packs opened in this process first; no filesystem access for those
+        QMutexLocker locker(&s_sharedMutex);
+        for (auto it = s_shared.constBegin(); it != s_shared.constEnd(); ++it) {
+            if (it.value() && full.size() > it.key().size() && full.startsWith(it.key())
+                && full.at(it.key().size()) == '/') {
+                separator = static_cast<int>(it.key().size());
+                break;
+            }
+        }
+    }
+    // Otherwise (e.g. a replayed session) the pack is the nearest ancestor
+    // that is a regular file; plain preset files exist as they are
+    if (separator < 0 && !QFileInfo(full).isFile()) {
+        for (int slash = full.lastIndexOf('/'); slash > 0; slash = full.lastIndexOf('/', slash - 1)) {
+            const QFileInfo candidate(full.left(slash));
+            if (candidate.isFile()) {
+                separator = slash;
+                break;
+            }
+            if (candidate.isDir()) {
+                break;
+            }
+        }
+    }
+    if (separator < 0) {
+        return false;
+    }
+    if (packPath) {
+        *packPath = full.left(separator);
+    }
+    if (key) {
+        *key = full.mid(separator + 1);
+    }
+    return true;
+}
+
+bool PresetPack::loadPreset(libprojectM::ProjectM& projectM, const std::string& path, bool smooth)
+{
+    QString packPath;
+    QString key;
+    if (!splitPath(path, &packPath, &key)) {
+        projectM.LoadPresetFile(path, smooth);
+        return true;
+    }
+    const std::shared_ptr<const PresetPack> pack = shared(packPath);
+    const int index = pack ? pack->indexOf(key) : -1;
+    if (index < 0) {
+        qWarning() << "Preset pack: no" << key << "in" << packPath;
+        return false;
+    }
+    const QByteArray text = pack->body(index);
+    MemoryStreamBuffer buffer(text.constData(), static_cast<size_t>(text.size()));
+    std::istream stream(&buffer);
+    projectM.LoadPresetData(stream, smooth);
+    return true;
+}
+
+QByteArray PresetPack::readPreset(const std::string& path)
+{
+    QString packPath;
+    QString key;
+    if (!splitPath(path, &packPath, &key)) {
+        QFile file(QString::fromStdString(path));
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    }
+    const std::shared_ptr<const PresetPack> pack = shared(packPath);
+    const int index = pack ? pack->indexOf(key) : -1;
+    if (index < 0) {
+        return QByteArray();
+    }
+    // a deep copy: raw bodies point into the mapping
+    const QByteArray text = pack->body(index);
+    return QByteArray(text.constData(), text.size());
+}
+
+PresetPack::~PresetPack()
+{
+    close();
+}
+
+bool PresetPack::open(const QString& path)
+{
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Preset pack: cannot open" << path << "-" << m_file.errorString();
+        return false;
+    }
+    m_size = m_file.size();
+    if (m_size < static_cast<qint64>(sizeof(FileHeader))) {
+        qWarning() << "Preset pack: file too small" << path;
+        close();
+        return false;
+    }
+    m_data = m_file.map(0, m_size);
+    if (!m_data) {
+        qWarning() << "Preset pack: cannot map" << path << "-" << m_file.errorString();
+        close();
+        return false;
+    }
+
+    // Each block is checked as "fits in what's left of the file" so a corrupt
+    // header can't wrap the sums and pass
+    const FileHeader* header = reinterpret_cast<const FileHeader*>(m_data);
+    const quint64 size = static_cast<quint64>(m_size);
+    bool valid = std::memcmp(header->magic, PACK_MAGIC, sizeof(header->magic)) == 0 &&
+                 header->version == PACK_VERSION &&
+                 header->indexOffset >= sizeof(FileHeader) &&
+                 header->indexOffset <= size &&
+                 header->count <= (size - header->indexOffset) / sizeof(IndexEntry) &&
+                 header->stringsOffset == header->indexOffset + sizeof(IndexEntry) * quint64(header->count) &&
+                 header->stringsSize <= size - header->stringsOffset &&
+                 header->bodiesOffset == header->stringsOffset + header->stringsSize &&
+                 header->bodiesSize <= size - header->bodiesOffset;
+    // Every key and body must lie inside its block, or lookups read past the mapping
+    const IndexEntry* entries = reinterpret_cast<const IndexEntry*>(m_data + (valid ? header->indexOffset : 0));
+    for (quint32 i = 0; valid && i < header->count; ++i) {
+        valid = entries[i].keyOffset <= header->stringsSize &&
+                entries[i].keyLength <= header->stringsSize - entries[i].keyOffset &&
+                entries[i].bodyOffset <= header->bodiesSize &&
+                entries[i].storedSize <= header->bodiesSize - entries[i].bodyOffset;
+    }
+    if (!valid) {
+        qWarning() << "Preset pack: invalid or outdated file" << path;
+        close();
+        return false;
+    }
+
+    m_header = header;
+    m_count = static_cast<int>(header->count);
+    m_path = QFileInfo(path).absoluteFilePath();
+    return true;
+}
+
+void PresetPack::close()
+{
+    if (m_data) {
+        m_file.unmap(const_cast<uchar*>(m_data));
+    }
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+    m_data = nullptr;
+    m_header = nullptr;
+    m_size = 0;
+    m_count = 0;
+    m_path.clear();
+}
+
+const PresetPack::IndexEntry* PresetPack::entry(int index) const
+{
+    return reinterpret_cast<const IndexEntry*>(m_data + m_header->indexOffset) + index;
+}
+
+int PresetPack::indexOf(const QString& key) const
+{
+    if (!isOpen()) {
+        return -1;
+    }
+    const QByteArray utf8 = key.toUtf8();
+    const char* strings = reinterpret_cast<const char*>(m_data + m_header->stringsOffset);
+    int lo = 0;
+    int hi = m_count;
+    while (lo < hi) {
+        const int mid = lo + (hi - lo) / 2;
+        const IndexEntry* e = entry(mid);
+        const int c = keyCompare(strings + e->keyOffset, static_cast<int>(e->keyLength), utf8);
+        if (c == 0) {
+            return mid;
+        }
+        if (c < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return -1;
+}
+
+QString PresetPack::keyAt(int index) const
+{
+    if (index < 0 || index >= m_count) {
+        return QString();
+    }
+    const IndexEntry* e = entry(index);
+    const char* strings = reinterpret_cast<const char*>(m_data + m_header->stringsOffset);
+    return QString::fromUtf8(strings + e->keyOffset, static_cast<qsizetype>(e->keyLength));
+}
+
+std::string PresetPack::presetPath(int index) const
+{
+    return (m_path + '/' + keyAt(index)).toStdString();
+}
+
+QByteArray PresetPack::body(int index) const
+{
+    if (index < 0 || index >= m_count) {
+        return QByteArray();
+    }
+    const IndexEntry* e = entry(index);
+    if (e->bodyOffset + e->storedSize > m_header->bodiesSize) {
+        return QByteArray();
+    }
+    const char* stored = reinterpret_cast<const char*>(m_data + m_header->bodiesOffset + e->bodyOffset);
+    if (e->flags & FLAG_COMPRESSED) {
+        return qUncompress(reinterpret_cast<const uchar*>(stored), static_cast<qsizetype>(e->storedSize));
+    }
+    return QByteArray::fromRawData(stored, static_cast<qsizetype>(e->storedSize));
+}
@@ -0,0 +1,96 @@
+#ifndef PRESETPACK_H
+#define PRESETPACK_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QtGlobal>
+#include <memory>
+#include <string>
+
+// projectM classes
+namespace libprojectM {
+    class ProjectM;
+}
+
+// Every .milk under the preset tree in one file, memory-mapped at runtime,
+// so startup doesn't walk thousands of directories and a preset load is a
+// binary search plus (at most) an inflate instead of an open/read/close.
+// Deploying the presets is then a single-file copy.
+//
+// Layout: FileHeader | IndexEntry[count] sorted by key | key strings |
+// bodies. Keys are preset paths relative to the preset root, '/'-separated.
+// Bodies are stored zlib-compressed (qCompress) when that saves enough to
+// be worth inflating, raw otherwise.
+//
+// A preset inside a pack is addressed by "<pack file>/<key>", e.g.
+// "/opt/musicvisqt/presets.pack/Geiss/Swirl.milk", so it can go anywhere a
+// preset file path goes (the catalog, session logs, the preview strip) and
+// loadPreset() / readPreset() below resolve either kind.
+class PresetPack
+{
+public:
+    struct BuildStats {
+        int entries = 0;
+        int compressed = 0;      // bodies stored compressed
+        qint64 rawBytes = 0;     // sum of .milk sizes
+        qint64 fileBytes = 0;    // size of the pack
+        qint64 elapsedMs = 0;
+    };
+
+    // Scans presetRoot for .milk files and writes the pack, reading and
+    // compressing on all cores. With `compress` false every body is stored raw.
+    static bool build(const QString& presetRoot, const QString& packPath, bool compress = true,
+                      BuildStats* stats = nullptr);
+
+    // The pack at `packPath`, mapped on first use and shared by every caller
+    // for the rest of the process. nullptr if it can't be opened.
+    static std::shared_ptr<const PresetPack> shared(const QString& packPath);
+
+    // Splits "<pack file>/<key>"; false for plain file paths. The pack part
+    // is a pack already opened through shared(), else the nearest ancestor
+    // of `path` that is a regular file, so any pack file name works.
+    static bool splitPath(const std::string& path, QString* packPath, QString* key);
+
+    // Loads a preset path into projectM: from its pack's memory if it points
+    // into one, with LoadPresetFile() otherwise. False if the pack or the
+    // key within it is missing (projectM keeps its current preset then).
+    static bool loadPreset(libprojectM::ProjectM& projectM, const std::string& path, bool smooth);
+    // The text of a preset path, from its pack or from disk. Empty if missing.
+    static QByteArray readPreset(const std::string& path);
+
+    PresetPack() = default;
+    ~PresetPack();
+    PresetPack(const PresetPack&) = delete;
+    PresetPack& operator=(const PresetPack&) = delete;
+
+    bool open(const QString& path);
+    void close();
+    bool isOpen() const { return m_data != nullptr; }
+
+    int count() const { return m_count; }
+    // Index of a preset by its path relative to the preset root, or -1.
+    int indexOf(const QString& key) const;
+    QString keyAt(int index) const;
+    // "<pack file>/<key>" for the catalog.
+    std::string presetPath(int index) const;
+
+    // The preset's text. Raw bodies point straight into the mapping (no
+    // copy; valid while the pack is open), compressed ones are inflated.
+    QByteArray body(int index) const;
+
+private:
+    struct FileHeader;
+    struct IndexEntry;
+
+    const IndexEntry* entry(int index) const;
+
+    QFile m_file;
+    QString m_path;
+    const uchar* m_data = nullptr;
+    qint64 m_size = 0;
+    int m_count = 0;
+    const FileHeader* m_header = nullptr;
+};
+
+#endif // PRESETPACK_H
@@ -0,0 +1,296 @@
+#include "presetpreviewstrip.h"
+#include "allocationcounter.h"
+#include "presetpack.h"
+#include "projectmsettings.h"
+
+#include <ProjectM.hpp>
+#include <Audio/PCM.hpp>
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <algorithm>
+#include <exception>
+#include <sstream>
+#include <stdexcept>
+
+const int STRIP_MARGIN = 8;
+const double COST_SMOOTHING = 0.1;   // weight of the newest sample in the moving averages
+// A ready load that hasn't fit for this many frames (two seconds at 60 fps)
+// is dropped; its slot stays blank until the presets change
+const int MAX_LOAD_WAITS = 120;
+
+PresetPreviewStrip::PresetPreviewStrip() = default;
+
+PresetPreviewStrip::~PresetPreviewStrip() = default;
+
+bool PresetPreviewStrip::initialize(const std::vector<std::string>& texturePaths)
+{
+    initializeOpenGLFunctions();
+    if (!m_blitter.create()) {
+        qWarning() << "Preset preview: could not create texture blitter.";
+        return false;
+    }
+
+    QOpenGLFramebufferObjectFormat fboFormat;
+    fboFormat.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+
+    m_texturePaths = texturePaths;
+    m_slots.resize(SLOT_COUNT);
+    try {
+        for (Slot& slot : m_slots) {
+            slot.fbo = std::make_unique<QOpenGLFramebufferObject>(THUMB_WIDTH, THUMB_HEIGHT, fboFormat);
+            slot.projectM = std::make_unique<libprojectM::ProjectM>();
+            slot.projectM->SetWindowSize(THUMB_WIDTH, THUMB_HEIGHT);
+            // Thumbnails don't need the full warp mesh
+            slot.projectM->SetMeshSize(ProjectMSettings::MESH_WIDTH / 2, ProjectMSettings::MESH_HEIGHT / 2);
+            slot.projectM->SetTargetFramesPerSecond(ProjectMSettings::FPS_TARGET);
+            slot.projectM->SetTexturePaths(texturePaths);
+            slot.projectM->LoadPresetFile("idle://", false);
+        }
+    } catch (const std::exception& e) {
+        qWarning() << "Preset preview: projectM initialization failed:" << e.what();
+        release();
+        return false;
+    }
+
+    qInfo() << "Preset preview strip:" << SLOT_COUNT << "slots at" << THUMB_WIDTH << "x" << THUMB_HEIGHT
+            << "budget" << m_budgetMs << "ms/frame";
+    return true;
+}
+
+void PresetPreviewStrip::release()
+{
+    m_slots.clear();
+    m_blitter.destroy();
+    m_nextSlot = 0;
+}
+
+void PresetPreviewStrip::setPresets(const std::vector<std::string>& presetFiles)
+{
+    if (m_slots.empty()) {
+        return;
+    }
+    const size_t count = std::min<size_t>(presetFiles.size(), m_slots.size());
+    std::vector<Slot> old = std::move(m_slots);
+    m_slots.clear();
+    m_slots.resize(old.size());
+
+    // Keep instances that are already running a wanted preset, so stepping
+    // forward only costs one new load instead of SLOT_COUNT
+    for (size_t i = 0; i < count; ++i) {
+        auto it = std::find_if(old.begin(), old.end(), [&](const Slot& slot) {
+            return slot.projectM && slot.preset == presetFiles[i];
+        });
+        if (it != old.end()) {
+            m_slots[i] = std::move(*it);
+        }
+    }
+    // Recycle the rest for the new presets (or leave them blank)
+    auto spare = old.begin();
+    for (size_t i = 0; i < m_slots.size(); ++i) {
+        if (m_slots[i].projectM) {
+            continue;
+        }
+        while (!spare->projectM) {
+            ++spare;
+        }
+        m_slots[i] = std::move(*spare);
+        ++spare;
+        Slot& slot = m_slots[i];
+        slot.preset = i < count ? presetFiles[i] : std::string();
+        slot.needsLoad = !slot.preset.empty();
+        slot.loadWaits = 0;
+        slot.hasFrame = false;
+        slot.renderCostMs = 0.0;
+        slot.text.reset();
+        if (slot.needsLoad) {
+            // Read (and inflate, for packs) off the render thread
+            auto text = std::make_shared<PresetText>();
+            slot.text = text;
+            const std::string preset = slot.preset;
+            QThreadPool::globalInstance()->start([text, preset]() {
+                text->data = PresetPack::readPreset(preset);
+                text->ready.store(true, std::memory_order_release);
+            });
+        }
+    }
+    m_nextSlot = 0;
+}
+
+void PresetPreviewStrip::addPcm(const float* stereo, size_t frames)
+{
+    AllocationCounter::ExternalScope projectM;
+    for (Slot& slot : m_slots) {
+        if (!slot.preset.empty()) {
+            slot.projectM->PCM().Add(stereo, 2, frames);
+        }
+    }
+}
+
+void PresetPreviewStrip::flushTextures()
+{
+    AllocationCounter::ExternalScope projectM;
+    for (Slot& slot : m_slots) {
+        slot.projectM->SetTexturePaths(m_texturePaths);
+    }
+}
+
+void PresetPreviewStrip::addLoadSample(double ms)
+{
+    // Up at once, down only as smoothed samples come in: an estimate that
+    // lags a heavy load would let the next one overrun the frame
+    m_loadEstimateMs = m_loadEstimateMs < 0.0
+        ? ms
+        : std::max(ms, m_loadEstimateMs + COST_SMOOTHING * (ms - m_loadEstimateMs));
+}
+
+// Applies the next slot's preset if its text is ready and the expected load
+// cost fits allowanceMs. True if a load ran (successfully or not).
+bool PresetPreviewStrip::loadOne(double allowanceMs)
+{
+    for (size_t turn = 0; turn < m_slots.size(); ++turn) {
+        Slot& slot = m_slots[(m_nextSlot + turn) % m_slots.size()];
+        if (!slot.needsLoad || !slot.text || !slot.text->ready.load(std::memory_order_acquire)) {
+            continue;
+        }
+        if (m_loadEstimateMs < 0.0 || m_loadEstimateMs > allowanceMs) {
+            m_stats.deferredLoads++;
+            if (++slot.loadWaits >= MAX_LOAD_WAITS) {
+                slot.preset.clear();
+                slot.needsLoad = false;
+                slot.hasFrame = false;
+                slot.text.reset();
+                m_stats.droppedLoads++;
+            }
+            return false;
+        }
+
+        QElapsedTimer loadTimer;
+        loadTimer.start();
+        try {
+            AllocationCounter::ExternalScope projectM;
+            if (slot.text->data.isEmpty()) {
+                throw std::runtime_error("preset could not be read");
+            }
+            // without this the slot's cache would collect every preset it ever showed
+            slot.projectM->SetTexturePaths(m_texturePaths);
+            std::istringstream stream(slot.text->data.toStdString());
+            slot.projectM->LoadPresetData(stream, false);
+        } catch (const std::exception& e) {
+            qWarning() << "Preset preview failed for" << QString::fromStdString(slot.preset) << "-" << e.what();
+            slot.preset.clear();
+            slot.hasFrame = false;
+        }
+        slot.needsLoad = false;
+        slot.text.reset();
+
+        const double loadMs = loadTimer.nsecsElapsed() / 1e6;
+        m_stats.avgLoadMs = m_stats.loads == 0 ? loadMs
+                                               : m_stats.avgLoadMs + COST_SMOOTHING * (loadMs - m_stats.avgLoadMs);
+        m_stats.loads++;
+        addLoadSample(loadMs);
+        return true;
+    }
+    return false;
+}
+
+void PresetPreviewStrip::renderWithinBudget(double headroomMs)
+{
+    if (m_slots.empty()) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    int renders = 0;
+
+    // A load has used this frame's allowance; the slot renders next time round
+    const bool loaded = loadOne(std::max(m_budgetMs, headroomMs));
+
+    for (size_t turn = 0; !loaded && turn < m_slots.size(); ++turn) {
+        Slot& slot = m_slots[m_nextSlot];
+        if (slot.preset.empty() || slot.needsLoad) {
+            m_nextSlot = (m_nextSlot + 1) % m_slots.size();
+            continue;
+        }
+
+        const double spentMs = timer.nsecsElapsed() / 1e6;
+        if (spentMs + slot.renderCostMs > m_budgetMs) {
+            m_stats.deferredSlots++;
+            break;
+        }
+
+        QElapsedTimer slotTimer;
+        slotTimer.start();
+        try {
+            AllocationCounter::ExternalScope projectM;
+            slot.fbo->bind();
+            glViewport(0, 0, THUMB_WIDTH, THUMB_HEIGHT);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            slot.projectM->RenderFrame(slot.fbo->handle());
+            // Finish here so the measured cost is the GPU cost, not just submission
+            glFinish();
+        } catch (const std::exception& e) {
+            qWarning() << "Preset preview failed for" << QString::fromStdString(slot.preset) << "-" << e.what();
+            slot.preset.clear();
+            slot.hasFrame = false;
+            m_nextSlot = (m_nextSlot + 1) % m_slots.size();
+            continue;
+        }
+
+        const double renderMs = slotTimer.nsecsElapsed() / 1e6;
+        slot.renderCostMs = slot.hasFrame ? slot.renderCostMs + COST_SMOOTHING * (renderMs - slot.renderCostMs)
+                                          : renderMs;
+        slot.hasFrame = true;
+        renders++;
+        m_nextSlot = (m_nextSlot + 1) % m_slots.size();
+    }
+
+    QOpenGLFramebufferObject::bindDefault();
+
+    const double frameMs = timer.nsecsElapsed() / 1e6;
+    m_stats.lastFrameMs = frameMs;
+    m_stats.avgFrameMs += COST_SMOOTHING * (frameMs - m_stats.avgFrameMs);
+    m_stats.maxFrameMs = std::max(m_stats.maxFrameMs, frameMs);
+    m_stats.rendersLastFrame = renders;
+    m_stats.totalRenders += renders;
+}
+
+void PresetPreviewStrip::draw(int viewportWidth, int viewportHeight)
+{
+    if (m_slots.empty()) {
+        return;
+    }
+
+    // Shrink the thumbnails if the window is too narrow for all of them
+    const int slots = static_cast<int>(m_slots.size());
+    const int width = std::min(THUMB_WIDTH, (viewportWidth - STRIP_MARGIN * (slots + 1)) / slots);
+    if (width <= 0) {
+        return;
+    }
+    const int height = width * THUMB_HEIGHT / THUMB_WIDTH;
+    const QRect viewport(0, 0, viewportWidth, viewportHeight);
+
+    glViewport(0, 0, viewportWidth, viewportHeight);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+
+    AllocationCounter::ExternalScope blitter;
+    m_blitter.bind();
+    for (int i = 0; i < slots; ++i) {
+        const Slot& slot = m_slots[i];
+        if (!slot.hasFrame) {
+            continue;
+        }
+        const QRect target(STRIP_MARGIN + i * (width + STRIP_MARGIN), viewportHeight - STRIP_MARGIN - height,
+                           width, height);
+        m_blitter.blit(slot.fbo->texture(), QOpenGLTextureBlitter::targetTransform(target, viewport),
+                       QOpenGLTextureBlitter::OriginBottomLeft);
+    }
+    m_blitter.release();
+
+    // back to what ProjectMWindow::initialize() set up
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+}
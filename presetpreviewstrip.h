@@ -0,0 +1,113 @@
+#ifndef PRESETPREVIEWSTRIP_H
+#define PRESETPREVIEWSTRIP_H
+
+#include <QByteArray>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <QOpenGLTextureBlitter>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+// projectM classes
+namespace libprojectM {
+    class ProjectM;
+}
+
+// Live thumbnails of the upcoming presets, drawn as a strip along the bottom
+// of the main output. Each slot is its own small projectM instance rendering
+// into an FBO on the main context and fed the same PCM as the main instance.
+// Slots are rendered round-robin, and only while the estimated cost still
+// fits the per-frame budget, so the main output's frame rate is unaffected.
+// Preset loads can't be split, so their text is read on the thread pool and
+// at most one is applied per frame, only when its expected cost fits the
+// frame's spare time. The expected cost comes from measured loads (the
+// strip's own and the main instance's); none run before there is one, and a
+// preset that keeps not fitting is dropped from the strip rather than loaded.
+// All methods except addPcm() and stats() need the main context current.
+class PresetPreviewStrip : protected QOpenGLFunctions
+{
+public:
+    struct Stats {
+        double lastFrameMs = 0.0;     // preview work done in the last frame
+        double avgFrameMs = 0.0;      // exponential moving average
+        double maxFrameMs = 0.0;
+        int rendersLastFrame = 0;
+        qint64 totalRenders = 0;
+        qint64 deferredSlots = 0;     // slot turns skipped because they didn't fit the budget
+        qint64 loads = 0;
+        qint64 deferredLoads = 0;     // frames a ready load waited because it didn't fit
+        qint64 droppedLoads = 0;      // presets left blank because their load never fit
+        double avgLoadMs = 0.0;       // preset loads can't be split, so they're reported separately
+    };
+
+    static constexpr int SLOT_COUNT = 4;
+    static constexpr int THUMB_WIDTH = 160;
+    static constexpr int THUMB_HEIGHT = 120;
+
+    PresetPreviewStrip();
+    ~PresetPreviewStrip();
+
+    bool initialize(const std::vector<std::string>& texturePaths);
+    void release();
+    bool isInitialized() const { return !m_slots.empty(); }
+
+    void setBudgetMs(double ms) { m_budgetMs = ms; }
+    double budgetMs() const { return m_budgetMs; }
+
+    // A preset load measured elsewhere (the main instance) for the load
+    // estimate; kept across release() so a re-enabled strip starts measured.
+    void addLoadSample(double ms);
+
+    // The presets to preview, in order; only the first SLOT_COUNT are used.
+    // Slots already showing one of them keep running instead of reloading.
+    void setPresets(const std::vector<std::string>& presetFiles);
+
+    void addPcm(const float* stereo, size_t frames);
+
+    // Drops each slot's cached textures the way the main instance does when
+    // the residency manager evicts (SetTexturePaths rebuilds the cache).
+    // Slots also drop theirs before each load, so one holds at most its
+    // current preset's textures.
+    void flushTextures();
+
+    // Renders as many slots as fit in the budget, starting where the last
+    // frame stopped; a pending preset load may instead use up to headroomMs,
+    // the time the caller's frame has left. Leaves the default framebuffer bound.
+    void renderWithinBudget(double headroomMs = 0.0);
+
+    // Composites the thumbnails into the bottom of the current framebuffer.
+    void draw(int viewportWidth, int viewportHeight);
+
+    const Stats& stats() const { return m_stats; }
+
+private:
+    struct PresetText {
+        std::atomic<bool> ready{false};
+        QByteArray data;             // written once by the reader before `ready`
+    };
+
+    struct Slot {
+        std::unique_ptr<libprojectM::ProjectM> projectM;
+        std::unique_ptr<QOpenGLFramebufferObject> fbo;
+        std::string preset;
+        std::shared_ptr<PresetText> text;
+        bool needsLoad = false;
+        int loadWaits = 0;           // frames the ready load has waited for headroom
+        bool hasFrame = false;
+        double renderCostMs = 0.0;   // moving average of one render of this slot
+    };
+
+    bool loadOne(double allowanceMs);
+
+    std::vector<Slot> m_slots;
+    std::vector<std::string> m_texturePaths;
+    QOpenGLTextureBlitter m_blitter;
+    int m_nextSlot = 0;
+    double m_budgetMs = 2.0;
+    double m_loadEstimateMs = -1.0;  // expected cost of the next load; < 0 until one is measured
+    Stats m_stats;
+};
+
+#endif // PRESETPREVIEWSTRIP_H
@@ -0,0 +1,17 @@
+#ifndef PROJECTMSETTINGS_H
+#define PROJECTMSETTINGS_H
+
+// Settings shared by the on-screen visualizer and the offscreen renderers,
+// so a replay or batch render drives projectM exactly like the live window.
+namespace ProjectMSettings {
+
+constexpr int FPS_TARGET = 60;
+constexpr int AUDIO_FRAMES_PER_CHUNK = 1024;   // PCM frames fed per rendered frame
+constexpr int MESH_WIDTH = 32;
+constexpr int MESH_HEIGHT = 24;
+constexpr double PRESET_DURATION = 30.0;       // seconds
+constexpr double HARD_CUT_DURATION = 15.0;     // seconds
+
+}
+
+#endif // PROJECTMSETTINGS_H
@@ -1,4 +1,9 @@
 #include "projectmwindow.h"
+#include "projectmsettings.h"
+#include "allocationcounter.h"
+#include "logging.h"
+#include "presetcostanalyzer.h"
+#include "presetpack.h"
 
 #include <ProjectM.hpp>
 #include <Audio/PCM.hpp>
@@ -23,18 +28,33 @@
 #include <filesystem>
 #include <iostream>
 #include <algorithm>
+#include <limits>
 #include <cstring>
 #include <QDir>
 #include <QCoreApplication>
 #include <random>
 
 // Constants
-const int FPS_TARGET = 60;
-const int AUDIO_FRAMES_PER_CHUNK = 1024;
+const int FPS_TARGET = ProjectMSettings::FPS_TARGET;
+const int IDLE_FPS = 5;                     // LowRate power state
+const float SILENCE_THRESHOLD = 0.001f;     // -60 dBFS peak
+const int SILENCE_HOLD_MS = 2000;           // silence must last this long before slowing down
+const int ACTIVITY_HOLD_MS = 5000;          // full rate after a key press
+const int AUDIO_FRAMES_PER_CHUNK = ProjectMSettings::AUDIO_FRAMES_PER_CHUNK;
 const int PCM_BUFFER_SIZE = AUDIO_FRAMES_PER_CHUNK;
+const double PREVIEW_BUDGET_MS = 2.0;       // preview strip work per frame, on top of the main render
+const double PREVIEW_FRAME_MARGIN_MS = 3.0; // kept free of preview loads for compositing and swap
+const int PROJECTM_BUFFERS = 3;             // full-size RGBA8 buffers projectM keeps: this and last frame, blur chain (roughly)
+const qint64 PREVIEW_BYTES = qint64(PresetPreviewStrip::SLOT_COUNT) * PresetPreviewStrip::THUMB_WIDTH *
+                             PresetPreviewStrip::THUMB_HEIGHT * 4 * (1 + PROJECTM_BUFFERS);
+const size_t FRAME_ARENA_BYTES = 16 * 1024; // per-frame scratch; see the peak in the FPS log
+const size_t POWER_SUMMARY_BYTES = 128;
+const int ALLOCATION_CHECK_WARMUP = 120;    // frames before --alloc-check starts counting
+const int ALLOCATION_CHECK_SLACK_MS = 15000; // start-up allowance on top of the frames at the idle rate
 
 ProjectMWindow::ProjectMWindow(QWindow *parent)
     : QWindow(parent),
+      m_frameArena(FRAME_ARENA_BYTES),
       m_dummyPcmData(PCM_BUFFER_SIZE * 2),
       m_pcmCounter(0)
 {
@@ -82,6 +102,9 @@ ProjectMWindow::ProjectMWindow(QWindow *parent)
             this, &ProjectMWindow::handleMediaStatusChanged);
     connect(m_mediaPlayer, &QMediaPlayer::errorOccurred,
             this, &ProjectMWindow::handleMediaError);
+    // play/pause/stop from PlayerController changes how fast we need to render
+    connect(m_mediaPlayer, &QMediaPlayer::playbackStateChanged,
+            this, &ProjectMWindow::updatePowerState);
             
     // Connect render timer
     connect(&m_renderTimer, &QTimer::timeout, this, &ProjectMWindow::render);
@@ -89,8 +112,13 @@ ProjectMWindow::ProjectMWindow(QWindow *parent)
     // Connect preset timer
     connect(&m_presetTimer, &QTimer::timeout, this, &ProjectMWindow::nextPreset);
 
+    connect(&m_libraryWatcher, &PresetLibraryWatcher::libraryChanged,
+            this, &ProjectMWindow::applyLibraryUpdate);
+
     // FPS calculation
     m_fpsTimer.invalidate();
+    m_silentSince.invalidate();
+    m_lastActivity.invalidate();
 
     // base path
     std::string basePath = QCoreApplication::applicationDirPath().toStdString() + "/../presets/";
@@ -98,7 +126,7 @@ ProjectMWindow::ProjectMWindow(QWindow *parent)
     // presets path
     m_presetPath = basePath;
     
-    qInfo() << "Using preset path:" << QString::fromStdString(m_presetPath);
+    MVLOG(Info, Presets, "Using preset path: %s", m_presetPath.c_str());
     
     m_texturePaths.clear();
     
@@ -109,42 +137,47 @@ ProjectMWindow::ProjectMWindow(QWindow *parent)
     
     // log texture paths for debugging
     for (const auto& path : m_texturePaths) {
-        qInfo() << "Texture search path:" << QString::fromStdString(path);
+        MVLOG(Info, Textures, "Texture search path: %s", path.c_str());
         
         // does it even exist?
         std::filesystem::path texturePath(path);
         if (!std::filesystem::exists(texturePath)) {
-            qWarning() << "  - WARNING: This texture path does not exist!";
+            MVLOG(Warning, Textures, "  - This texture path does not exist!");
         } else if (!std::filesystem::is_directory(texturePath)) {
-            qWarning() << "  - WARNING: This texture path is not a directory!";
+            MVLOG(Warning, Textures, "  - This texture path is not a directory!");
         } else {
-            qInfo() << "  - Path exists and is a directory.";
+            MVLOG(Debug, Textures, "  - Path exists and is a directory.");
             
             // If it does what is in there?
             int count = 0;
             try {
                 for (const auto& entry : std::filesystem::directory_iterator(texturePath)) {
                     if (entry.is_regular_file()) {
-                        qInfo() << "    Found texture:" << QString::fromStdString(entry.path().filename().string());
+                        MVLOG(Debug, Textures, "    Found texture: %s", entry.path().filename().string().c_str());
                         if (++count >= 3) {
-                            qInfo() << "    (and more...)";
+                            MVLOG(Debug, Textures, "    (and more...)");
                             break;
                         }
                     }
                 }
                 if (count == 0) {
-                    qWarning() << "  - WARNING: No texture files found in directory!";
+                    MVLOG(Warning, Textures, "  - No texture files found in directory!");
                 }
             } catch (const std::exception& e) {
-                qWarning() << "  - WARNING: Error listing directory:" << e.what();
+                MVLOG(Warning, Textures, "  - Error listing directory: %s", e.what());
             }
         }
     }
     
+    m_residency.setTexturePaths(m_texturePaths);
     m_texturesSetup = true;
 }
 
 ProjectMWindow::~ProjectMWindow() {
+    qInfo() << "Render time by power state:" << m_powerTracker.summary();
+    qInfo() << "GPU residency:" << m_residency.summary();
+    qInfo() << "Window resizes:" << m_resize.summary();
+    m_recorder.stop(m_totalFrames);
     cleanup();
     
     // Clean up audio resources
@@ -182,24 +215,29 @@ void ProjectMWindow::exposeEvent(QExposeEvent *event) {
         
         render();
     }
+
+    // minimized / occluded / hidden windows stop rendering entirely
+    updatePowerState();
 }
 
 void ProjectMWindow::resizeEvent(QResizeEvent *event) {
-    m_width = event->size().width();
-    m_height = event->size().height();
-    
-    if (m_projectM && m_initialized) {
-        if (m_context && m_context->makeCurrent(this)) {
-            qInfo() << "Resizing projectM to" << m_width << "x" << m_height;
-            m_projectM->SetWindowSize(m_width, m_height);
-            m_context->doneCurrent();
-        }
+    const QSize size = event->size();
+    m_recorder.recordResize(m_totalFrames, size.width(), size.height());
+
+    // Dragging fires these much faster than we render; render() applies the last one
+    m_resize.request(size.width(), size.height());
+    if (m_initialized) {
+        requestUpdate();
     }
     
     QWindow::resizeEvent(event);
 }
 
 void ProjectMWindow::keyPressEvent(QKeyEvent* event) {
+    m_recorder.recordKey(m_totalFrames, event->key(), event->text());
+    m_lastActivity.start();
+    updatePowerState();
+
     switch (event->key()) {
         case Qt::Key_Right:
         case Qt::Key_N:
@@ -210,6 +248,10 @@ void ProjectMWindow::keyPressEvent(QKeyEvent* event) {
         case Qt::Key_P:
             previousPreset();
             break;
+
+        case Qt::Key_V:
+            setPreviewEnabled(!m_previewEnabled);
+            break;
             
         default:
             QWindow::keyPressEvent(event);
@@ -244,6 +286,7 @@ void ProjectMWindow::initialize() {
     
     m_width = width();
     m_height = height();
+    m_resize.reset(m_width, m_height);
     qInfo() << "Initializing projectM (Composition)...";
 
     // preset path valid???
@@ -253,9 +296,11 @@ void ProjectMWindow::initialize() {
         return;
     }
     
-    // do they exist?
+    // do they exist? (a preset pack stands in for the whole tree)
     std::filesystem::path presetDir(m_presetPath);
-    if (!std::filesystem::exists(presetDir)) {
+    if (!m_presetPackPath.isEmpty()) {
+        qInfo() << "Using preset pack:" << m_presetPackPath;
+    } else if (!std::filesystem::exists(presetDir)) {
         qCritical() << "Preset directory does not exist:" << QString::fromStdString(m_presetPath);
         m_context->doneCurrent();
         return;
@@ -291,20 +336,21 @@ void ProjectMWindow::initialize() {
         qInfo() << "Setting window size:" << m_width << "x" << m_height;
         m_projectM->SetWindowSize(m_width, m_height);
         
-        qInfo() << "Setting mesh size: 32x24";
-        m_projectM->SetMeshSize(32, 24);
+        qInfo() << "Setting mesh size:" << ProjectMSettings::MESH_WIDTH << "x" << ProjectMSettings::MESH_HEIGHT;
+        m_projectM->SetMeshSize(ProjectMSettings::MESH_WIDTH, ProjectMSettings::MESH_HEIGHT);
         
         qInfo() << "Setting preset duration:" << m_presetDuration << "seconds";
         m_projectM->SetPresetDuration(m_presetDuration);
         
-        qInfo() << "Setting hard cut duration: 15.0 seconds";
-        m_projectM->SetHardCutDuration(15.0);
+        qInfo() << "Setting hard cut duration:" << ProjectMSettings::HARD_CUT_DURATION << "seconds";
+        m_projectM->SetHardCutDuration(ProjectMSettings::HARD_CUT_DURATION);
         
         qInfo() << "Setting target FPS:" << FPS_TARGET;
         m_projectM->SetTargetFramesPerSecond(FPS_TARGET);
 
         qInfo() << "Setting texture paths in ProjectM...";
         m_projectM->SetTexturePaths(m_texturePaths);
+        updateMainRenderTarget();
         
         qInfo() << "Getting PCM object...";
         m_projectMPcm = &m_projectM->PCM();
@@ -314,10 +360,22 @@ void ProjectMWindow::initialize() {
         }
 
         loadAvailablePresets();
+        if (m_presetPackPath.isEmpty()) {
+            // a pack doesn't change under us; rebuild it to pick up new presets
+            QStringList textureRoots;
+            for (const auto& path : m_texturePaths) {
+                textureRoots << QString::fromStdString(std::filesystem::path(path).lexically_normal().string());
+            }
+            const std::filesystem::path presetRoot = std::filesystem::path(m_presetPath).lexically_normal();
+            m_libraryWatcher.start(QString::fromStdString(presetRoot.string()), textureRoots);
+        }
+        m_recorder.recordSession(m_audioFilePath, m_presetSeed, m_presetPath, m_texturePaths, m_width, m_height);
 
         if (!m_presetFiles.empty()) {
             qInfo() << "Loading initial preset:" << QString::fromStdString(m_presetFiles[0]);
-            m_projectM->LoadPresetFile(m_presetFiles[0], false);
+            m_currentPresetIndex = 0;
+            loadCurrentPreset();
+            m_recorder.recordPreset(m_totalFrames, 0, m_presetFiles[0]);
             
             // preset timer for automatic cycling
             m_presetTimer.start(m_presetDuration * 1000);
@@ -362,6 +420,7 @@ void ProjectMWindow::initialize() {
 
 void ProjectMWindow::cleanup() {
     if (m_context && m_context->makeCurrent(this)) {
+        m_previewStrip.release();
         m_projectM.reset();
         m_projectMPcm = nullptr;
         m_context->doneCurrent();
@@ -374,9 +433,30 @@ void ProjectMWindow::render() {
     }
     
     if (!m_context->makeCurrent(this)) {
-        qWarning() << "Failed to make OpenGL context current for rendering!";
+        MVLOG_EVERY_MS(1000, Warning, Render, "Failed to make OpenGL context current for rendering!");
         return;
     }
+
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+
+    // Everything from here to the end of the frame is meant to stay off the
+    // heap once running: transient data goes in the arena, third-party calls
+    // are counted separately as external
+    m_frameArena.reset();
+    const AllocationCounter::Counts frameStart = AllocationCounter::thisThread();
+    bool steadyState = true;
+
+    int resizedWidth = 0;
+    int resizedHeight = 0;
+    if (m_resize.take(&resizedWidth, &resizedHeight)) {
+        steadyState = false;
+        m_width = resizedWidth;
+        m_height = resizedHeight;
+        m_projectM->SetWindowSize(m_width, m_height);
+        updateMainRenderTarget();
+        MVLOG(Debug, Render, "Resized projectM to %dx%d", m_width, m_height);
+    }
     
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -385,19 +465,47 @@ void ProjectMWindow::render() {
     processAudioChunk();
 
     try {
-        m_projectM->RenderFrame();
+        {
+            AllocationCounter::ExternalScope projectM;
+            m_projectM->RenderFrame();
+        }
+        m_totalFrames++;
+
+        if (m_previewEnabled) {
+            if (!m_previewStrip.isInitialized()) {
+                steadyState = false;
+                QElapsedTimer initTimer;
+                initTimer.start();
+                m_previewStrip.setBudgetMs(PREVIEW_BUDGET_MS);
+                if (!m_previewStrip.initialize(m_texturePaths)) {
+                    m_previewEnabled = false;
+                } else {
+                    // Evictable once switched off; coming back counts as a reload
+                    m_residency.addRenderTarget("preview", PREVIEW_BYTES, [this]() { m_previewStrip.release(); },
+                                                initTimer.nsecsElapsed() / 1e6);
+                    m_residency.setPinned("preview", true);
+                }
+                updatePreviewPresets();
+            }
+            // what's left of this frame's period, for a preview preset load
+            const double periodMs = 1000.0 / (m_powerTracker.state() == PowerState::LowRate ? IDLE_FPS : FPS_TARGET);
+            m_previewStrip.renderWithinBudget(periodMs - PREVIEW_FRAME_MARGIN_MS - frameTimer.nsecsElapsed() / 1e6);
+            m_previewStrip.draw(m_width, m_height);
+        }
         
         // Ensure OpenGL commands are executed
-        glFlush();
-        glFinish();
+        {
+            AllocationCounter::ExternalScope driver;
+            glFlush();
+            glFinish();
+        }
         
-        // did you actually draw anything?
-        GLubyte pixel[4];
-        glReadPixels(width()/2, height()/2, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
-        if (m_frameCount % 60 == 0) {
-            qInfo() << "Center pixel color (RGBA):" 
-                    << (int)pixel[0] << (int)pixel[1] 
-                    << (int)pixel[2] << (int)pixel[3];
+        // did you actually draw anything? (the readback stalls, so only when render debug is on)
+        if (m_frameCount % 60 == 0 && Log::enabled(Log::Category::Render, Log::Level::Debug)) {
+            GLubyte pixel[4];
+            glReadPixels(width()/2, height()/2, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+            MVLOG(Debug, Render, "Center pixel color (RGBA): %d %d %d %d",
+                  pixel[0], pixel[1], pixel[2], pixel[3]);
         }
 
         m_frameCount++;
@@ -406,42 +514,202 @@ void ProjectMWindow::render() {
                 qint64 elapsed = m_fpsTimer.elapsed();
                 if (elapsed > 0) {
                     double fps = m_frameCount * 1000.0 / elapsed;
-                    qInfo() << "FPS:" << fps;
+                    MVLOG(Info, Render, "FPS: %.1f", fps);
+                    if (AllocationCounter::enabled()) {
+                        MVLOG(Info, Render, "Allocations per frame: %.2f own (%.0f bytes), %.2f external; "
+                              "frame arena peak %zu of %zu bytes, %llu overflows",
+                              double(m_windowAllocations.allocations) / m_frameCount,
+                              double(m_windowAllocations.bytes) / m_frameCount,
+                              double(m_windowAllocations.external) / m_frameCount, m_frameArena.peak(),
+                              m_frameArena.capacity(), static_cast<unsigned long long>(m_frameArena.overflows()));
+                        char threads[512];
+                        AllocationCounter::formatThreads(threads, sizeof(threads));
+                        MVLOG(Debug, Render, "Allocations by thread: %s", threads);
+                    }
+                    if (m_previewEnabled) {
+                        const PresetPreviewStrip::Stats& stats = m_previewStrip.stats();
+                        MVLOG(Info, Render, "Preview strip: avg %.2f ms max %.2f ms per frame (budget %.1f ms), "
+                              "%lld renders, %lld deferred, %lld loads avg %.1f ms (%lld frames waited for headroom, "
+                              "%lld dropped)",
+                              stats.avgFrameMs, stats.maxFrameMs, m_previewStrip.budgetMs(),
+                              static_cast<long long>(stats.totalRenders), static_cast<long long>(stats.deferredSlots),
+                              static_cast<long long>(stats.loads), stats.avgLoadMs,
+                              static_cast<long long>(stats.deferredLoads), static_cast<long long>(stats.droppedLoads));
+                    }
                 }
             }
             m_frameCount = 0;
+            m_windowAllocations = AllocationCounter::Counts();
             m_fpsTimer.restart();
         }
     } catch (const std::exception& e) {
-        qCritical() << "Exception during projectM rendering:" << e.what();
+        MVLOG_EVERY_MS(1000, Critical, Render, "Exception during projectM rendering: %s", e.what());
     } catch (...) {
-        qCritical() << "Unknown exception during projectM rendering";
+        MVLOG_EVERY_MS(1000, Critical, Render, "Unknown exception during projectM rendering");
     }
     
     // Swap buffers
-    m_context->swapBuffers(this);
+    {
+        AllocationCounter::ExternalScope qt;
+        m_context->swapBuffers(this);
+    }
     
-    // update plssss
-    requestUpdate();
+    updatePowerState();
+
+    // update plssss (only at full rate; LowRate is paced by m_renderTimer alone)
+    if (m_powerTracker.state() == PowerState::Active) {
+        AllocationCounter::ExternalScope qt;
+        requestUpdate();
+    }
+
+    const AllocationCounter::Counts frameEnd = AllocationCounter::thisThread();
+    AllocationCounter::Counts frame;
+    frame.allocations = frameEnd.allocations - frameStart.allocations;
+    frame.bytes = frameEnd.bytes - frameStart.bytes;
+    frame.external = frameEnd.external - frameStart.external;
+    frame.externalBytes = frameEnd.externalBytes - frameStart.externalBytes;
+    m_windowAllocations.allocations += frame.allocations;
+    m_windowAllocations.bytes += frame.bytes;
+    m_windowAllocations.external += frame.external;
+    m_windowAllocations.externalBytes += frame.externalBytes;
+    if (m_allocationCheck.remaining > 0) {
+        checkFrameAllocations(frame, steadyState);
+    }
+}
+
+void ProjectMWindow::startAllocationCheck(int frames) {
+    m_allocationCheck = AllocationCheck();
+    m_allocationCheck.warmup = ALLOCATION_CHECK_WARMUP;
+    m_allocationCheck.remaining = std::max(frames, 1);
+    qInfo() << "Allocation check: skipping" << ALLOCATION_CHECK_WARMUP << "warm-up frames, then checking"
+            << m_allocationCheck.remaining << "frames.";
+
+    // A headless run without a usable GL context never renders; fail it
+    // instead of waiting forever. Frames come at least at the idle rate.
+    const qint64 deadlineMs = (qint64(ALLOCATION_CHECK_WARMUP) + m_allocationCheck.remaining) * 1000 / IDLE_FPS +
+                              ALLOCATION_CHECK_SLACK_MS;
+    QTimer::singleShot(static_cast<int>(std::min<qint64>(deadlineMs, std::numeric_limits<int>::max())), this, [this]() {
+        if (m_allocationCheck.remaining > 0) {
+            qCritical() << "Allocation check FAILED: only" << m_allocationCheck.checked
+                        << "frames were checked before the deadline (is OpenGL available?)";
+            QCoreApplication::exit(1);
+        }
+    });
+}
+
+// --alloc-check: after warm-up, every steady-state frame must get through
+// without a heap allocation of our own. Exits the app with the verdict.
+void ProjectMWindow::checkFrameAllocations(const AllocationCounter::Counts& frame, bool steadyState) {
+    AllocationCheck& check = m_allocationCheck;
+    if (check.warmup > 0) {
+        check.warmup--;
+        return;
+    }
+    if (!steadyState) {
+        // resizes and first-time setup are allowed to allocate
+        return;
+    }
+    check.checked++;
+    check.external += frame.external;
+    if (frame.allocations > 0) {
+        check.allocatingFrames++;
+        if (frame.allocations > check.worst) {
+            check.worst = frame.allocations;
+            check.worstFrame = m_totalFrames;
+        }
+        MVLOG_EVERY_MS(1000, Warning, Render, "Frame %lld allocated %llu times (%llu bytes)",
+                       static_cast<long long>(m_totalFrames), static_cast<unsigned long long>(frame.allocations),
+                       static_cast<unsigned long long>(frame.bytes));
+    }
+    if (--check.remaining > 0) {
+        return;
+    }
+
+    const bool passed = check.allocatingFrames == 0;
+    char threads[512];
+    AllocationCounter::formatThreads(threads, sizeof(threads));
+    qInfo().noquote() << QString("Allocation check %1: %2 of %3 frames allocated (worst %4 at frame %5); "
+                                 "%6 external allocations per frame from projectM/Qt/driver")
+                             .arg(passed ? "passed" : "FAILED")
+                             .arg(check.allocatingFrames)
+                             .arg(check.checked)
+                             .arg(check.worst)
+                             .arg(check.worstFrame)
+                             .arg(check.checked > 0 ? double(check.external) / check.checked : 0.0, 0, 'f', 1);
+    qInfo() << "Allocations by thread:" << threads;
+    QCoreApplication::exit(passed ? 0 : 1);
+}
+
+void ProjectMWindow::updatePowerState() {
+    if (!m_initialized) {
+        return;
+    }
+
+    if (!isExposed()) {
+        setPowerState(PowerState::Suspended, "window not exposed");
+    } else if (m_lastActivity.isValid() && m_lastActivity.elapsed() < ACTIVITY_HOLD_MS) {
+        setPowerState(PowerState::Active, "user activity");
+    } else if (!m_audioFilePath.isEmpty() && m_mediaPlayer &&
+               m_mediaPlayer->error() == QMediaPlayer::NoError &&
+               m_mediaPlayer->playbackState() != QMediaPlayer::PlayingState) {
+        setPowerState(PowerState::LowRate, "playback paused or stopped");
+    } else if (m_silentSince.isValid() && m_silentSince.elapsed() >= SILENCE_HOLD_MS) {
+        setPowerState(PowerState::LowRate, "audio silent");
+    } else {
+        setPowerState(PowerState::Active, "audio playing");
+    }
+}
+
+void ProjectMWindow::setPowerState(PowerState state, const char* reason) {
+    if (state == m_powerTracker.state()) {
+        return;
+    }
+    const PowerState previous = m_powerTracker.state();
+    m_powerTracker.transition(state);
+    // Called from inside render(), so the summary goes in the frame arena rather than a QString
+    char* summary = m_frameArena.allocateArray<char>(POWER_SUMMARY_BYTES);
+    if (summary) {
+        m_powerTracker.formatSummary(summary, POWER_SUMMARY_BYTES);
+    }
+    MVLOG(Info, Power, "Render power state: %s -> %s (%s) | %s", PowerStateTracker::name(previous),
+          PowerStateTracker::name(state), reason, summary ? summary : "");
+
+    AllocationCounter::ExternalScope qt;
+    switch (state) {
+        case PowerState::Active:
+            m_renderTimer.start(1000 / FPS_TARGET);
+            // resume right away instead of waiting for the next tick
+            m_fpsTimer.restart();
+            m_frameCount = 0;
+            m_windowAllocations = AllocationCounter::Counts();
+            requestUpdate();
+            break;
+        case PowerState::LowRate:
+            m_renderTimer.start(1000 / IDLE_FPS);
+            break;
+        case PowerState::Suspended:
+            m_renderTimer.stop();
+            break;
+    }
 }
 
 // Media player status handler
 void ProjectMWindow::handleMediaStatusChanged(QMediaPlayer::MediaStatus status) {
-    qInfo() << "Media status changed:" << status;
+    MVLOG(Debug, Media, "Media status changed: %d", static_cast<int>(status));
     switch (status) {
         case QMediaPlayer::LoadedMedia:
             // Media loaded successfully, start playback
-            qInfo() << "Media loaded successfully, starting playback.";
+            MVLOG(Info, Media, "Media loaded successfully, starting playback.");
             m_mediaPlayer->play();
             break;
         case QMediaPlayer::EndOfMedia:
             // loop
-            qInfo() << "End of media reached, looping.";
+            MVLOG(Info, Media, "End of media reached, looping.");
             m_mediaPlayer->setPosition(0);
             m_mediaPlayer->play();
             break;
         case QMediaPlayer::InvalidMedia:
-            qWarning() << "Invalid media file:" << m_audioFilePath;
+            MVLOG(Warning, Media, "Invalid media file: %s", qPrintable(m_audioFilePath));
             break;
         default:
             break;
@@ -459,6 +727,7 @@ void ProjectMWindow::setPresetPath(const std::string& path) {
 
 void ProjectMWindow::setTexturePaths(const std::vector<std::string>& paths) {
     m_texturePaths = paths;
+    m_residency.setTexturePaths(m_texturePaths);
     m_texturesSetup = true;
     if (m_projectM) {
         qInfo() << "Setting texture paths in ProjectM instance.";
@@ -480,6 +749,7 @@ void ProjectMWindow::setAudioFile(const QString& filePath) {
     
     // If window already initialized, close old file and open new one for visualization
     if (m_initialized) {
+         m_recorder.recordAudio(m_totalFrames, m_audioFilePath);
          closeAudioFile();
          if (!m_audioFilePath.isEmpty()) {
              openAudioFile();
@@ -492,120 +762,340 @@ bool ProjectMWindow::openAudioFile() {
         qWarning() << "Audio file path is empty, using dummy audio.";
         return false;
     }
-    closeAudioFile();
-
-    memset(&m_sfInfo, 0, sizeof(m_sfInfo));
-    m_sndFile = sf_open(m_audioFilePath.toStdString().c_str(), SFM_READ, &m_sfInfo);
-
-    if (!m_sndFile) {
-        qCritical() << "Error opening audio file:" << m_audioFilePath
-                    << "- Error:" << sf_strerror(NULL);
-        return false;
-    }
-
-    qInfo() << "Opened audio file:" << m_audioFilePath;
-    qInfo() << "  Frames:" << m_sfInfo.frames << "Samplerate:" << m_sfInfo.samplerate
-            << "Channels:" << m_sfInfo.channels << "Format:" << m_sfInfo.format;
-
-    if (m_sfInfo.channels < 1 || m_sfInfo.channels > 2) {
-         qCritical() << "Error: Only mono or stereo files supported. Channels:" << m_sfInfo.channels;
-         closeAudioFile();
-         return false;
-    }
-
-    m_audioReadBuffer.resize(AUDIO_FRAMES_PER_CHUNK * m_sfInfo.channels);
-    m_dummyPcmData.resize(PCM_BUFFER_SIZE * 2); // make absolutely sure dummy buffer matches PCM_BUFFER_SIZE
-
-    return true;
+    return m_audioReader.open(m_audioFilePath, AUDIO_FRAMES_PER_CHUNK);
 }
 
 void ProjectMWindow::closeAudioFile() {
-    if (m_sndFile) {
-        sf_close(m_sndFile);
-        m_sndFile = nullptr;
-        qInfo() << "Closed audio file.";
-    }
+    m_audioReader.close();
 }
 
 void ProjectMWindow::processAudioChunk() {
     if (!m_projectMPcm) {
-        qWarning() << "ProjectM PCM object is null, cannot process audio.";
+        MVLOG_EVERY_MS(1000, Warning, Audio, "ProjectM PCM object is null, cannot process audio.");
         return;
     }
 
-    if (!m_sndFile) {
+    if (!m_audioReader.isOpen()) {
         // --- Use Dummy Sine Wave Data ---
+        m_silentSince.invalidate();
+        // Generated straight into the stereo float buffer projectM takes, no int16 round trip
         m_pcmCounter++;
-        size_t dummySamplesPerChannel = PCM_BUFFER_SIZE;
-        m_dummyPcmData.resize(dummySamplesPerChannel * 2); // Ensure size before filling
+        const size_t dummySamplesPerChannel = PCM_BUFFER_SIZE;
+        float* out = m_dummyPcmData.data();
         for (size_t i = 0; i < dummySamplesPerChannel; ++i) {
-            float val = std::sin(static_cast<float>(m_pcmCounter * 10 + i) * 0.1f);
-            short pcmValue = static_cast<short>(val * 32760.0f);
-            m_dummyPcmData[i * 2] = pcmValue;
-            m_dummyPcmData[i * 2 + 1] = pcmValue;
+            const float val = std::sin(static_cast<float>(m_pcmCounter * 10 + i) * 0.1f);
+            out[i * 2] = val;
+            out[i * 2 + 1] = val;
         }
-        // Use the int16_t Add overload for dummy data
-        m_projectMPcm->Add(reinterpret_cast<const int16_t*>(m_dummyPcmData.data()), 2, dummySamplesPerChannel);
+        {
+            AllocationCounter::ExternalScope projectM;
+            m_projectMPcm->Add(m_dummyPcmData.data(), 2, dummySamplesPerChannel);
+        }
+        if (m_previewEnabled) {
+            m_previewStrip.addPcm(m_dummyPcmData.data(), dummySamplesPerChannel);
+        }
+        // the sine only keeps the visuals moving; listeners get the silence that is playing
+        m_audioPublisher.publish(nullptr, dummySamplesPerChannel, m_totalFrames);
         return;
     }
 
     // --- Read Real Audio Data ---
-    m_audioReadBuffer.resize(AUDIO_FRAMES_PER_CHUNK * m_sfInfo.channels); // Ensure size before reading
-    sf_count_t framesRead = sf_readf_float(m_sndFile, m_audioReadBuffer.data(), AUDIO_FRAMES_PER_CHUNK);
-
-    if (framesRead > 0) {
-        size_t samples_per_channel = static_cast<size_t>(framesRead);
-        // Feed float data
-        m_projectMPcm->Add(m_audioReadBuffer.data(), m_sfInfo.channels, samples_per_channel);
-        // For debugging: print max amplitude of this chunk
-        if (m_frameCount % 100 == 0) { // Only check occasionally to avoid log spam
-            float maxAmp = 0.0f;
-            for (size_t i = 0; i < framesRead * m_sfInfo.channels; ++i) {
-                maxAmp = std::max(maxAmp, std::abs(m_audioReadBuffer[i]));
-            }
-            qDebug() << "Audio chunk max amplitude:" << maxAmp;
+    // While playback is paused or stopped the listener hears silence, and so
+    // do the visuals; the reader holds its place and is in step on resume.
+    const bool playerUsable = m_mediaPlayer && m_mediaPlayer->error() == QMediaPlayer::NoError;
+    const bool playing = !playerUsable || m_mediaPlayer->playbackState() == QMediaPlayer::PlayingState;
+    if (playing != m_audioPlaying) {
+        m_audioPlaying = playing;
+        m_recorder.recordPlayback(m_totalFrames, playing);
+    }
+    if (!playing) {
+        std::fill(m_dummyPcmData.begin(), m_dummyPcmData.end(), 0.0f);
+        feedAudio(m_dummyPcmData.data(), PCM_BUFFER_SIZE);
+        m_lastAudioChunk.invalidate();
+        return;
+    }
+
+    // At the LowRate tick one chunk covers a fraction of the time since the
+    // last one, so reading on from there would leave silence detection ever
+    // further behind playback. Jump to where the player is (to the real-time
+    // position if it can't play the file), and log it so a replay reads the
+    // same audio.
+    if (m_powerTracker.state() == PowerState::LowRate && m_lastAudioChunk.isValid()) {
+        const double inputRate = m_audioReader.sampleRate();
+        int64_t target = 0;
+        if (playerUsable) {
+            AllocationCounter::ExternalScope qt;
+            target = static_cast<int64_t>(m_mediaPlayer->position() * inputRate / 1000.0);
+        } else {
+            const double chunkInputFrames = double(AUDIO_FRAMES_PER_CHUNK) * inputRate / AudioIngest::kTargetSampleRate;
+            target = m_audioReader.position() +
+                     std::max<int64_t>(0, static_cast<int64_t>(m_lastAudioChunk.nsecsElapsed() * 1e-9 * inputRate - chunkInputFrames));
+        }
+        if (target != m_audioReader.position()) {
+            m_audioReader.seek(target);
+            m_recorder.recordSeek(m_totalFrames, m_audioReader.position());
+        }
+    }
+    m_lastAudioChunk.start();
+    size_t frames = 0;
+    const float* stereo = m_audioReader.readChunk(&frames);
+    if (frames > 0) {
+        feedAudio(stereo, frames);
+    }
+}
+
+// Hands one chunk of stereo float to projectM and tracks silence.
+void ProjectMWindow::feedAudio(const float* stereo, size_t frames) {
+    {
+        AllocationCounter::ExternalScope projectM;
+        m_projectMPcm->Add(stereo, 2, frames);
+    }
+    if (m_previewEnabled) {
+        m_previewStrip.addPcm(stereo, frames);
+    }
+    m_audioPublisher.publish(stereo, frames, m_totalFrames);
+
+    float maxAmp = 0.0f;
+    for (size_t i = 0; i < frames * 2; ++i) {
+        maxAmp = std::max(maxAmp, std::abs(stereo[i]));
+    }
+    // Silence detection for the LowRate power state
+    if (maxAmp < SILENCE_THRESHOLD) {
+        if (!m_silentSince.isValid()) {
+            m_silentSince.start();
         }
     } else {
-        qInfo() << "End of audio file reached or read error.";
-        // loop
-        sf_seek(m_sndFile, 0, SEEK_SET);
+        m_silentSince.invalidate();
     }
+
+    // For debugging: print max amplitude of this chunk
+    MVLOG_EVERY_MS(2000, Debug, Audio, "Audio chunk max amplitude: %f", maxAmp);
 }
 
 // --- New Preset Management Methods ---
 
 void ProjectMWindow::loadAvailablePresets() {
     m_presetFiles.clear();
+    m_presetSet.clear();
     
     try {
-        std::filesystem::path dirPath(m_presetPath);
-        if (std::filesystem::exists(dirPath) && std::filesystem::is_directory(dirPath)) {
+        // normalized so paths match the ones the library watcher reports
+        const std::filesystem::path dirPath = std::filesystem::path(m_presetPath).lexically_normal();
+        if (!m_presetPackPath.isEmpty()) {
+            // the pack's sorted index is the catalog; no directory walk
+            const std::shared_ptr<const PresetPack> pack = PresetPack::shared(m_presetPackPath);
+            const int count = pack ? pack->count() : 0;
+            m_presetFiles.reserve(static_cast<size_t>(count));
+            for (int i = 0; i < count; ++i) {
+                m_presetFiles.push_back(pack->presetPath(i));
+            }
+        } else if (std::filesystem::exists(dirPath) && std::filesystem::is_directory(dirPath)) {
             // find all .milk files need my milk
             for (const auto& entry : std::filesystem::recursive_directory_iterator(dirPath)) {
                 if (entry.is_regular_file() && entry.path().extension() == ".milk") {
                     m_presetFiles.push_back(entry.path().string());
                 }
             }
-            
-            qInfo() << "Found" << m_presetFiles.size() << "preset files";
-            
-            // Random
+        }
+        qInfo() << "Found" << m_presetFiles.size() << "preset files";
+        if (m_skipExpensivePercent > 0.0) {
+            dropExpensivePresets();
+        }
+
+        // Random, but with a known seed so a session can be reproduced
+        if (!m_presetSeedFixed) {
             std::random_device rd;
-            std::mt19937 g(rd());
-            std::shuffle(m_presetFiles.begin(), m_presetFiles.end(), g);
+            m_presetSeed = rd();
         }
+        qInfo() << "Shuffling presets with seed" << m_presetSeed;
+        m_presetRng.seed(m_presetSeed);
+        std::shuffle(m_presetFiles.begin(), m_presetFiles.end(), m_presetRng);
+        m_presetSet.insert(m_presetFiles.begin(), m_presetFiles.end());
     } catch (const std::exception& e) {
         qWarning() << "Error loading presets:" << e.what();
     }
 }
 
+// Static cost estimate of every preset (see PresetCostAnalyzer); the most
+// expensive m_skipExpensivePercent never make it into the catalog. The
+// limit is kept for presets that show up later.
+void ProjectMWindow::dropExpensivePresets() {
+    QElapsedTimer timer;
+    timer.start();
+    const std::vector<PresetCostAnalyzer::Cost> costs = PresetCostAnalyzer::analyzeAll(m_presetFiles);
+    m_presetCostLimit = PresetCostAnalyzer::limitForPercent(costs, m_skipExpensivePercent);
+    if (m_presetCostLimit <= 0.0) {
+        return;
+    }
+    size_t keep = 0;
+    for (size_t i = 0; i < m_presetFiles.size(); ++i) {
+        if (costs[i].valid && costs[i].total > m_presetCostLimit) {
+            continue;
+        }
+        if (keep != i) {
+            m_presetFiles[keep] = std::move(m_presetFiles[i]);
+        }
+        keep++;
+    }
+    const size_t dropped = m_presetFiles.size() - keep;
+    m_presetFiles.resize(keep);
+    qInfo() << "Skipped" << dropped << "presets above estimated cost" << qRound64(m_presetCostLimit)
+            << "(most expensive" << m_skipExpensivePercent << "%), analyzed in" << timer.elapsed() << "ms";
+}
+
+// Patches the catalog with what the library watcher saw, without a rescan.
+// Removals happen in one pass over the list; new presets are shuffled and
+// queued right after the current one so a freshly synced pack shows up soon.
+void ProjectMWindow::applyLibraryUpdate(const PresetLibraryWatcher::Update& update) {
+    QElapsedTimer timer;
+    timer.start();
+
+    std::vector<std::string> written;
+    for (const QString& path : update.written) {
+        written.push_back(path.toStdString());
+    }
+    std::unordered_set<std::string> removed;
+    for (const QString& path : update.removed) {
+        removed.insert(path.toStdString());
+    }
+    std::vector<std::string> removedDirs;
+    for (const QString& dir : update.removedDirs) {
+        removedDirs.push_back(dir.toStdString() + "/");
+    }
+
+    if (update.overflowed) {
+        // Events were lost: reconcile against a fresh walk (still keeps order and position)
+        MVLOG(Warning, Presets, "Preset watcher queue overflowed, reconciling with a full scan");
+        std::unordered_set<std::string> onDisk;
+        try {
+            const std::filesystem::path dirPath = std::filesystem::path(m_presetPath).lexically_normal();
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(dirPath)) {
+                if (entry.is_regular_file() && entry.path().extension() == ".milk") {
+                    onDisk.insert(entry.path().string());
+                }
+            }
+        } catch (const std::exception& e) {
+            MVLOG(Warning, Presets, "Error rescanning presets: %s", e.what());
+        }
+        for (const auto& file : m_presetFiles) {
+            if (!onDisk.count(file)) {
+                removed.insert(file);
+            }
+        }
+        for (const auto& file : onDisk) {
+            if (!m_presetSet.count(file)) {
+                written.push_back(file);
+            }
+        }
+    }
+
+    // --- removals ---
+    auto isRemoved = [&](const std::string& file) {
+        if (removed.count(file)) {
+            return true;
+        }
+        for (const auto& prefix : removedDirs) {
+            if (file.compare(0, prefix.size(), prefix) == 0) {
+                return true;
+            }
+        }
+        return false;
+    };
+    int removedCount = 0;
+    int removedBeforeCurrent = 0;
+    bool currentRemoved = false;
+    size_t keep = 0;
+    for (size_t i = 0; i < m_presetFiles.size(); ++i) {
+        if (isRemoved(m_presetFiles[i])) {
+            m_presetSet.erase(m_presetFiles[i]);
+            removedCount++;
+            if (static_cast<int>(i) < m_currentPresetIndex) {
+                removedBeforeCurrent++;
+            } else if (static_cast<int>(i) == m_currentPresetIndex) {
+                currentRemoved = true;
+            }
+            continue;
+        }
+        if (keep != i) {
+            m_presetFiles[keep] = std::move(m_presetFiles[i]);
+        }
+        keep++;
+    }
+    m_presetFiles.resize(keep);
+    m_currentPresetIndex -= removedBeforeCurrent;
+    if (m_currentPresetIndex >= static_cast<int>(m_presetFiles.size())) {
+        m_currentPresetIndex = 0;
+    }
+
+    // --- additions and in-place edits ---
+    std::vector<std::string> added;
+    int updatedCount = 0;
+    // the preset that moved into the removed one's slot is the current one now
+    bool reloadCurrent = currentRemoved && !m_presetFiles.empty();
+    for (auto& file : written) {
+        if (m_presetSet.count(file)) {
+            updatedCount++;
+            if (!m_presetFiles.empty() && m_presetFiles[m_currentPresetIndex] == file) {
+                reloadCurrent = true;
+            }
+        } else if (m_presetCostLimit > 0.0 && PresetCostAnalyzer::analyzeFile(file).total > m_presetCostLimit) {
+            MVLOG(Info, Presets, "Skipping new preset over the cost limit: %s", file.c_str());
+        } else if (m_presetSet.insert(file).second) {
+            added.push_back(std::move(file));
+        }
+    }
+    if (!added.empty()) {
+        std::shuffle(added.begin(), added.end(), m_presetRng);
+        const size_t insertAt = m_presetFiles.empty() ? 0 : static_cast<size_t>(m_currentPresetIndex) + 1;
+        m_presetFiles.insert(m_presetFiles.begin() + insertAt, added.begin(), added.end());
+    }
+
+    const bool needsContext = reloadCurrent || update.texturesChanged;
+    if (needsContext && m_projectM && m_context && m_context->makeCurrent(this)) {
+        try {
+            if (update.texturesChanged) {
+                m_projectM->SetTexturePaths(m_texturePaths);
+                m_residency.setTexturePaths(m_texturePaths);
+            }
+            if (reloadCurrent) {
+                loadCurrentPreset();
+                if (currentRemoved) {
+                    m_recorder.recordPreset(m_totalFrames, m_currentPresetIndex, m_presetFiles[m_currentPresetIndex]);
+                }
+            }
+        } catch (const std::exception& e) {
+            MVLOG(Warning, Presets, "Error applying library update: %s", e.what());
+        }
+        m_context->doneCurrent();
+    }
+    if (!m_presetTimer.isActive() && !m_presetFiles.empty() && m_projectM) {
+        // first presets ever: start cycling like initialize() would have
+        m_presetTimer.start(m_presetDuration * 1000);
+    }
+    updatePreviewPresets();
+
+    const qint64 applyUs = timer.nsecsElapsed() / 1000;
+    m_libraryStats.updates++;
+    m_libraryStats.lastApplyUs = applyUs;
+    m_libraryStats.maxApplyUs = std::max(m_libraryStats.maxApplyUs, applyUs);
+    m_libraryStats.lastLatencyMs = update.latencyMs + applyUs / 1000;
+    MVLOG(Info, Presets, "Preset library update: +%zu -%d ~%d%s, %zu presets; applied in %lld us "
+          "(new dirs scanned in %lld ms, %lld ms after first event)",
+          added.size(), removedCount, updatedCount, update.texturesChanged ? ", textures rescanned" : "",
+          m_presetFiles.size(), static_cast<long long>(applyUs), static_cast<long long>(update.scanMs),
+          static_cast<long long>(m_libraryStats.lastLatencyMs));
+}
+
 void ProjectMWindow::nextPreset() {
     if (m_presetFiles.empty() || !m_projectM) return;
     
     m_currentPresetIndex = (m_currentPresetIndex + 1) % m_presetFiles.size();
-    QString presetName = QString::fromStdString(m_presetFiles[m_currentPresetIndex]);
-    qInfo() << "Loading next preset:" << presetName;
-    m_projectM->LoadPresetFile(m_presetFiles[m_currentPresetIndex], false);
+    MVLOG(Info, Presets, "Loading next preset: %s", m_presetFiles[m_currentPresetIndex].c_str());
+    if (m_context && m_context->makeCurrent(this)) {
+        loadCurrentPreset();
+        m_context->doneCurrent();
+    }
+    m_recorder.recordPreset(m_totalFrames, m_currentPresetIndex, m_presetFiles[m_currentPresetIndex]);
 }
 
 void ProjectMWindow::previousPreset() {
@@ -615,9 +1105,50 @@ void ProjectMWindow::previousPreset() {
     if (m_currentPresetIndex < 0) 
         m_currentPresetIndex = m_presetFiles.size() - 1;
     
-    QString presetName = QString::fromStdString(m_presetFiles[m_currentPresetIndex]);
-    qInfo() << "Loading previous preset:" << presetName;
-    m_projectM->LoadPresetFile(m_presetFiles[m_currentPresetIndex], false);
+    MVLOG(Info, Presets, "Loading previous preset: %s", m_presetFiles[m_currentPresetIndex].c_str());
+    if (m_context && m_context->makeCurrent(this)) {
+        loadCurrentPreset();
+        m_context->doneCurrent();
+    }
+    m_recorder.recordPreset(m_totalFrames, m_currentPresetIndex, m_presetFiles[m_currentPresetIndex]);
+}
+
+// Loads m_presetFiles[m_currentPresetIndex] and lets the residency manager
+// know, then evicts what no longer fits. Needs the context current.
+void ProjectMWindow::loadCurrentPreset() {
+    const std::string& file = m_presetFiles[m_currentPresetIndex];
+    QElapsedTimer timer;
+    timer.start();
+    PresetPack::loadPreset(*m_projectM, file, false);
+    const double loadMs = timer.nsecsElapsed() / 1e6;
+    m_residency.presetLoaded(file, loadMs);
+    // the preview strip loads the same presets; it only starts once it has a measured cost
+    m_previewStrip.addLoadSample(loadMs);
+    updatePreviewPresets();
+    enforceResidency();
+}
+
+void ProjectMWindow::enforceResidency() {
+    const int evicted = m_residency.enforce();
+    if (evicted == 0) {
+        return;
+    }
+    if (m_residency.takeTextureFlush()) {
+        // projectM can only drop textures all at once; the active preset keeps its own.
+        // Each preview slot is a projectM with its own texture cache, so it goes too.
+        QElapsedTimer timer;
+        timer.start();
+        m_projectM->SetTexturePaths(m_texturePaths);
+        m_previewStrip.flushTextures();
+        MVLOG(Debug, Textures, "Texture cache flushed in %.2f ms", timer.nsecsElapsed() / 1e6);
+    }
+    MVLOG(Info, Textures, "Evicted %d resources over budget: %s", evicted, qPrintable(m_residency.summary()));
+}
+
+// projectM's own buffers scale with the window; always resident.
+void ProjectMWindow::updateMainRenderTarget() {
+    m_residency.addRenderTarget("projectm", qint64(m_width) * m_height * 4 * PROJECTM_BUFFERS, nullptr);
+    m_residency.setPinned("projectm", true);
 }
 
 void ProjectMWindow::setPresetDuration(double seconds) {
@@ -632,4 +1163,48 @@ void ProjectMWindow::setPresetDuration(double seconds) {
         m_presetTimer.stop();
         m_presetTimer.start(m_presetDuration * 1000);
     }
+}
+
+void ProjectMWindow::setPreviewEnabled(bool enabled) {
+    m_previewEnabled = enabled;
+    m_residency.setPinned("preview", enabled);
+    qInfo() << "Preset preview strip" << (enabled ? "on" : "off");
+    // The strip is created lazily on the next frame, with the context current
+    if (enabled) {
+        requestUpdate();
+    } else if (m_previewStrip.isInitialized() && m_context && m_context->makeCurrent(this)) {
+        // Drop the slot instances and FBOs now rather than keeping them for a re-enable
+        m_residency.removeRenderTarget("preview");   // its evict callback releases the strip
+        if (m_previewStrip.isInitialized()) {
+            m_previewStrip.release();
+        }
+        m_context->doneCurrent();
+    }
+}
+
+// Points the preview slots at the presets that come after the current one,
+// and keeps those presets' textures off the eviction list.
+void ProjectMWindow::updatePreviewPresets() {
+    std::vector<std::string> upcoming;
+    if (!m_presetFiles.empty()) {
+        const size_t count = std::min<size_t>(PresetPreviewStrip::SLOT_COUNT, m_presetFiles.size() - 1);
+        for (size_t i = 1; i <= count; ++i) {
+            upcoming.push_back(m_presetFiles[(m_currentPresetIndex + i) % m_presetFiles.size()]);
+        }
+    }
+    m_residency.setUpcomingPresets(upcoming);
+    if (m_previewStrip.isInitialized()) {
+        m_previewStrip.setPresets(upcoming);
+        // the slots keep their presets' textures in caches of their own
+        m_residency.addRenderTarget("preview", PREVIEW_BYTES + m_residency.upcomingTextureBytes(), nullptr);
+    }
+}
+
+void ProjectMWindow::setPresetSeed(quint32 seed) {
+    m_presetSeed = seed;
+    m_presetSeedFixed = true;
+}
+
+bool ProjectMWindow::startRecording(const QString& path) {
+    return m_recorder.start(path);
 }
\ No newline at end of file
@@ -10,9 +10,21 @@
 #include <QAudioOutput>
 #include <QKeyEvent>
 #include <memory>
+#include <random>
 #include <string>
+#include <unordered_set>
 #include <vector>
-#include <sndfile.h>
+
+#include "allocationcounter.h"
+#include "audiofilereader.h"
+#include "audiopublisher.h"
+#include "framearena.h"
+#include "powerstate.h"
+#include "presetlibrarywatcher.h"
+#include "presetpreviewstrip.h"
+#include "resizecoalescer.h"
+#include "residencymanager.h"
+#include "sessionrecorder.h"
 
 // projectM classes
 namespace libprojectM {
@@ -31,14 +43,56 @@ public:
     ~ProjectMWindow();
 
     void setPresetPath(const std::string& path);
+    // Take the presets from a pack built with --build-preset-pack instead of the preset tree
+    void setPresetPack(const QString& packPath) { m_presetPackPath = packPath; }
     void setTexturePaths(const std::vector<std::string>& paths);
     void setAudioFile(const QString& filePath);
+    // Decode compressed inputs once into a float sidecar that later plays memory-map
+    void setDecodeCacheEnabled(bool enabled) { m_audioReader.setDecodeCacheEnabled(enabled); }
     
     // Preset management functions
     void loadAvailablePresets();
     void nextPreset();
     void previousPreset();
     void setPresetDuration(double seconds);
+    // Fixed seed for the preset shuffle (otherwise random), e.g. to reproduce a recorded session
+    void setPresetSeed(quint32 seed);
+    // Leave the most expensive `percent` of presets (by static cost estimate) out of the rotation
+    void setSkipExpensivePresets(double percent) { m_skipExpensivePercent = percent; }
+
+    // Live thumbnails of the next few presets along the bottom (toggle with V)
+    void setPreviewEnabled(bool enabled);
+    bool previewEnabled() const { return m_previewEnabled; }
+    const PresetPreviewStrip::Stats& previewStats() const { return m_previewStrip.stats(); }
+
+    // Budget for preset textures and our render targets; least recently used
+    // ones the current and upcoming presets don't need are evicted
+    void setGpuBudgetMb(int megabytes) { m_residency.setBudgetBytes(qint64(megabytes) * 1024 * 1024); }
+    const ResidencyManager::Stats& residencyStats() const { return m_residency.stats(); }
+
+    // Presets/textures synced in while running are picked up through inotify
+    struct LibraryUpdateStats {
+        int updates = 0;
+        qint64 lastApplyUs = 0;    // patching the catalog, on the GUI thread
+        qint64 maxApplyUs = 0;
+        qint64 lastLatencyMs = 0;  // first filesystem event until applied
+    };
+    const LibraryUpdateStats& libraryUpdateStats() const { return m_libraryStats; }
+
+    // Share each frame's PCM, spectrum and band energies with local processes (see audioshm.h)
+    bool startAudioPublishing() { return m_audioPublisher.open(); }
+
+    // Log audio source, seed, preset switches, resizes and keys for SessionReplayer
+    bool startRecording(const QString& path);
+
+    // Render loop power saving
+    PowerState powerState() const { return m_powerTracker.state(); }
+    const PowerStateTracker& powerStats() const { return m_powerTracker; }
+
+    // Exit with 0 if none of the next `frames` steady-state frames (after a
+    // warm-up) allocates on the heap outside projectM/Qt, 1 otherwise. Needs
+    // a build with MUSICVIS_COUNT_ALLOCATIONS.
+    void startAllocationCheck(int frames);
 
     // Media player access
     QMediaPlayer* mediaPlayer() const { return m_mediaPlayer; }
@@ -54,13 +108,23 @@ private slots:
     void render();
     void handleMediaStatusChanged(QMediaPlayer::MediaStatus status);
     void handleMediaError(QMediaPlayer::Error error, const QString &errorString);
+    void applyLibraryUpdate(const PresetLibraryWatcher::Update& update);
 
 private:
     bool openAudioFile();
     void closeAudioFile();
     void processAudioChunk();
+    void feedAudio(const float* stereo, size_t frames);
     void initialize();
     void cleanup();
+    void updatePowerState();
+    void setPowerState(PowerState state, const char* reason);
+    void updatePreviewPresets();
+    void loadCurrentPreset();
+    void dropExpensivePresets();
+    void enforceResidency();
+    void updateMainRenderTarget();
+    void checkFrameAllocations(const AllocationCounter::Counts& frame, bool steadyState);
 
     // OpenGL context
     QOpenGLContext *m_context = nullptr;
@@ -68,9 +132,7 @@ private:
 
     // Audio file handling members
     QString m_audioFilePath;
-    SNDFILE* m_sndFile = nullptr;
-    SF_INFO m_sfInfo;
-    std::vector<float> m_audioReadBuffer;
+    AudioFileReader m_audioReader;
 
     // Media playback members
     QMediaPlayer* m_mediaPlayer = nullptr;
@@ -82,27 +144,68 @@ private:
 
     // Preset management
     std::vector<std::string> m_presetFiles;
+    std::unordered_set<std::string> m_presetSet;   // same entries, for O(1) membership
     int m_currentPresetIndex = 0;
+    quint32 m_presetSeed = 0;
+    bool m_presetSeedFixed = false;
+    std::mt19937 m_presetRng;                      // shuffle, then placement of presets added later
+    PresetLibraryWatcher m_libraryWatcher;
+    LibraryUpdateStats m_libraryStats;
     QTimer m_presetTimer;
     double m_presetDuration = 30.0; // seconds
+    double m_skipExpensivePercent = 0.0;
+    double m_presetCostLimit = 0.0;                // estimated cost above which presets are left out; 0: none
 
     QTimer m_renderTimer;
     QElapsedTimer m_elapsedTimer;
     
+    // Power saving: drop the frame rate when nobody can see or hear the difference
+    PowerStateTracker m_powerTracker;
+    QElapsedTimer m_silentSince;    // valid while fed audio stays below the silence threshold
+    QElapsedTimer m_lastActivity;   // last key press; keeps us at full rate for a while
+    QElapsedTimer m_lastAudioChunk; // wall clock of the last file read, to keep LowRate reads real-time
+    bool m_audioPlaying = true;     // whether the file is being fed, i.e. playback isn't paused or stopped
+
     // FPS calculation
     QElapsedTimer m_fpsTimer;
     int m_frameCount = 0;
+    qint64 m_totalFrames = 0;       // frames rendered since initialize(); session log timebase
+
+    // Steady-state frames stay off the heap: per-frame scratch comes from the arena
+    FrameArena m_frameArena;
+    AllocationCounter::Counts m_windowAllocations;  // summed over the current FPS window
+    struct AllocationCheck {
+        int warmup = 0;
+        int remaining = 0;          // frames still to check; 0 when not checking
+        int checked = 0;
+        int allocatingFrames = 0;
+        quint64 worst = 0;
+        qint64 worstFrame = 0;
+        quint64 external = 0;
+    };
+    AllocationCheck m_allocationCheck;
+
+    SessionRecorder m_recorder;
+    AudioPublisher m_audioPublisher;
+
+    // Preset preview strip, shares the main context and audio feed
+    PresetPreviewStrip m_previewStrip;
+    bool m_previewEnabled = false;
+
+    ResidencyManager m_residency;
 
     // Paths
     std::string m_presetPath;
+    QString m_presetPackPath;       // empty: presets come from m_presetPath
     std::vector<std::string> m_texturePaths;
 
     // Dummy data for fallback
-    std::vector<short> m_dummyPcmData;
+    std::vector<float> m_dummyPcmData;
     int m_pcmCounter = 0;
 
     int m_width = 0;
     int m_height = 0;
+    ResizeCoalescer m_resize;       // window resizes, applied to projectM once per frame
     bool m_texturesSetup = false;  // Flag to track if textures are set up
     bool m_textureCheckDone = false; // Flag to track texture check
 };
@@ -0,0 +1,300 @@
+#include "residencymanager.h"
+#include "presetpack.h"
+
+#include <QImageReader>
+#include <QRegularExpression>
+#include <QSet>
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iterator>
+
+namespace {
+
+// sampler_<name> references that aren't files: projectM's own buffers and
+// noise, and rand00..rand15, which pick a random texture at load time.
+bool isBuiltinSampler(const QString& name)
+{
+    static const QSet<QString> builtins = {
+        "main", "blur1", "blur2", "blur3",
+        "noise_lq", "noise_lq_lite", "noise_mq", "noise_hq", "noisevol_lq", "noisevol_hq",
+    };
+    static const QRegularExpression random("^rand\\d\\d");
+    return builtins.contains(name) || random.match(name).hasMatch();
+}
+
+bool isImageFile(const std::filesystem::path& path)
+{
+    std::string extension = path.extension().string();
+    for (char& c : extension) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return extension == ".jpg" || extension == ".jpeg" || extension == ".png" || extension == ".tga" ||
+           extension == ".bmp" || extension == ".dds";
+}
+
+double toMb(qint64 bytes)
+{
+    return bytes / (1024.0 * 1024.0);
+}
+
+}
+
+void ResidencyManager::setTexturePaths(const std::vector<std::string>& paths)
+{
+    m_texturePaths = paths;
+    m_textureFiles.clear();
+    m_textureBytes.clear();
+    m_textureIndexBuilt = false;
+
+    // projectM rebuilds its texture manager here too: everything the active
+    // preset doesn't hold is gone, but that wasn't the budget's doing
+    for (auto it = m_lru.begin(); it != m_lru.end();) {
+        if (it->kind == Kind::Texture && !it->pinned) {
+            m_stats.residentBytes -= it->bytes;
+            m_stats.residentTextures--;
+            m_entries.erase(it->key);
+            it = m_lru.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// The texture files a preset references, resolved the way projectM does:
+// by base name, first search path wins. Names that don't resolve are
+// either built-in or missing, and cost nothing either way.
+std::vector<std::string> ResidencyManager::texturesOf(const std::string& presetFile)
+{
+    if (!m_textureIndexBuilt) {
+        m_textureIndexBuilt = true;
+        for (const auto& root : m_texturePaths) {
+            std::error_code error;
+            for (auto it = std::filesystem::recursive_directory_iterator(root, error);
+                 it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+                if (error) {
+                    break;
+                }
+                if (it->is_regular_file() && isImageFile(it->path())) {
+                    const QString stem = QString::fromStdString(it->path().stem().string()).toLower();
+                    m_textureFiles.emplace(stem.toStdString(), it->path().string());
+                }
+            }
+        }
+    }
+
+    std::vector<std::string> files;
+    const QByteArray contents = PresetPack::readPreset(presetFile);
+    if (contents.isEmpty()) {
+        return files;
+    }
+    static const QRegularExpression sampler("\\bsampler_(?:fw_|fc_|pw_|pc_)?(\\w+)");
+    const QString text = QString::fromUtf8(contents);
+    for (auto it = sampler.globalMatch(text); it.hasNext();) {
+        const QString name = it.next().captured(1).toLower();
+        if (isBuiltinSampler(name)) {
+            continue;
+        }
+        const auto found = m_textureFiles.find(name.toStdString());
+        if (found != m_textureFiles.end() &&
+            std::find(files.begin(), files.end(), found->second) == files.end()) {
+            files.push_back(found->second);
+        }
+    }
+    return files;
+}
+
+// RGBA8 with a full mip chain, from the image header alone.
+qint64 ResidencyManager::textureBytes(const std::string& file)
+{
+    const auto cached = m_textureBytes.find(file);
+    if (cached != m_textureBytes.end()) {
+        return cached->second;
+    }
+    const QSize size = QImageReader(QString::fromStdString(file)).size();
+    const qint64 bytes = size.isValid() ? qint64(size.width()) * size.height() * 4 * 4 / 3 : 0;
+    m_textureBytes.emplace(file, bytes);
+    return bytes;
+}
+
+void ResidencyManager::makeResident(Entry entry, bool* reloaded)
+{
+    const auto existing = m_entries.find(entry.key);
+    if (existing != m_entries.end()) {
+        Entry& current = *existing->second;
+        m_stats.residentBytes += entry.bytes - current.bytes;
+        current.bytes = entry.bytes;
+        current.pinned = current.pinned || entry.pinned;
+        if (entry.evict) {
+            current.evict = std::move(entry.evict);
+        }
+        m_lru.splice(m_lru.begin(), m_lru, existing->second);
+    } else {
+        if (m_evicted.erase(entry.key) > 0) {
+            *reloaded = true;
+        }
+        m_stats.residentBytes += entry.bytes;
+        if (entry.kind == Kind::Texture) {
+            m_stats.residentTextures++;
+        } else {
+            m_stats.residentTargets++;
+        }
+        const std::string key = entry.key;
+        m_lru.push_front(std::move(entry));
+        m_entries.emplace(key, m_lru.begin());
+    }
+    m_stats.peakBytes = std::max(m_stats.peakBytes, m_stats.residentBytes);
+}
+
+void ResidencyManager::presetLoaded(const std::string& presetFile, double loadMs)
+{
+    for (const auto& key : m_activeTextures) {
+        const auto it = m_entries.find(key);
+        if (it != m_entries.end()) {
+            it->second->pinned = false;
+        }
+    }
+
+    m_activeTextures = texturesOf(presetFile);
+    bool reloaded = false;
+    for (const auto& file : m_activeTextures) {
+        makeResident(Entry{file, Kind::Texture, textureBytes(file), true, false, nullptr}, &reloaded);
+    }
+    if (reloaded) {
+        m_stats.reloads++;
+        m_stats.reloadMsTotal += loadMs;
+    }
+}
+
+void ResidencyManager::setUpcomingPresets(const std::vector<std::string>& presetFiles)
+{
+    for (const auto& key : m_upcomingTextures) {
+        const auto it = m_entries.find(key);
+        if (it != m_entries.end()) {
+            it->second->upcoming = false;
+        }
+    }
+    m_upcomingTextures.clear();
+    m_upcomingBytes = 0;
+    for (const auto& preset : presetFiles) {
+        for (auto& file : texturesOf(preset)) {
+            m_upcomingBytes += textureBytes(file);
+            const auto it = m_entries.find(file);
+            if (it != m_entries.end()) {
+                it->second->upcoming = true;
+                m_upcomingTextures.push_back(std::move(file));
+            }
+        }
+    }
+}
+
+void ResidencyManager::addRenderTarget(const std::string& key, qint64 bytes, std::function<void()> evict, double loadMs)
+{
+    bool reloaded = false;
+    makeResident(Entry{key, Kind::RenderTarget, bytes, false, false, std::move(evict)}, &reloaded);
+    if (reloaded) {
+        m_stats.reloads++;
+        m_stats.reloadMsTotal += loadMs;
+    }
+}
+
+void ResidencyManager::setPinned(const std::string& key, bool pinned)
+{
+    const auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        it->second->pinned = pinned;
+    }
+}
+
+void ResidencyManager::removeRenderTarget(const std::string& key)
+{
+    const auto found = m_entries.find(key);
+    if (found == m_entries.end() || found->second->kind != Kind::RenderTarget) {
+        return;
+    }
+    const Lru::iterator it = found->second;
+    m_stats.residentBytes -= it->bytes;
+    m_stats.residentTargets--;
+    std::function<void()> release = std::move(it->evict);
+    m_entries.erase(found);
+    m_lru.erase(it);
+    if (release) {
+        release();
+    }
+}
+
+void ResidencyManager::evict(Lru::iterator it)
+{
+    m_stats.evictions++;
+    m_stats.evictedBytes += it->bytes;
+    m_stats.residentBytes -= it->bytes;
+    if (it->kind == Kind::Texture) {
+        m_stats.residentTextures--;
+    } else {
+        m_stats.residentTargets--;
+    }
+    m_evicted.insert(it->key);
+    if (it->evict) {
+        it->evict();
+    }
+    m_entries.erase(it->key);
+    m_lru.erase(it);
+}
+
+int ResidencyManager::enforce()
+{
+    int evicted = 0;
+    while (m_stats.residentBytes > m_stats.budgetBytes) {
+        auto victim = m_lru.end();
+        for (auto it = m_lru.rbegin(); it != m_lru.rend(); ++it) {
+            if (!it->pinned && !it->upcoming) {
+                victim = std::prev(it.base());
+                break;
+            }
+        }
+        if (victim == m_lru.end()) {
+            break;   // everything left is in use; the budget is too small for this preset
+        }
+        if (victim->kind == Kind::RenderTarget) {
+            evict(victim);
+            evicted++;
+            continue;
+        }
+        // One texture means a flush, and a flush drops every texture the
+        // active preset doesn't hold
+        for (auto it = m_lru.begin(); it != m_lru.end();) {
+            auto next = std::next(it);
+            if (it->kind == Kind::Texture && !it->pinned) {
+                evict(it);
+                evicted++;
+            }
+            it = next;
+        }
+        m_stats.textureFlushes++;
+        m_textureFlushPending = true;
+    }
+    return evicted;
+}
+
+bool ResidencyManager::takeTextureFlush()
+{
+    const bool pending = m_textureFlushPending;
+    m_textureFlushPending = false;
+    return pending;
+}
+
+QString ResidencyManager::summary() const
+{
+    return QString("%1 of %2 MB resident (peak %3 MB; %4 textures, %5 render targets), "
+                   "%6 evictions (%7 MB) in %8 texture flushes, %9 reloads averaging %10 ms")
+        .arg(toMb(m_stats.residentBytes), 0, 'f', 1)
+        .arg(toMb(m_stats.budgetBytes), 0, 'f', 1)
+        .arg(toMb(m_stats.peakBytes), 0, 'f', 1)
+        .arg(m_stats.residentTextures)
+        .arg(m_stats.residentTargets)
+        .arg(m_stats.evictions)
+        .arg(toMb(m_stats.evictedBytes), 0, 'f', 1)
+        .arg(m_stats.textureFlushes)
+        .arg(m_stats.reloads)
+        .arg(m_stats.reloads > 0 ? m_stats.reloadMsTotal / m_stats.reloads : 0.0, 0, 'f', 1);
+}
@@ -0,0 +1,109 @@
+#ifndef RESIDENCYMANAGER_H
+#define RESIDENCYMANAGER_H
+
+#include <QString>
+#include <QtGlobal>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Bookkeeping and a memory budget for the GPU resources a long session
+// piles up: textures projectM loads for presets (found by scanning each
+// preset for sampler_<name> references and resolving them against the
+// texture paths, sized from the image header) and render targets we own
+// (the preview strip). Entries sit in one LRU list; enforce() evicts the
+// least recently used ones that neither the active nor an upcoming preset
+// needs until the total fits the budget.
+//
+// projectM has no per-texture eviction, only SetTexturePaths(), which
+// rebuilds its texture manager and drops every cached texture the loaded
+// presets don't still hold. So evicting any texture evicts all unpinned
+// textures at once, and the owner is asked to do that flush through
+// takeTextureFlush(). Render targets are evicted one by one through their
+// callback.
+class ResidencyManager
+{
+public:
+    enum class Kind { Texture, RenderTarget };
+
+    struct Stats {
+        qint64 budgetBytes = 0;
+        qint64 residentBytes = 0;
+        qint64 peakBytes = 0;
+        int residentTextures = 0;
+        int residentTargets = 0;
+        qint64 evictions = 0;
+        qint64 evictedBytes = 0;
+        qint64 textureFlushes = 0;
+        qint64 reloads = 0;            // loads that brought back something evicted earlier
+        double reloadMsTotal = 0.0;
+    };
+
+    static constexpr qint64 DEFAULT_BUDGET_BYTES = 256ll * 1024 * 1024;
+
+    void setTexturePaths(const std::vector<std::string>& paths);
+    void setBudgetBytes(qint64 bytes) { m_stats.budgetBytes = bytes; }
+    qint64 budgetBytes() const { return m_stats.budgetBytes; }
+
+    // A preset was just loaded (taking loadMs): its textures are resident and
+    // most recently used, and pinned while it's the active preset.
+    void presetLoaded(const std::string& presetFile, double loadMs);
+    // Resident textures of these presets are not chosen for eviction (a
+    // flush forced by other textures still takes them along).
+    void setUpcomingPresets(const std::vector<std::string>& presetFiles);
+    // Texture bytes of the upcoming presets, one copy per preset: what the
+    // preview slots' own texture caches hold while they show them.
+    qint64 upcomingTextureBytes() const { return m_upcomingBytes; }
+
+    // Render targets we allocate ourselves (again with the same key to
+    // update the size). `evict` must free them; it runs from enforce().
+    void addRenderTarget(const std::string& key, qint64 bytes, std::function<void()> evict, double loadMs = 0.0);
+    void setPinned(const std::string& key, bool pinned);
+    // Frees a render target (through its `evict`) because the caller is done
+    // with it; not counted as an eviction, and adding it back isn't a reload.
+    void removeRenderTarget(const std::string& key);
+
+    // Evicts LRU unpinned entries until within budget. Returns how many went.
+    int enforce();
+    // True once if enforce() evicted textures; the caller then calls
+    // SetTexturePaths() on projectM with its context current.
+    bool takeTextureFlush();
+
+    const Stats& stats() const { return m_stats; }
+    QString summary() const;
+
+private:
+    struct Entry {
+        std::string key;
+        Kind kind;
+        qint64 bytes = 0;
+        bool pinned = false;
+        bool upcoming = false;
+        std::function<void()> evict;
+    };
+    using Lru = std::list<Entry>;   // front = most recently used
+
+    std::vector<std::string> texturesOf(const std::string& presetFile);
+    qint64 textureBytes(const std::string& file);
+    void makeResident(Entry entry, bool* reloaded);
+    void evict(Lru::iterator it);
+
+    std::vector<std::string> m_texturePaths;
+    std::unordered_map<std::string, std::string> m_textureFiles;   // lowercase base name -> file
+    std::unordered_map<std::string, qint64> m_textureBytes;        // file -> estimated GPU bytes
+    bool m_textureIndexBuilt = false;
+
+    Lru m_lru;
+    std::unordered_map<std::string, Lru::iterator> m_entries;
+    std::unordered_set<std::string> m_evicted;   // keys evicted at some point, to spot reloads
+    std::vector<std::string> m_activeTextures;
+    std::vector<std::string> m_upcomingTextures;
+    qint64 m_upcomingBytes = 0;
+    bool m_textureFlushPending = false;
+    Stats m_stats{DEFAULT_BUDGET_BYTES};
+};
+
+#endif // RESIDENCYMANAGER_H
@@ -0,0 +1,76 @@
+#include "resizecoalescer.h"
+
+namespace {
+
+int roundUp(int size, int step)
+{
+    return (size + step - 1) / step * step;
+}
+
+int growCapacity(int needed, int capacity)
+{
+    return needed <= capacity ? capacity : qMax(needed, roundUp(capacity * 3 / 2, ResizeCoalescer::CAPACITY_STEP));
+}
+
+}
+
+void ResizeCoalescer::reset(int width, int height)
+{
+    m_pending = false;
+    m_requestedWidth = m_appliedWidth = width;
+    m_requestedHeight = m_appliedHeight = height;
+}
+
+void ResizeCoalescer::request(int width, int height)
+{
+    m_requestedWidth = width;
+    m_requestedHeight = height;
+    m_pending = true;
+    m_stats.requests++;
+}
+
+bool ResizeCoalescer::take(int* width, int* height)
+{
+    if (!m_pending) {
+        return false;
+    }
+    m_pending = false;
+    // A drag that ends where it started costs nothing
+    if (m_requestedWidth == m_appliedWidth && m_requestedHeight == m_appliedHeight) {
+        return false;
+    }
+    m_appliedWidth = *width = m_requestedWidth;
+    m_appliedHeight = *height = m_requestedHeight;
+    m_stats.applied++;
+    return true;
+}
+
+bool ResizeCoalescer::fitCapacity(int width, int height)
+{
+    const int neededWidth = roundUp(qMax(width, 1), CAPACITY_STEP);
+    const int neededHeight = roundUp(qMax(height, 1), CAPACITY_STEP);
+    const bool fits = neededWidth <= m_capacityWidth && neededHeight <= m_capacityHeight;
+    // Growth leaves headroom, so only give storage back once it's far larger than needed
+    const bool wasteful = qint64(neededWidth) * neededHeight * 8 < qint64(m_capacityWidth) * m_capacityHeight;
+    if (fits && !wasteful) {
+        return false;
+    }
+    if (wasteful) {
+        m_capacityWidth = neededWidth;
+        m_capacityHeight = neededHeight;
+    } else {
+        // Grow by half again, so a window dragged larger settles after a few allocations
+        m_capacityWidth = growCapacity(neededWidth, m_capacityWidth);
+        m_capacityHeight = growCapacity(neededHeight, m_capacityHeight);
+    }
+    m_stats.allocations++;
+    return true;
+}
+
+QString ResizeCoalescer::summary() const
+{
+    return QString("%1 requests, %2 applied, %3 allocations")
+        .arg(m_stats.requests)
+        .arg(m_stats.applied)
+        .arg(m_stats.allocations);
+}
@@ -0,0 +1,56 @@
+#ifndef RESIZECOALESCER_H
+#define RESIZECOALESCER_H
+
+#include <QString>
+#include <QtGlobal>
+
+// Resize requests arrive far faster than frames while a window is dragged
+// or a compositor animates it. They are only recorded here; the renderer
+// takes the latest one once per frame, right before rendering, so a burst
+// costs one projectM reallocation instead of one per event.
+//
+// Render targets the renderer owns are sized by fitCapacity(): storage
+// grows with headroom (in CAPACITY_STEP increments) and is only given back
+// when it's more than eight times the area needed, so most sizes of a drag
+// land in storage that is already allocated.
+class ResizeCoalescer
+{
+public:
+    struct Stats {
+        qint64 requests = 0;
+        qint64 applied = 0;        // sizes actually handed to projectM
+        qint64 allocations = 0;    // render target storage (re)allocated
+    };
+
+    static constexpr int CAPACITY_STEP = 256;
+
+    // The size the renderer was set up with; drops anything pending.
+    void reset(int width, int height);
+    void request(int width, int height);
+    bool hasPending() const { return m_pending; }
+
+    // The most recent request, if it differs from the size applied last.
+    bool take(int* width, int* height);
+
+    // True if a target holding width x height needs new storage; the new
+    // storage size is then capacityWidth() x capacityHeight().
+    bool fitCapacity(int width, int height);
+    int capacityWidth() const { return m_capacityWidth; }
+    int capacityHeight() const { return m_capacityHeight; }
+
+    const Stats& stats() const { return m_stats; }
+    // e.g. "412 requests, 58 applied, 3 allocations"
+    QString summary() const;
+
+private:
+    bool m_pending = false;
+    int m_requestedWidth = 0;
+    int m_requestedHeight = 0;
+    int m_appliedWidth = 0;
+    int m_appliedHeight = 0;
+    int m_capacityWidth = 0;
+    int m_capacityHeight = 0;
+    Stats m_stats;
+};
+
+#endif // RESIZECOALESCER_H
@@ -0,0 +1,131 @@
+#include "sessionrecorder.h"
+#include "projectmsettings.h"
+
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+bool SessionRecorder::start(const QString& path)
+{
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qWarning() << "Cannot record session to" << path << "-" << m_file.errorString();
+        return false;
+    }
+    m_clock.start();
+    qInfo() << "Recording session to" << path;
+    return true;
+}
+
+void SessionRecorder::stop(qint64 frame)
+{
+    if (!isRecording()) {
+        return;
+    }
+    write("end", frame, QJsonObject());
+    m_file.close();
+}
+
+void SessionRecorder::recordSession(const QString& audioFile, quint32 seed, const std::string& presetPath,
+                                    const std::vector<std::string>& texturePaths, int width, int height)
+{
+    if (!isRecording()) {
+        return;
+    }
+    QJsonArray textures;
+    for (const auto& path : texturePaths) {
+        textures.append(QString::fromStdString(path));
+    }
+
+    QJsonObject header;
+    header["type"] = "session";
+    header["version"] = FORMAT_VERSION;
+    header["audio"] = audioFile;
+    header["seed"] = static_cast<qint64>(seed);
+    header["presetPath"] = QString::fromStdString(presetPath);
+    header["texturePaths"] = textures;
+    header["width"] = width;
+    header["height"] = height;
+    header["fps"] = ProjectMSettings::FPS_TARGET;
+    header["chunkFrames"] = ProjectMSettings::AUDIO_FRAMES_PER_CHUNK;
+    m_file.write(QJsonDocument(header).toJson(QJsonDocument::Compact) + '\n');
+    m_file.flush();
+}
+
+void SessionRecorder::recordPreset(qint64 frame, int index, const std::string& file)
+{
+    // Not even the event object when idle: presets switch from the frame loop
+    if (!isRecording()) {
+        return;
+    }
+    QJsonObject object;
+    object["index"] = index;
+    object["file"] = QString::fromStdString(file);
+    write("preset", frame, object);
+}
+
+void SessionRecorder::recordResize(qint64 frame, int width, int height)
+{
+    if (!isRecording()) {
+        return;
+    }
+    QJsonObject object;
+    object["width"] = width;
+    object["height"] = height;
+    write("resize", frame, object);
+}
+
+void SessionRecorder::recordKey(qint64 frame, int key, const QString& text)
+{
+    if (!isRecording()) {
+        return;
+    }
+    QJsonObject object;
+    object["key"] = key;
+    object["text"] = text;
+    write("key", frame, object);
+}
+
+void SessionRecorder::recordAudio(qint64 frame, const QString& audioFile)
+{
+    if (!isRecording()) {
+        return;
+    }
+    QJsonObject object;
+    object["file"] = audioFile;
+    write("audio", frame, object);
+}
+
+void SessionRecorder::recordPlayback(qint64 frame, bool playing)
+{
+    if (!isRecording()) {
+        return;
+    }
+    QJsonObject object;
+    object["playing"] = playing;
+    write("playback", frame, object);
+}
+
+void SessionRecorder::recordSeek(qint64 frame, qint64 position)
+{
+    // A few per second while the frame loop is at the LowRate tick
+    if (!isRecording()) {
+        return;
+    }
+    QJsonObject object;
+    object["position"] = position;
+    write("seek", frame, object);
+}
+
+void SessionRecorder::write(const QString& type, qint64 frame, QJsonObject object)
+{
+    if (!isRecording()) {
+        return;
+    }
+    object["type"] = type;
+    object["frame"] = frame;
+    object["t"] = m_clock.elapsed();
+    m_file.write(QJsonDocument(object).toJson(QJsonDocument::Compact) + '\n');
+    // Events are rare; flushing each one means a crash still leaves a usable log
+    m_file.flush();
+}
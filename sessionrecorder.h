@@ -0,0 +1,51 @@
+#ifndef SESSIONRECORDER_H
+#define SESSIONRECORDER_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonObject>
+#include <QString>
+#include <string>
+#include <vector>
+
+// Logs everything that makes a live session nondeterministic (audio source,
+// preset shuffle seed, preset switches, resizes, key presses) as JSON lines,
+// stamped with the rendered frame number and wall time. SessionReplayer
+// plays the log back offscreen on a fixed timestep.
+//
+// One object per line, "type" is one of:
+//   session  - header: audio, seed, presetPath, texturePaths, width, height, fps, chunkFrames
+//   preset   - index, file
+//   resize   - width, height
+//   key      - key, text
+//   audio    - file (audio source changed mid-session)
+//   playback - playing (false while paused or stopped: silence is fed, the file holds its place)
+//   seek     - position (input frames; the file read jumped to the player's position)
+//   end      - last frame of the session
+// Every line except the header carries "frame" and "t" (ms since start).
+class SessionRecorder
+{
+public:
+    static constexpr int FORMAT_VERSION = 1;
+
+    bool start(const QString& path);
+    void stop(qint64 frame);
+    bool isRecording() const { return m_file.isOpen(); }
+
+    void recordSession(const QString& audioFile, quint32 seed, const std::string& presetPath,
+                       const std::vector<std::string>& texturePaths, int width, int height);
+    void recordPreset(qint64 frame, int index, const std::string& file);
+    void recordResize(qint64 frame, int width, int height);
+    void recordKey(qint64 frame, int key, const QString& text);
+    void recordAudio(qint64 frame, const QString& audioFile);
+    void recordPlayback(qint64 frame, bool playing);
+    void recordSeek(qint64 frame, qint64 position);
+
+private:
+    void write(const QString& type, qint64 frame, QJsonObject object);
+
+    QFile m_file;
+    QElapsedTimer m_clock;
+};
+
+#endif // SESSIONRECORDER_H
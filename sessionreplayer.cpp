@@ -0,0 +1,275 @@
+#include "sessionreplayer.h"
+#include "audiofilereader.h"
+#include "frametimestats.h"
+#include "offscreenrenderer.h"
+#include "projectmsettings.h"
+#include "sessionrecorder.h"
+
+#include <Audio/PCM.hpp>
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+// Sessions without an "end" record (the app crashed) replay this far past the last event.
+const int TAIL_SECONDS = 5;
+const int WORST_FRAMES_REPORTED = 5;
+
+bool SessionReplayer::load(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qCritical() << "Cannot open session log" << path << "-" << file.errorString();
+        return false;
+    }
+
+    m_session = QJsonObject();
+    m_events.clear();
+    m_endFrame = -1;
+    int lineNumber = 0;
+
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine().trimmed();
+        ++lineNumber;
+        if (line.isEmpty()) {
+            continue;
+        }
+        QJsonParseError error;
+        const QJsonDocument doc = QJsonDocument::fromJson(line, &error);
+        if (!doc.isObject()) {
+            qWarning() << "Session log line" << lineNumber << "is not valid JSON:" << error.errorString();
+            continue;
+        }
+        const QJsonObject object = doc.object();
+        const QString type = object.value("type").toString();
+        if (type == "session") {
+            if (object.value("version").toInt() != SessionRecorder::FORMAT_VERSION) {
+                qCritical() << "Unsupported session log version" << object.value("version").toInt();
+                return false;
+            }
+            m_session = object;
+        } else if (type == "end") {
+            m_endFrame = object.value("frame").toInteger();
+        } else {
+            m_events.push_back(object);
+        }
+    }
+
+    if (m_session.isEmpty()) {
+        qCritical() << "Session log has no header:" << path;
+        return false;
+    }
+
+    std::stable_sort(m_events.begin(), m_events.end(), [](const QJsonObject& a, const QJsonObject& b) {
+        return a.value("frame").toInteger() < b.value("frame").toInteger();
+    });
+    if (m_endFrame < 0) {
+        const qint64 lastEvent = m_events.isEmpty() ? 0 : m_events.back().value("frame").toInteger();
+        m_endFrame = lastEvent + TAIL_SECONDS * m_session.value("fps").toInt(ProjectMSettings::FPS_TARGET);
+    }
+    return true;
+}
+
+int SessionReplayer::run(const Options& options)
+{
+    if (!load(options.sessionPath)) {
+        return 2;
+    }
+
+    const int width = m_session.value("width").toInt(800);
+    const int height = m_session.value("height").toInt(600);
+    const int fps = m_session.value("fps").toInt(ProjectMSettings::FPS_TARGET);
+    const int chunkFrames = m_session.value("chunkFrames").toInt(ProjectMSettings::AUDIO_FRAMES_PER_CHUNK);
+
+    std::vector<std::string> texturePaths;
+    for (const QJsonValue& value : m_session.value("texturePaths").toArray()) {
+        texturePaths.push_back(value.toString().toStdString());
+    }
+
+    OffscreenRenderer renderer;
+    if (!renderer.initialize(width, height, texturePaths)) {
+        qCritical() << "Could not create offscreen renderer for replay.";
+        return 2;
+    }
+
+    AudioFileReader audio;
+    const QString audioFile = m_session.value("audio").toString();
+    if (!audioFile.isEmpty() && !audio.open(audioFile, chunkFrames)) {
+        qWarning() << "Replay audio unavailable, falling back to dummy audio:" << audioFile;
+    }
+    std::vector<float> dummyPcm(static_cast<size_t>(chunkFrames) * 2);
+    int dummyCounter = 0;
+    bool audioPlaying = true;
+
+    qInfo() << "Replaying" << options.sessionPath << ":" << (m_endFrame + 1) << "frames,"
+            << m_events.size() << "events, seed" << m_session.value("seed").toInteger()
+            << "on" << renderer.rendererName();
+
+    std::vector<double> frameTimesMs;
+    std::vector<int> presetAtFrame;
+    frameTimesMs.reserve(static_cast<size_t>(m_endFrame + 1));
+    presetAtFrame.reserve(static_cast<size_t>(m_endFrame + 1));
+
+    int nextEvent = 0;
+    int currentPreset = -1;
+    int keyEvents = 0;
+    for (qint64 frame = 0; frame <= m_endFrame; ++frame) {
+        QElapsedTimer frameTimer;
+        frameTimer.start();
+
+        // Apply everything that happened before this frame, like the live event loop did
+        while (nextEvent < m_events.size() && m_events.at(nextEvent).value("frame").toInteger() <= frame) {
+            const QJsonObject& event = m_events.at(nextEvent);
+            const QString type = event.value("type").toString();
+            if (type == "preset") {
+                renderer.loadPreset(event.value("file").toString().toStdString());
+                currentPreset = nextEvent;
+            } else if (type == "resize") {
+                renderer.resize(event.value("width").toInt(), event.value("height").toInt());
+            } else if (type == "audio") {
+                const QString file = event.value("file").toString();
+                if (file.isEmpty() || !audio.open(file, chunkFrames)) {
+                    audio.close();
+                }
+            } else if (type == "playback") {
+                audioPlaying = event.value("playing").toBool(true);
+            } else if (type == "seek") {
+                audio.seek(event.value("position").toInteger());
+            } else if (type == "key") {
+                // Informational: the preset switches keys caused are logged as their own events
+                keyEvents++;
+            }
+            nextEvent++;
+        }
+
+        size_t frames = 0;
+        const float* stereo = audio.isOpen() && audioPlaying ? audio.readChunk(&frames) : nullptr;
+        if (audio.isOpen() && !audioPlaying) {
+            // paused live: the window fed silence and left the file where it was
+            std::fill(dummyPcm.begin(), dummyPcm.end(), 0.0f);
+            renderer.pcm().Add(dummyPcm.data(), 2, static_cast<size_t>(chunkFrames));
+        } else if (frames > 0) {
+            renderer.pcm().Add(stereo, 2, frames);
+        } else if (!audio.isOpen()) {
+            // same sine the live window falls back to
+            dummyCounter++;
+            for (int i = 0; i < chunkFrames; ++i) {
+                const float val = std::sin(static_cast<float>(dummyCounter * 10 + i) * 0.1f);
+                dummyPcm[2 * i] = val;
+                dummyPcm[2 * i + 1] = val;
+            }
+            renderer.pcm().Add(dummyPcm.data(), 2, static_cast<size_t>(chunkFrames));
+        }
+
+        renderer.renderFrame(static_cast<double>(frame) / fps);
+
+        frameTimesMs.push_back(frameTimer.nsecsElapsed() / 1e6);
+        presetAtFrame.push_back(currentPreset);
+    }
+
+    const FrameTimeStats stats = FrameTimeStats::compute(frameTimesMs);
+    qInfo().noquote() << "Replay frame times:" << stats.toString() << "|" << keyEvents << "key events";
+
+    if (options.baselinePath.isEmpty()) {
+        return 0;
+    }
+    if (options.writeBaseline || !QFileInfo::exists(options.baselinePath)) {
+        return writeBaseline(options.baselinePath, frameTimesMs, renderer.rendererName()) ? 0 : 2;
+    }
+    return compare(options.baselinePath, frameTimesMs, presetAtFrame, renderer.rendererName(), options.tolerance);
+}
+
+bool SessionReplayer::writeBaseline(const QString& path, const std::vector<double>& frameTimesMs,
+                                    const QString& rendererName) const
+{
+    QJsonArray times;
+    for (double ms : frameTimesMs) {
+        times.append(std::round(ms * 1000.0) / 1000.0);
+    }
+    QJsonObject baseline;
+    baseline["version"] = 1;
+    baseline["renderer"] = rendererName;
+    baseline["seed"] = m_session.value("seed");
+    baseline["frames"] = static_cast<qint64>(frameTimesMs.size());
+    baseline["frameTimesMs"] = times;
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCritical() << "Cannot write baseline" << path << "-" << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(baseline).toJson(QJsonDocument::Indented));
+    qInfo() << "Wrote frame-time baseline to" << path;
+    return true;
+}
+
+int SessionReplayer::compare(const QString& path, const std::vector<double>& frameTimesMs,
+                             const std::vector<int>& presetAtFrame, const QString& rendererName,
+                             double tolerance) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCritical() << "Cannot read baseline" << path << "-" << file.errorString();
+        return 2;
+    }
+    const QJsonObject baseline = QJsonDocument::fromJson(file.readAll()).object();
+    std::vector<double> baseTimes;
+    for (const QJsonValue& value : baseline.value("frameTimesMs").toArray()) {
+        baseTimes.push_back(value.toDouble());
+    }
+    if (baseTimes.empty()) {
+        qCritical() << "Baseline has no frame times:" << path;
+        return 2;
+    }
+    if (baseline.value("renderer").toString() != rendererName) {
+        qWarning() << "Baseline was recorded on" << baseline.value("renderer").toString()
+                   << "but this run is on" << rendererName << "- comparison may be meaningless.";
+    }
+    if (baseTimes.size() != frameTimesMs.size()) {
+        qWarning() << "Baseline has" << baseTimes.size() << "frames, this run" << frameTimesMs.size()
+                   << "- comparing the overlap only.";
+    }
+
+    const size_t overlap = std::min(baseTimes.size(), frameTimesMs.size());
+    const FrameTimeStats base = FrameTimeStats::compute(std::vector<double>(baseTimes.begin(), baseTimes.begin() + overlap));
+    const FrameTimeStats current = FrameTimeStats::compute(std::vector<double>(frameTimesMs.begin(), frameTimesMs.begin() + overlap));
+    qInfo().noquote() << "Baseline:" << base.toString();
+    qInfo().noquote() << "Current: " << current.toString();
+
+    // Per-frame deltas point at the preset responsible for a regression
+    std::vector<size_t> order(overlap);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return (frameTimesMs[a] - baseTimes[a]) > (frameTimesMs[b] - baseTimes[b]);
+    });
+    for (size_t i = 0; i < std::min<size_t>(WORST_FRAMES_REPORTED, order.size()); ++i) {
+        const size_t frame = order[i];
+        const int presetEvent = presetAtFrame[frame];
+        const QString preset = presetEvent >= 0
+            ? QFileInfo(m_events[presetEvent].value("file").toString()).fileName()
+            : QString("(idle)");
+        qInfo().noquote() << QString("  frame %1: %2 ms (baseline %3 ms) preset %4")
+                                 .arg(frame)
+                                 .arg(frameTimesMs[frame], 0, 'f', 2)
+                                 .arg(baseTimes[frame], 0, 'f', 2)
+                                 .arg(preset);
+    }
+
+    const bool p95Regressed = current.p95 > base.p95 * (1.0 + tolerance);
+    const bool p99Regressed = current.p99 > base.p99 * (1.0 + tolerance);
+    if (p95Regressed || p99Regressed) {
+        qCritical().noquote() << QString("FRAME TIME REGRESSION: p95 %1 -> %2 ms, p99 %3 -> %4 ms (tolerance %5%)")
+                                     .arg(base.p95, 0, 'f', 2).arg(current.p95, 0, 'f', 2)
+                                     .arg(base.p99, 0, 'f', 2).arg(current.p99, 0, 'f', 2)
+                                     .arg(tolerance * 100.0, 0, 'f', 0);
+        return 1;
+    }
+    qInfo() << "Frame times within tolerance of baseline.";
+    return 0;
+}
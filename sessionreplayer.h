@@ -0,0 +1,41 @@
+#ifndef SESSIONREPLAYER_H
+#define SESSIONREPLAYER_H
+
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+#include <vector>
+
+// Replays a SessionRecorder log into an OffscreenRenderer on a fixed
+// timestep (one audio chunk and 1/fps of animation time per frame), times
+// every frame, and compares against a stored baseline. Intended as a perf
+// regression check on CI boxes without a GPU:
+//
+//   QT_QPA_PLATFORM=offscreen musicvisqt --replay show.jsonl --baseline show.baseline.json
+//
+// Exit code: 0 ok, 1 regression against the baseline, 2 could not run.
+class SessionReplayer
+{
+public:
+    struct Options {
+        QString sessionPath;
+        QString baselinePath;
+        bool writeBaseline = false;   // store this run as the new baseline instead of comparing
+        double tolerance = 0.20;      // allowed p95/p99 growth over baseline
+    };
+
+    int run(const Options& options);
+
+private:
+    bool load(const QString& path);
+    bool writeBaseline(const QString& path, const std::vector<double>& frameTimesMs,
+                       const QString& rendererName) const;
+    int compare(const QString& path, const std::vector<double>& frameTimesMs,
+                const std::vector<int>& presetAtFrame, const QString& rendererName, double tolerance) const;
+
+    QJsonObject m_session;
+    QVector<QJsonObject> m_events;  // everything after the header, in frame order
+    qint64 m_endFrame = 0;
+};
+
+#endif // SESSIONREPLAYER_H
@@ -0,0 +1,466 @@
+#include "thumbnailatlas.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImage>
+#include <QImageReader>
+#include <QStandardPaths>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+const char ATLAS_MAGIC[4] = {'M', 'V', 'T', 'A'};
+const quint32 ATLAS_VERSION = 1;
+const int MAX_LEVELS = 16;
+const quint32 MAX_TILE_SIZE = 4096;
+const qint64 LEVEL_ALIGNMENT = 4096;
+const quint32 FLAG_NO_PREVIEW = 1;
+const uchar MISSING_GRAY = 0x20;
+
+struct ThumbnailAtlas::FileHeader {
+    char magic[4];
+    quint32 version;
+    quint32 tileSize;
+    quint32 levels;
+    quint32 count;
+    quint32 stringsSize;
+    quint64 indexOffset;
+    quint64 stringsOffset;
+    quint64 levelOffsets[MAX_LEVELS];
+};
+
+struct ThumbnailAtlas::IndexEntry {
+    quint32 keyOffset;     // into the string block
+    quint32 keyLength;
+    qint64 sourceMtime;    // ms since epoch of the .jpg, 0 if missing
+    qint64 sourceSize;
+    quint32 flags;
+    quint32 reserved;
+};
+
+namespace {
+
+struct Source {
+    QByteArray key;        // UTF-8 relative .milk path; byte order is the index order
+    QString jpgPath;
+    qint64 mtime = 0;
+    qint64 size = 0;
+    bool missing = false;
+    int previous = -1;     // index in the old atlas to copy from, or -1 to decode
+};
+
+qint64 alignUp(qint64 value, qint64 alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+int keyCompare(const char* a, int aLength, const QByteArray& b)
+{
+    const int common = std::min(aLength, static_cast<int>(b.size()));
+    const int c = std::memcmp(a, b.constData(), static_cast<size_t>(common));
+    return c != 0 ? c : aLength - static_cast<int>(b.size());
+}
+
+// 2x2 box filter from one mip level to the next.
+void downsample(const uchar* src, int srcSize, uchar* dst)
+{
+    const int dstSize = srcSize / 2;
+    for (int y = 0; y < dstSize; ++y) {
+        const uchar* row0 = src + (2 * y) * srcSize * 4;
+        const uchar* row1 = row0 + srcSize * 4;
+        uchar* out = dst + y * dstSize * 4;
+        for (int x = 0; x < dstSize; ++x) {
+            for (int c = 0; c < 4; ++c) {
+                const int sum = row0[8 * x + c] + row0[8 * x + 4 + c] + row1[8 * x + c] + row1[8 * x + 4 + c];
+                out[4 * x + c] = static_cast<uchar>((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+// Decodes one preview into a tileSize x tileSize RGBA tile, center-cropped.
+bool decodeTile(const QString& jpgPath, int tileSize, uchar* dst)
+{
+    QImageReader reader(jpgPath);
+    const QSize sourceSize = reader.size();
+    if (sourceSize.isValid()) {
+        // Lets the JPEG decoder do most of the downscaling (DCT scaling) for free
+        reader.setScaledSize(sourceSize.scaled(tileSize, tileSize, Qt::KeepAspectRatioByExpanding));
+    }
+    QImage image = reader.read();
+    if (image.isNull()) {
+        return false;
+    }
+    if (image.width() != tileSize || image.height() != tileSize) {
+        const int side = std::min(image.width(), image.height());
+        image = image.copy((image.width() - side) / 2, (image.height() - side) / 2, side, side)
+                    .scaled(tileSize, tileSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    image = image.convertToFormat(QImage::Format_RGBA8888);
+    for (int y = 0; y < tileSize; ++y) {
+        std::memcpy(dst + y * tileSize * 4, image.constScanLine(y), static_cast<size_t>(tileSize) * 4);
+    }
+    return true;
+}
+
+}
+
+QString ThumbnailAtlas::defaultPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/thumbnails.atlas";
+}
+
+bool ThumbnailAtlas::build(const QString& presetRoot, const QString& atlasPath, int tileSize, BuildStats* stats)
+{
+    QElapsedTimer timer;
+    timer.start();
+    BuildStats local;
+    BuildStats& result = stats ? *stats : local;
+    result = BuildStats();
+
+    if (tileSize <= 0 || (tileSize & (tileSize - 1)) != 0) {
+        qWarning() << "Thumbnail atlas: tile size must be a power of two, got" << tileSize;
+        return false;
+    }
+    int levels = 0;
+    while ((tileSize >> levels) > 0 && levels < MAX_LEVELS) {
+        levels++;
+    }
+
+    // --- Scan ---
+    const QDir root(presetRoot);
+    std::vector<Source> sources;
+    QDirIterator it(presetRoot, QStringList() << "*.milk", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString milkPath = it.next();
+        Source source;
+        source.key = root.relativeFilePath(milkPath).toUtf8();
+        source.jpgPath = milkPath.chopped(5) + ".jpg";
+        const QFileInfo jpg(source.jpgPath);
+        if (jpg.isFile()) {
+            source.mtime = jpg.lastModified().toMSecsSinceEpoch();
+            source.size = jpg.size();
+        } else {
+            source.missing = true;
+        }
+        sources.push_back(std::move(source));
+    }
+    std::sort(sources.begin(), sources.end(), [](const Source& a, const Source& b) { return a.key < b.key; });
+    result.entries = static_cast<int>(sources.size());
+
+    // --- Match against the previous atlas ---
+    ThumbnailAtlas previous;
+    const bool havePrevious = QFileInfo::exists(atlasPath) && previous.open(atlasPath) &&
+                              previous.tileSize() == tileSize;
+    bool unchanged = havePrevious && previous.count() == result.entries;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        Source& source = sources[i];
+        if (havePrevious) {
+            const int index = previous.indexOf(QString::fromUtf8(source.key));
+            const IndexEntry* old = index >= 0 ? previous.entry(index) : nullptr;
+            if (old && old->sourceMtime == source.mtime && old->sourceSize == source.size) {
+                source.previous = index;
+            }
+        }
+        if (source.previous != static_cast<int>(i)) {
+            unchanged = false;
+        }
+    }
+    if (unchanged) {
+        for (int i = 0; i < previous.count(); ++i) {
+            if (!previous.hasPreview(i)) {
+                result.missing++;
+            }
+        }
+        result.reused = result.entries - result.missing;
+        result.upToDate = true;
+        result.elapsedMs = timer.elapsed();
+        qInfo() << "Thumbnail atlas up to date:" << result.entries << "presets," << result.elapsedMs << "ms";
+        return true;
+    }
+
+    // --- Layout ---
+    QByteArray strings;
+    std::vector<IndexEntry> index(sources.size());
+    for (size_t i = 0; i < sources.size(); ++i) {
+        IndexEntry& e = index[i];
+        std::memset(&e, 0, sizeof(e));
+        e.keyOffset = static_cast<quint32>(strings.size());
+        e.keyLength = static_cast<quint32>(sources[i].key.size());
+        e.sourceMtime = sources[i].mtime;
+        e.sourceSize = sources[i].size;
+        // a reused tile keeps what the previous build knew, e.g. that the .jpg didn't decode
+        e.flags = sources[i].previous >= 0 ? previous.entry(sources[i].previous)->flags
+                                           : (sources[i].missing ? FLAG_NO_PREVIEW : 0);
+        strings.append(sources[i].key);
+    }
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, ATLAS_MAGIC, sizeof(header.magic));
+    header.version = ATLAS_VERSION;
+    header.tileSize = static_cast<quint32>(tileSize);
+    header.levels = static_cast<quint32>(levels);
+    header.count = static_cast<quint32>(sources.size());
+    header.stringsSize = static_cast<quint32>(strings.size());
+    header.indexOffset = sizeof(FileHeader);
+    header.stringsOffset = header.indexOffset + sizeof(IndexEntry) * sources.size();
+    qint64 offset = static_cast<qint64>(header.stringsOffset) + strings.size();
+    for (int level = 0; level < levels; ++level) {
+        offset = alignUp(offset, LEVEL_ALIGNMENT);
+        header.levelOffsets[level] = static_cast<quint64>(offset);
+        const qint64 side = tileSize >> level;
+        offset += side * side * 4 * static_cast<qint64>(sources.size());
+    }
+    const qint64 totalSize = std::max<qint64>(offset, 1);
+
+    // --- Write: size the file, map it, and let workers fill tiles in place ---
+    QDir().mkpath(QFileInfo(atlasPath).absolutePath());
+    const QString tmpPath = atlasPath + ".part";
+    QFile out(tmpPath);
+    if (!out.open(QIODevice::ReadWrite | QIODevice::Truncate) || !out.resize(totalSize)) {
+        qWarning() << "Thumbnail atlas: cannot create" << tmpPath << "-" << out.errorString();
+        return false;
+    }
+    uchar* base = out.map(0, totalSize);
+    if (!base) {
+        qWarning() << "Thumbnail atlas: cannot map" << tmpPath << "-" << out.errorString();
+        out.remove();
+        return false;
+    }
+    std::memcpy(base, &header, sizeof(header));
+    if (!index.empty()) {
+        std::memcpy(base + header.indexOffset, index.data(), sizeof(IndexEntry) * index.size());
+    }
+    std::memcpy(base + header.stringsOffset, strings.constData(), static_cast<size_t>(strings.size()));
+
+    std::atomic<int> next(0);
+    std::atomic<int> decoded(0);
+    std::atomic<int> missing(0);
+    std::atomic<int> reused(0);
+    auto worker = [&]() {
+        for (int i = next++; i < static_cast<int>(sources.size()); i = next++) {
+            const Source& source = sources[i];
+            if (source.previous >= 0) {
+                for (int level = 0; level < levels; ++level) {
+                    const size_t bytes = static_cast<size_t>(tileSize >> level) * (tileSize >> level) * 4;
+                    std::memcpy(base + header.levelOffsets[level] + bytes * i,
+                                previous.tiles(level, source.previous), bytes);
+                }
+                if (index[i].flags & FLAG_NO_PREVIEW) {
+                    missing++;
+                } else {
+                    reused++;
+                }
+                continue;
+            }
+            uchar* tile = base + header.levelOffsets[0] + static_cast<size_t>(tileSize) * tileSize * 4 * i;
+            if (source.missing || !decodeTile(source.jpgPath, tileSize, tile)) {
+                std::memset(tile, MISSING_GRAY, static_cast<size_t>(tileSize) * tileSize * 4);
+                reinterpret_cast<IndexEntry*>(base + header.indexOffset)[i].flags |= FLAG_NO_PREVIEW;
+                missing++;
+            } else {
+                decoded++;
+            }
+            for (int level = 1; level < levels; ++level) {
+                const size_t srcSide = static_cast<size_t>(tileSize >> (level - 1));
+                const uchar* src = base + header.levelOffsets[level - 1] + srcSide * srcSide * 4 * i;
+                uchar* dst = base + header.levelOffsets[level] + (srcSide / 2) * (srcSide / 2) * 4 * i;
+                downsample(src, static_cast<int>(srcSide), dst);
+            }
+        }
+    };
+
+    // Own pool so a long build never starves the global one (decode cache etc.)
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    for (int t = 0; t < pool.maxThreadCount(); ++t) {
+        pool.start(worker);
+    }
+    pool.waitForDone();
+
+    result.decoded = decoded;
+    result.missing = missing;
+    result.reused = reused;
+
+    out.unmap(base);
+    out.close();
+    previous.close();
+    QFile::remove(atlasPath);
+    if (!QFile::rename(tmpPath, atlasPath)) {
+        qWarning() << "Thumbnail atlas: could not finalize" << atlasPath;
+        QFile::remove(tmpPath);
+        return false;
+    }
+
+    result.elapsedMs = timer.elapsed();
+    qInfo() << "Thumbnail atlas:" << result.entries << "presets," << result.decoded << "decoded,"
+            << result.reused << "reused," << result.missing << "without preview, in" << result.elapsedMs
+            << "ms on" << pool.maxThreadCount() << "threads," << (totalSize >> 20) << "MB";
+    return true;
+}
+
+ThumbnailAtlas::~ThumbnailAtlas()
+{
+    close();
+}
+
+bool ThumbnailAtlas::open(const QString& path)
+{
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Thumbnail atlas: cannot open" << path << "-" << m_file.errorString();
+        return false;
+    }
+    m_size = m_file.size();
+    if (m_size < static_cast<qint64>(sizeof(FileHeader))) {
+        qWarning() << "Thumbnail atlas: file too small" << path;
+        close();
+        return false;
+    }
+    m_data = m_file.map(0, m_size);
+    if (!m_data) {
+        qWarning() << "Thumbnail atlas: cannot map" << path << "-" << m_file.errorString();
+        close();
+        return false;
+    }
+
+    // Offsets are checked as "fits in what's left" so a corrupt header can't
+    // wrap the arithmetic; lookups after this trust the index.
+    const FileHeader* header = reinterpret_cast<const FileHeader*>(m_data);
+    const quint64 size = static_cast<quint64>(m_size);
+    bool valid = std::memcmp(header->magic, ATLAS_MAGIC, sizeof(header->magic)) == 0 &&
+                 header->version == ATLAS_VERSION && header->levels > 0 &&
+                 header->levels <= static_cast<quint32>(MAX_LEVELS) &&
+                 header->tileSize <= MAX_TILE_SIZE && (header->tileSize >> (header->levels - 1)) > 0 &&
+                 header->indexOffset >= sizeof(FileHeader) && header->indexOffset <= size &&
+                 header->count <= (size - header->indexOffset) / sizeof(IndexEntry) &&
+                 header->stringsOffset <= size && header->stringsSize <= size - header->stringsOffset;
+    for (quint32 level = 0; valid && level < header->levels; ++level) {
+        const quint64 side = header->tileSize >> level;
+        const quint64 offset = header->levelOffsets[level];
+        valid = offset <= size && header->count <= (size - offset) / (side * side * 4);
+    }
+    if (valid) {
+        const IndexEntry* entries = reinterpret_cast<const IndexEntry*>(m_data + header->indexOffset);
+        for (quint32 i = 0; valid && i < header->count; ++i) {
+            valid = entries[i].keyOffset <= header->stringsSize &&
+                    entries[i].keyLength <= header->stringsSize - entries[i].keyOffset;
+        }
+    }
+    if (!valid) {
+        qWarning() << "Thumbnail atlas: invalid or outdated file" << path;
+        close();
+        return false;
+    }
+
+    m_header = header;
+    m_count = static_cast<int>(header->count);
+    m_tileSize = static_cast<int>(header->tileSize);
+    m_levels = static_cast<int>(header->levels);
+    return true;
+}
+
+void ThumbnailAtlas::close()
+{
+    if (m_data) {
+        m_file.unmap(const_cast<uchar*>(m_data));
+    }
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+    m_data = nullptr;
+    m_header = nullptr;
+    m_size = 0;
+    m_count = 0;
+    m_tileSize = 0;
+    m_levels = 0;
+}
+
+const ThumbnailAtlas::IndexEntry* ThumbnailAtlas::entry(int index) const
+{
+    return reinterpret_cast<const IndexEntry*>(m_data + m_header->indexOffset) + index;
+}
+
+int ThumbnailAtlas::indexOf(const QString& relativePath) const
+{
+    if (!isOpen()) {
+        return -1;
+    }
+    const QByteArray key = relativePath.toUtf8();
+    const char* strings = reinterpret_cast<const char*>(m_data + m_header->stringsOffset);
+    int lo = 0;
+    int hi = m_count;
+    while (lo < hi) {
+        const int mid = lo + (hi - lo) / 2;
+        const IndexEntry* e = entry(mid);
+        const int c = keyCompare(strings + e->keyOffset, static_cast<int>(e->keyLength), key);
+        if (c == 0) {
+            return mid;
+        }
+        if (c < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return -1;
+}
+
+QString ThumbnailAtlas::pathAt(int index) const
+{
+    if (index < 0 || index >= m_count) {
+        return QString();
+    }
+    const IndexEntry* e = entry(index);
+    const char* strings = reinterpret_cast<const char*>(m_data + m_header->stringsOffset);
+    return QString::fromUtf8(strings + e->keyOffset, static_cast<qsizetype>(e->keyLength));
+}
+
+bool ThumbnailAtlas::hasPreview(int index) const
+{
+    return index >= 0 && index < m_count && (entry(index)->flags & FLAG_NO_PREVIEW) == 0;
+}
+
+const uchar* ThumbnailAtlas::tiles(int level, int first) const
+{
+    if (!isOpen() || level < 0 || level >= m_levels || first < 0 || first >= m_count) {
+        return nullptr;
+    }
+    const size_t side = static_cast<size_t>(levelSize(level));
+    return m_data + m_header->levelOffsets[level] + side * side * 4 * first;
+}
+
+void ThumbnailAtlas::prefetch(int first, int count) const
+{
+#ifdef Q_OS_UNIX
+    if (!isOpen() || first < 0 || count <= 0) {
+        return;
+    }
+    count = std::min(count, m_count - first);
+    const qint64 page = sysconf(_SC_PAGESIZE);
+    for (int level = 0; level < m_levels; ++level) {
+        const qint64 side = levelSize(level);
+        const qint64 start = static_cast<qint64>(tiles(level, first) - m_data);
+        const qint64 end = start + side * side * 4 * count;
+        const qint64 alignedStart = start / page * page;
+        madvise(const_cast<uchar*>(m_data) + alignedStart, static_cast<size_t>(end - alignedStart), MADV_WILLNEED);
+    }
+#else
+    Q_UNUSED(first);
+    Q_UNUSED(count);
+#endif
+}
@@ -0,0 +1,81 @@
+#ifndef THUMBNAILATLAS_H
+#define THUMBNAILATLAS_H
+
+#include <QFile>
+#include <QString>
+#include <QtGlobal>
+
+// All preset preview .jpgs decoded once into fixed-size RGBA tiles with a
+// full mip chain, packed into one file that is memory-mapped at runtime.
+// Tiles are stored level-major (every tile's level 0, then every level 1,
+// ...), so a run of consecutive presets is one contiguous block per level
+// and can be paged in, and handed to glTexSubImage3D, with one call per
+// level instead of decoding hundreds of JPEGs.
+//
+// Layout: FileHeader | IndexEntry[count] sorted by key | key strings |
+// level 0 tiles | level 1 tiles | ... with each level page aligned.
+// Keys are preset paths relative to the preset root, '/'-separated.
+class ThumbnailAtlas
+{
+public:
+    static constexpr int DEFAULT_TILE_SIZE = 64;
+
+    struct BuildStats {
+        int entries = 0;
+        int decoded = 0;     // JPEGs decoded this run
+        int reused = 0;      // previews copied from the previous atlas
+        int missing = 0;     // presets without a preview image, or whose image didn't decode
+        bool upToDate = false;
+        qint64 elapsedMs = 0;
+    };
+
+    // Scans presetRoot for .milk files and their sibling .jpg and writes the
+    // atlas, decoding on all cores. Tiles of presets whose .jpg has the same
+    // size and mtime as in the existing atlas are copied instead of decoded,
+    // and the file isn't rewritten at all if nothing changed.
+    static bool build(const QString& presetRoot, const QString& atlasPath,
+                      int tileSize = DEFAULT_TILE_SIZE, BuildStats* stats = nullptr);
+    static QString defaultPath();
+
+    ThumbnailAtlas() = default;
+    ~ThumbnailAtlas();
+    ThumbnailAtlas(const ThumbnailAtlas&) = delete;
+    ThumbnailAtlas& operator=(const ThumbnailAtlas&) = delete;
+
+    bool open(const QString& path);
+    void close();
+    bool isOpen() const { return m_data != nullptr; }
+
+    int count() const { return m_count; }
+    int tileSize() const { return m_tileSize; }
+    int levels() const { return m_levels; }
+    int levelSize(int level) const { return m_tileSize >> level; }
+
+    // Index of a preset by its path relative to the preset root, or -1.
+    int indexOf(const QString& relativePath) const;
+    QString pathAt(int index) const;
+    bool hasPreview(int index) const;
+
+    // Tightly packed RGBA8888 pixels starting at tile `first` of `level`;
+    // following tiles of the same level come right after.
+    const uchar* tiles(int level, int first) const;
+
+    // Asks the kernel to page in tiles [first, first + count) at every level.
+    void prefetch(int first, int count) const;
+
+private:
+    struct FileHeader;
+    struct IndexEntry;
+
+    const IndexEntry* entry(int index) const;
+
+    QFile m_file;
+    const uchar* m_data = nullptr;
+    qint64 m_size = 0;
+    int m_count = 0;
+    int m_tileSize = 0;
+    int m_levels = 0;
+    const FileHeader* m_header = nullptr;
+};
+
+#endif // THUMBNAILATLAS_H
@@ -0,0 +1,483 @@
+#include "waveformpeaks.h"
+#include "audiofilereader.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WAVEFORMPEAKS_SSE2 1
+#endif
+
+const char PEAKS_MAGIC[4] = {'M', 'V', 'P', 'K'};
+const quint32 PEAKS_VERSION = 2;        // 2: tail buckets of the upper levels fixed
+const size_t READ_CHUNK_FRAMES = 32768;
+const size_t PUBLISH_BUCKETS = 256;        // level 0 buckets reduced between publishes
+const int MAX_LEVELS = 32;
+
+struct PeaksFileHeader {
+    char magic[4];
+    quint32 version;
+    quint32 sampleRate;
+    quint32 baseBucketFrames;
+    qint64 totalFrames;
+    quint32 levels;
+    quint32 reserved;
+    // followed by quint64 bucket counts[levels], then each level's buckets
+};
+
+namespace {
+
+struct Accumulator {
+    float min = 0.0f;
+    float max = 0.0f;
+    double sumSquares = 0.0;
+    size_t samples = 0;
+};
+
+qint16 quantize(float value)
+{
+    return static_cast<qint16>(std::lrint(std::min(1.0f, std::max(-1.0f, value)) * 32767.0f));
+}
+
+WaveformPeaks::Bucket toBucket(const Accumulator& acc)
+{
+    WaveformPeaks::Bucket bucket;
+    bucket.min = quantize(acc.min);
+    bucket.max = quantize(acc.max);
+    bucket.rms = quantize(static_cast<float>(std::sqrt(acc.sumSquares / std::max<size_t>(acc.samples, 1))));
+    return bucket;
+}
+
+// Hash of the whole file: stable across renames and copies, and any edit
+// changes it. Runs on the worker, never on the GUI thread.
+QString contentKey(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if (!hash.addData(&file)) {
+        return QString();
+    }
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+}
+
+QString WaveformPeaks::cacheDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/peaks";
+}
+
+std::shared_ptr<WaveformPeaks> WaveformPeaks::open(const QString& path)
+{
+    auto peaks = std::make_shared<WaveformPeaks>();
+    QThreadPool::globalInstance()->start([peaks, path]() {
+        const QString key = contentKey(path);
+        if (key.isEmpty()) {
+            qWarning() << "Waveform peaks: cannot read" << path;
+            peaks->finish();
+            return;
+        }
+        const QString cachePath = cacheDir() + "/" + key + ".peaks";
+        if (peaks->loadCache(cachePath)) {
+            return;
+        }
+        peaks->extract(path, cachePath);
+    });
+    return peaks;
+}
+
+void WaveformPeaks::reduce(const float* samples, size_t count, float* minOut, float* maxOut, float* sumSquaresOut)
+{
+    float lo = std::numeric_limits<float>::max();
+    float hi = std::numeric_limits<float>::lowest();
+    float sumSquares = 0.0f;
+    size_t i = 0;
+#ifdef WAVEFORMPEAKS_SSE2
+    if (count >= 8) {
+        __m128 vmin = _mm_set1_ps(lo);
+        __m128 vmax = _mm_set1_ps(hi);
+        __m128 vsum0 = _mm_setzero_ps();
+        __m128 vsum1 = _mm_setzero_ps();
+        for (; i + 8 <= count; i += 8) {
+            const __m128 a = _mm_loadu_ps(samples + i);
+            const __m128 b = _mm_loadu_ps(samples + i + 4);
+            vmin = _mm_min_ps(vmin, _mm_min_ps(a, b));
+            vmax = _mm_max_ps(vmax, _mm_max_ps(a, b));
+            vsum0 = _mm_add_ps(vsum0, _mm_mul_ps(a, a));
+            vsum1 = _mm_add_ps(vsum1, _mm_mul_ps(b, b));
+        }
+        alignas(16) float mins[4];
+        alignas(16) float maxs[4];
+        alignas(16) float sums[4];
+        _mm_store_ps(mins, vmin);
+        _mm_store_ps(maxs, vmax);
+        _mm_store_ps(sums, _mm_add_ps(vsum0, vsum1));
+        for (int lane = 0; lane < 4; ++lane) {
+            lo = std::min(lo, mins[lane]);
+            hi = std::max(hi, maxs[lane]);
+            sumSquares += sums[lane];
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        lo = std::min(lo, samples[i]);
+        hi = std::max(hi, samples[i]);
+        sumSquares += samples[i] * samples[i];
+    }
+    *minOut = count > 0 ? lo : 0.0f;
+    *maxOut = count > 0 ? hi : 0.0f;
+    *sumSquaresOut = sumSquares;
+}
+
+WaveformPeaks::Bucket WaveformPeaks::merge(const Bucket& a, const Bucket& b)
+{
+    Bucket merged;
+    merged.min = std::min(a.min, b.min);
+    merged.max = std::max(a.max, b.max);
+    const double squares = (double(a.rms) * a.rms + double(b.rms) * b.rms) / 2.0;
+    merged.rms = static_cast<qint16>(std::lrint(std::sqrt(squares)));
+    return merged;
+}
+
+// Runs on the thread pool. Reduces stereo samples straight from the reader
+// into level 0 buckets (both channels together, so the envelope covers
+// either), publishing them in batches.
+void WaveformPeaks::extract(const QString& path, const QString& cachePath)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    AudioFileReader reader;
+    if (!reader.open(path, READ_CHUNK_FRAMES) || reader.sampleRate() <= 0) {
+        qWarning() << "Waveform peaks: cannot decode" << path;
+        finish();
+        return;
+    }
+    {
+        QMutexLocker locker(&m_mutex);
+        m_totalFrames = reader.length() * SAMPLE_RATE / reader.sampleRate();
+        m_levels.resize(1);
+        m_levels[0].reserve(static_cast<size_t>(m_totalFrames / BASE_BUCKET_FRAMES + 2));
+    }
+
+    const size_t bucketSamples = static_cast<size_t>(BASE_BUCKET_FRAMES) * 2;
+    Accumulator acc;
+    std::vector<Bucket> batch;
+    batch.reserve(PUBLISH_BUCKETS);
+    qint64 frames = 0;
+    while (!m_cancelled) {
+        size_t got = 0;
+        const float* stereo = reader.readChunk(&got);
+        if (got == 0) {
+            break;
+        }
+        frames += static_cast<qint64>(got);
+        const size_t count = got * 2;
+        size_t offset = 0;
+        while (offset < count) {
+            const size_t take = std::min(count - offset, bucketSamples - acc.samples);
+            float lo = 0.0f;
+            float hi = 0.0f;
+            float sumSquares = 0.0f;
+            reduce(stereo + offset, take, &lo, &hi, &sumSquares);
+            acc.min = acc.samples == 0 ? lo : std::min(acc.min, lo);
+            acc.max = acc.samples == 0 ? hi : std::max(acc.max, hi);
+            acc.sumSquares += sumSquares;
+            acc.samples += take;
+            offset += take;
+            if (acc.samples == bucketSamples) {
+                batch.push_back(toBucket(acc));
+                acc = Accumulator();
+                if (batch.size() == PUBLISH_BUCKETS) {
+                    append(batch.data(), batch.size());
+                    batch.clear();
+                }
+            }
+        }
+    }
+    if (acc.samples > 0) {
+        batch.push_back(toBucket(acc));
+    }
+    append(batch.data(), batch.size());
+
+    const bool cancelled = m_cancelled;
+    if (!cancelled) {
+        QMutexLocker locker(&m_mutex);
+        m_totalFrames = frames;
+    }
+    finish();
+    if (cancelled) {
+        return;
+    }
+    writeCache(cachePath);
+    qInfo() << "Waveform peaks:" << frames << "frames of" << QFileInfo(path).fileName() << "in"
+            << timer.elapsed() << "ms";
+}
+
+// Pushes level 0 buckets and carries completed pairs up the pyramid.
+void WaveformPeaks::append(const Bucket* buckets, size_t count)
+{
+    QMutexLocker locker(&m_mutex);
+    for (size_t i = 0; i < count; ++i) {
+        Bucket carry = buckets[i];
+        for (size_t level = 0; level < MAX_LEVELS; ++level) {
+            if (m_levels.size() <= level) {
+                m_levels.emplace_back();
+            }
+            std::vector<Bucket>& levelBuckets = m_levels[level];
+            levelBuckets.push_back(carry);
+            if (levelBuckets.size() % 2 != 0) {
+                break;
+            }
+            carry = merge(levelBuckets[levelBuckets.size() - 2], levelBuckets.back());
+        }
+    }
+}
+
+// Rebuilds the last bucket of every level above 0 from the level below, so
+// every level spans the whole track, and marks the pyramid complete. A level
+// that became even from a carried bucket merges its last pair like append()
+// does for complete ones.
+void WaveformPeaks::finish()
+{
+    QMutexLocker locker(&m_mutex);
+    for (size_t level = 0; level < m_levels.size() && level + 1 < MAX_LEVELS; ++level) {
+        const std::vector<Bucket>& below = m_levels[level];
+        const size_t size = below.size();
+        if (size <= 1) {
+            break;
+        }
+        const Bucket last = size % 2 == 0 ? merge(below[size - 2], below[size - 1]) : below[size - 1];
+        if (m_levels.size() <= level + 1) {
+            m_levels.emplace_back();
+        }
+        std::vector<Bucket>& above = m_levels[level + 1];
+        above.resize((size + 1) / 2 - 1);
+        above.push_back(last);
+    }
+    m_complete = true;
+}
+
+bool WaveformPeaks::checkPyramid(int maxBuckets)
+{
+    for (int count = 1; count <= maxBuckets; ++count) {
+        std::vector<Bucket> base(static_cast<size_t>(count));
+        for (int i = 0; i < count; ++i) {
+            // deterministic, uneven values so a wrong tail shows in all three
+            base[i].min = static_cast<qint16>(-((i * 7919) % 30000) - 1);
+            base[i].max = static_cast<qint16>((i * 104729) % 30000 + 1);
+            base[i].rms = static_cast<qint16>((i * 613) % 20000);
+        }
+        WaveformPeaks peaks;
+        // in uneven batches, like extraction publishes them
+        for (int first = 0; first < count; first += 5) {
+            peaks.append(base.data() + first, static_cast<size_t>(std::min(5, count - first)));
+        }
+        peaks.finish();
+
+        // Reference: each level straight from the one below, min/max also
+        // straight from the level 0 buckets the bucket covers
+        std::vector<Bucket> expected = base;
+        for (size_t level = 0; level < MAX_LEVELS; ++level) {
+            const std::vector<Bucket>& actual = level < peaks.m_levels.size() ? peaks.m_levels[level]
+                                                                              : std::vector<Bucket>();
+            if (actual.size() != expected.size()) {
+                qWarning() << "Peak pyramid of" << count << "buckets: level" << level << "has" << actual.size()
+                           << "buckets, expected" << expected.size();
+                return false;
+            }
+            const size_t span = size_t(1) << level;
+            for (size_t j = 0; j < actual.size(); ++j) {
+                qint16 lo = std::numeric_limits<qint16>::max();
+                qint16 hi = std::numeric_limits<qint16>::min();
+                for (size_t k = j * span; k < std::min((j + 1) * span, base.size()); ++k) {
+                    lo = std::min(lo, base[k].min);
+                    hi = std::max(hi, base[k].max);
+                }
+                if (actual[j].min != lo || actual[j].max != hi || actual[j].rms != expected[j].rms) {
+                    qWarning() << "Peak pyramid of" << count << "buckets: level" << level << "bucket" << j
+                               << "is wrong";
+                    return false;
+                }
+            }
+            if (expected.size() <= 1) {
+                break;
+            }
+            std::vector<Bucket> next;
+            for (size_t j = 0; j < expected.size(); j += 2) {
+                next.push_back(j + 1 < expected.size() ? merge(expected[j], expected[j + 1]) : expected[j]);
+            }
+            expected = std::move(next);
+        }
+    }
+    return true;
+}
+
+qint64 WaveformPeaks::extractedFrames() const
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_complete) {
+        return m_totalFrames;
+    }
+    return m_levels.empty() ? 0 : static_cast<qint64>(m_levels[0].size()) * BASE_BUCKET_FRAMES;
+}
+
+qint64 WaveformPeaks::totalFrames() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_totalFrames;
+}
+
+void WaveformPeaks::query(qint64 startFrame, qint64 endFrame, int columns, Column* out) const
+{
+    std::fill(out, out + std::max(columns, 0), Column());
+    QMutexLocker locker(&m_mutex);
+    if (columns <= 0 || endFrame <= startFrame || m_levels.empty()) {
+        return;
+    }
+
+    // Coarsest level with at least two buckets per column, so the edge
+    // buckets that straddle a column boundary stay a small overreach
+    const double framesPerColumn = static_cast<double>(endFrame - startFrame) / columns;
+    size_t level = 0;
+    while (level + 1 < m_levels.size() && !m_levels[level + 1].empty() &&
+           static_cast<double>(qint64(BASE_BUCKET_FRAMES) << (level + 2)) <= framesPerColumn) {
+        level++;
+    }
+    const std::vector<Bucket>& buckets = m_levels[level];
+    const double bucketFrames = static_cast<double>(qint64(BASE_BUCKET_FRAMES) << level);
+    const qint64 available = static_cast<qint64>(buckets.size());
+
+    for (int c = 0; c < columns; ++c) {
+        const double from = startFrame + c * framesPerColumn;
+        const qint64 first = std::max<qint64>(0, static_cast<qint64>(std::floor(from / bucketFrames)));
+        const qint64 last = std::min(available, std::max(first + 1, static_cast<qint64>(std::ceil((from + framesPerColumn) / bucketFrames))));
+        if (first >= last) {
+            continue;
+        }
+        qint16 lo = buckets[static_cast<size_t>(first)].min;
+        qint16 hi = buckets[static_cast<size_t>(first)].max;
+        double squares = 0.0;
+        for (qint64 b = first; b < last; ++b) {
+            const Bucket& bucket = buckets[static_cast<size_t>(b)];
+            lo = std::min(lo, bucket.min);
+            hi = std::max(hi, bucket.max);
+            squares += double(bucket.rms) * bucket.rms;
+        }
+        Column& column = out[c];
+        column.min = lo / 32767.0f;
+        column.max = hi / 32767.0f;
+        column.rms = static_cast<float>(std::sqrt(squares / static_cast<double>(last - first)) / 32767.0);
+        column.valid = true;
+    }
+}
+
+bool WaveformPeaks::loadCache(const QString& cachePath)
+{
+    QFile file(cachePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    PeaksFileHeader header;
+    if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header) ||
+        std::memcmp(header.magic, PEAKS_MAGIC, sizeof(header.magic)) != 0 || header.version != PEAKS_VERSION ||
+        header.sampleRate != SAMPLE_RATE || header.baseBucketFrames != BASE_BUCKET_FRAMES ||
+        header.levels == 0 || header.levels > MAX_LEVELS) {
+        qWarning() << "Waveform peaks: ignoring stale cache" << cachePath;
+        return false;
+    }
+    std::vector<quint64> counts(header.levels);
+    const qint64 countBytes = static_cast<qint64>(sizeof(quint64) * counts.size());
+    if (file.read(reinterpret_cast<char*>(counts.data()), countBytes) != countBytes) {
+        return false;
+    }
+    // Each level must halve the one below (rounding up), as finish() leaves
+    // it, and the buckets must exactly fill the rest of the file; checked
+    // before any multiplication so a corrupt count can't overflow
+    quint64 remaining = static_cast<quint64>(file.size() - file.pos()) / sizeof(Bucket);
+    for (size_t level = 0; level < counts.size(); ++level) {
+        if (counts[level] > remaining || (level > 0 && counts[level] != (counts[level - 1] + 1) / 2)) {
+            qWarning() << "Waveform peaks: ignoring corrupt cache" << cachePath;
+            return false;
+        }
+        remaining -= counts[level];
+    }
+    if (remaining != 0 || static_cast<quint64>(file.size() - file.pos()) % sizeof(Bucket) != 0) {
+        qWarning() << "Waveform peaks: ignoring corrupt cache" << cachePath;
+        return false;
+    }
+    std::vector<std::vector<Bucket>> levels(header.levels);
+    for (size_t level = 0; level < levels.size(); ++level) {
+        const qint64 bytes = static_cast<qint64>(counts[level] * sizeof(Bucket));
+        levels[level].resize(static_cast<size_t>(counts[level]));
+        if (file.read(reinterpret_cast<char*>(levels[level].data()), bytes) != bytes) {
+            return false;
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_levels = std::move(levels);
+    m_totalFrames = header.totalFrames;
+    m_complete = true;
+    return true;
+}
+
+bool WaveformPeaks::writeCache(const QString& cachePath) const
+{
+    QDir().mkpath(QFileInfo(cachePath).absolutePath());
+    // Write under a temporary name so a half-written cache is never picked up
+    const QString tmpPath = cachePath + ".part";
+    QFile file(tmpPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Waveform peaks: cannot create" << tmpPath << "-" << file.errorString();
+        return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    PeaksFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, PEAKS_MAGIC, sizeof(header.magic));
+    header.version = PEAKS_VERSION;
+    header.sampleRate = SAMPLE_RATE;
+    header.baseBucketFrames = BASE_BUCKET_FRAMES;
+    header.totalFrames = m_totalFrames;
+    header.levels = static_cast<quint32>(m_levels.size());
+    bool ok = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header);
+    for (const std::vector<Bucket>& buckets : m_levels) {
+        const quint64 count = buckets.size();
+        ok = ok && file.write(reinterpret_cast<const char*>(&count), sizeof(count)) == sizeof(count);
+    }
+    for (const std::vector<Bucket>& buckets : m_levels) {
+        const qint64 bytes = static_cast<qint64>(buckets.size() * sizeof(Bucket));
+        ok = ok && file.write(reinterpret_cast<const char*>(buckets.data()), bytes) == bytes;
+    }
+    locker.unlock();
+    file.close();
+
+    if (!ok) {
+        qWarning() << "Waveform peaks: failed writing" << tmpPath;
+        QFile::remove(tmpPath);
+        return false;
+    }
+    QFile::remove(cachePath);
+    if (!QFile::rename(tmpPath, cachePath)) {
+        QFile::remove(tmpPath);
+        return false;
+    }
+    return true;
+}
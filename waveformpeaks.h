@@ -0,0 +1,77 @@
+#ifndef WAVEFORMPEAKS_H
+#define WAVEFORMPEAKS_H
+
+#include <QMutex>
+#include <QString>
+#include <QtGlobal>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Min/max/RMS overview of a track as a pyramid: level 0 has one bucket per
+// BASE_BUCKET_FRAMES frames of 44.1 kHz stereo, every level above merges
+// pairs of the one below. A query for N columns picks the level whose
+// buckets are closest to one column wide, so drawing costs O(columns) at
+// any zoom regardless of track length.
+//
+// open() returns at once and hashes the file on the global thread pool. A
+// cached pyramid (keyed by that hash, under the user cache directory) is
+// complete as soon as it is read; otherwise the track is decoded there too
+// and buckets become visible as they are reduced, so the overview fills in
+// from the left while extraction runs.
+class WaveformPeaks
+{
+public:
+    static constexpr int BASE_BUCKET_FRAMES = 512;
+    static constexpr int SAMPLE_RATE = 44100;
+
+    struct Bucket {
+        qint16 min = 0;
+        qint16 max = 0;
+        qint16 rms = 0;
+    };
+
+    // One drawn column, in [-1, 1]. `valid` is false past what's extracted.
+    struct Column {
+        float min = 0.0f;
+        float max = 0.0f;
+        float rms = 0.0f;
+        bool valid = false;
+    };
+
+    static std::shared_ptr<WaveformPeaks> open(const QString& path);
+    static QString cacheDir();
+
+    // Stops a background extraction early; the partial pyramid stays usable.
+    void cancel() { m_cancelled = true; }
+    bool isComplete() const { return m_complete; }
+    // Extracted / expected length in frames (expected is an estimate until complete).
+    qint64 extractedFrames() const;
+    qint64 totalFrames() const;
+
+    // Fills `columns` entries of `out` for [startFrame, endFrame).
+    void query(qint64 startFrame, qint64 endFrame, int columns, Column* out) const;
+
+    // SIMD min/max/sum of squares over `count` floats; exposed for the benchmark.
+    static void reduce(const float* samples, size_t count, float* minOut, float* maxOut, float* sumSquaresOut);
+    // Builds pyramids from 1..maxBuckets level 0 buckets the way extraction
+    // does and checks every level against a reduction straight from level 0.
+    static bool checkPyramid(int maxBuckets);
+
+private:
+    void extract(const QString& path, const QString& cachePath);
+    void append(const Bucket* buckets, size_t count);
+    void finish();
+    bool loadCache(const QString& cachePath);
+    bool writeCache(const QString& cachePath) const;
+
+    static Bucket merge(const Bucket& a, const Bucket& b);
+
+    mutable QMutex m_mutex;                  // guards m_levels and m_totalFrames
+    std::vector<std::vector<Bucket>> m_levels;
+    qint64 m_totalFrames = 0;
+    std::atomic<bool> m_complete{false};
+    std::atomic<bool> m_cancelled{false};
+};
+
+#endif // WAVEFORMPEAKS_H
@@ -0,0 +1,172 @@
+#include "waveformseekbar.h"
+
+#include <QMouseEvent>
+#include <QPainter>
+#include <QWheelEvent>
+#include <algorithm>
+#include <cmath>
+
+const int PROGRESS_REPAINT_MS = 100;
+const qint64 MIN_VIEW_SPAN_MS = 1000;
+const double WHEEL_ZOOM_STEP = 1.25;        // per 15 degree wheel notch
+
+WaveformSeekBar::WaveformSeekBar(QWidget *parent)
+    : QWidget(parent)
+{
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    setToolTip(tr("Position (wheel to zoom, double-click for the whole track)"));
+
+    m_progressTimer.setInterval(PROGRESS_REPAINT_MS);
+    connect(&m_progressTimer, &QTimer::timeout, this, [this]() {
+        if (!m_peaks || m_peaks->isComplete()) {
+            m_progressTimer.stop();
+        }
+        update();
+    });
+}
+
+void WaveformSeekBar::setPeaks(std::shared_ptr<WaveformPeaks> peaks)
+{
+    m_peaks = std::move(peaks);
+    m_viewStartMs = 0;
+    m_viewSpanMs = 0;
+    if (m_peaks && !m_peaks->isComplete()) {
+        m_progressTimer.start();
+    }
+    update();
+}
+
+void WaveformSeekBar::setDuration(qint64 ms)
+{
+    m_durationMs = std::max<qint64>(ms, 0);
+    setView(m_viewStartMs, m_viewSpanMs);
+    update();
+}
+
+void WaveformSeekBar::setPosition(qint64 ms)
+{
+    const double oldX = xAt(m_positionMs);
+    m_positionMs = ms;
+    // Zoomed in: page along with playback
+    if (m_viewSpanMs > 0 && (ms < m_viewStartMs || ms >= m_viewStartMs + m_viewSpanMs)) {
+        setView(ms, m_viewSpanMs);
+        update();
+        return;
+    }
+    const double newX = xAt(ms);
+    if (std::lround(oldX) != std::lround(newX)) {
+        update();
+    }
+}
+
+void WaveformSeekBar::setView(qint64 startMs, qint64 spanMs)
+{
+    if (spanMs <= 0 || spanMs >= m_durationMs) {
+        m_viewStartMs = 0;
+        m_viewSpanMs = 0;
+        return;
+    }
+    m_viewSpanMs = std::max(spanMs, MIN_VIEW_SPAN_MS);
+    m_viewStartMs = std::clamp<qint64>(startMs, 0, std::max<qint64>(0, m_durationMs - m_viewSpanMs));
+}
+
+qint64 WaveformSeekBar::msAt(double x) const
+{
+    const qint64 span = m_viewSpanMs > 0 ? m_viewSpanMs : m_durationMs;
+    const double fraction = std::clamp(x / std::max(width(), 1), 0.0, 1.0);
+    return m_viewStartMs + static_cast<qint64>(fraction * span);
+}
+
+double WaveformSeekBar::xAt(qint64 ms) const
+{
+    const qint64 span = m_viewSpanMs > 0 ? m_viewSpanMs : m_durationMs;
+    if (span <= 0) {
+        return 0.0;
+    }
+    return static_cast<double>(ms - m_viewStartMs) * width() / span;
+}
+
+void WaveformSeekBar::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    const QPalette& pal = palette();
+    painter.fillRect(rect(), pal.color(QPalette::Base));
+
+    const int w = width();
+    const int h = height();
+    const double mid = h / 2.0;
+    const int playedX = static_cast<int>(std::lround(xAt(m_positionMs)));
+
+    if (m_peaks && m_durationMs > 0 && w > 0) {
+        const qint64 span = m_viewSpanMs > 0 ? m_viewSpanMs : m_durationMs;
+        const qint64 startFrame = m_viewStartMs * WaveformPeaks::SAMPLE_RATE / 1000;
+        const qint64 endFrame = (m_viewStartMs + span) * WaveformPeaks::SAMPLE_RATE / 1000;
+        m_columns.resize(static_cast<size_t>(w));
+        m_peaks->query(startFrame, endFrame, w, m_columns.data());
+
+        const QColor played = pal.color(QPalette::Highlight);
+        const QColor unplayed = pal.color(QPalette::Mid);
+        for (int x = 0; x < w; ++x) {
+            const WaveformPeaks::Column& column = m_columns[static_cast<size_t>(x)];
+            if (!column.valid) {
+                continue;
+            }
+            const QColor color = x < playedX ? played : unplayed;
+            painter.setPen(color.lighter(130));
+            painter.drawLine(x, static_cast<int>(mid - column.max * mid), x, static_cast<int>(mid - column.min * mid));
+            painter.setPen(color);
+            painter.drawLine(x, static_cast<int>(mid - column.rms * mid), x, static_cast<int>(mid + column.rms * mid));
+        }
+    } else {
+        painter.setPen(pal.color(QPalette::Mid));
+        painter.drawLine(0, static_cast<int>(mid), w, static_cast<int>(mid));
+    }
+
+    if (m_durationMs > 0 && playedX >= 0 && playedX < w) {
+        painter.setPen(pal.color(QPalette::Text));
+        painter.drawLine(playedX, 0, playedX, h);
+    }
+}
+
+void WaveformSeekBar::seekTo(double x)
+{
+    if (m_durationMs > 0) {
+        emit seekRequested(msAt(x));
+    }
+}
+
+void WaveformSeekBar::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton) {
+        seekTo(event->position().x());
+    }
+}
+
+void WaveformSeekBar::mouseMoveEvent(QMouseEvent *event)
+{
+    if (event->buttons() & Qt::LeftButton) {
+        seekTo(event->position().x());
+    }
+}
+
+void WaveformSeekBar::mouseDoubleClickEvent(QMouseEvent *)
+{
+    setView(0, 0);
+    update();
+}
+
+void WaveformSeekBar::wheelEvent(QWheelEvent *event)
+{
+    if (m_durationMs <= 0) {
+        return;
+    }
+    const double notches = event->angleDelta().y() / 120.0;
+    const qint64 span = m_viewSpanMs > 0 ? m_viewSpanMs : m_durationMs;
+    const qint64 newSpan = static_cast<qint64>(span / std::pow(WHEEL_ZOOM_STEP, notches));
+    // Keep the time under the cursor where it is
+    const double x = event->position().x();
+    const qint64 anchor = msAt(x);
+    setView(anchor - static_cast<qint64>(x / std::max(width(), 1) * newSpan), newSpan);
+    update();
+    event->accept();
+}
@@ -0,0 +1,55 @@
+#ifndef WAVEFORMSEEKBAR_H
+#define WAVEFORMSEEKBAR_H
+
+#include <QTimer>
+#include <QWidget>
+#include <memory>
+#include <vector>
+
+#include "waveformpeaks.h"
+
+// Seek bar drawn as the track's waveform overview. Click or drag to seek,
+// wheel to zoom around the cursor, double-click to show the whole track
+// again. Drawing queries WaveformPeaks once per repaint for exactly width()
+// columns; while extraction runs the bar repaints periodically so the
+// overview fills in.
+class WaveformSeekBar : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit WaveformSeekBar(QWidget *parent = nullptr);
+
+    void setPeaks(std::shared_ptr<WaveformPeaks> peaks);
+    void setDuration(qint64 ms);
+    void setPosition(qint64 ms);
+
+    QSize sizeHint() const override { return QSize(400, 40); }
+    QSize minimumSizeHint() const override { return QSize(100, 24); }
+
+signals:
+    void seekRequested(qint64 ms);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+
+private:
+    qint64 msAt(double x) const;
+    double xAt(qint64 ms) const;
+    void setView(qint64 startMs, qint64 spanMs);
+    void seekTo(double x);
+
+    std::shared_ptr<WaveformPeaks> m_peaks;
+    std::vector<WaveformPeaks::Column> m_columns;
+    QTimer m_progressTimer;
+    qint64 m_durationMs = 0;
+    qint64 m_positionMs = 0;
+    qint64 m_viewStartMs = 0;
+    qint64 m_viewSpanMs = 0;     // 0: whole track
+};
+
+#endif // WAVEFORMSEEKBAR_H